@@ -0,0 +1,950 @@
+/*
+  Throughput benchmark for json.h.
+
+  Every corpus is generated from a fixed seed, so the numbers are
+  comparable between versions of the library. Each case is run a few
+  times to warm up and then measured 'reps' times; the median is kept.
+
+  usage: bench [-r reps] [-w warmup] [-s scale] [-t threads] [-o report.json]
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#define JSON_ENABLE_STATS
+#define JSON_ENABLE_THREADS
+#define JSON_ENABLE_WRITEV
+#include "json.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <time.h>
+
+typedef struct Buffer {
+    char *data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+typedef struct Corpus {
+    const char *name;
+    Buffer text;
+    Buffer cbor;    /* the same document encoded as CBOR */
+    Buffer image;   /* the same document as a tree image */
+    bool ndjson;    /* one document per line */
+} Corpus;
+
+typedef struct Reader {
+    const Json_Value *root;
+    size_t ops;
+    double checksum;
+} Reader;
+
+typedef struct Result {
+    const char *corpus;
+    const char *op;
+    size_t bytes;   /* bytes processed by one run */
+    size_t ops;     /* operations performed by one run */
+    double ns;      /* median time of one run */
+    size_t allocs;  /* allocations of one run */
+} Result;
+
+/* returns the number of operations, and the bytes processed in 'bytes' */
+typedef size_t (*Bench_Fn)(Corpus *corpus, Json_Context *ctx, size_t *bytes);
+
+static size_t reps = 5;
+static size_t warmup = 2;
+static size_t scale = 1;
+static size_t threads = 4;
+static Result results[256];
+static size_t result_count = 0;
+static Buffer sink = {0};
+static FILE *null_file;     /* /dev/null, for the dumps that need a file */
+static int null_fd;
+static Json_Context cursor_ctx; /* owns the stack of 'cursor' */
+static Json_Cursor cursor;      /* reused by every walk */
+static char *memory;            /* parse-mem: one block, doubled until a document fits */
+static size_t memory_size;
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ull;
+
+static void buffer_append(Buffer *b, const char *s, size_t n)
+{
+    if (b->size + n + 1 > b->capacity) {
+        while (b->size + n + 1 > b->capacity) {
+            b->capacity = b->capacity ? 2*b->capacity : 4096;
+        }
+        b->data = realloc(b->data, b->capacity);
+        if (!b->data) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(b->data + b->size, s, n);
+    b->size += n;
+    b->data[b->size] = '\0';
+}
+
+static void buffer_printf(Buffer *b, const char *fmt, ...)
+{
+    char tmp[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, args);
+    va_end(args);
+    buffer_append(b, tmp, (size_t)n);
+}
+
+static unsigned long long rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void random_word(Buffer *b, size_t min, size_t max)
+{
+    size_t len = min + rng() % (max - min + 1);
+    for (size_t i = 0; i < len; i++) {
+        char c = 'a' + rng() % 26;
+        buffer_append(b, &c, 1);
+    }
+}
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void gen_numbers(Buffer *b, size_t n)
+{
+    buffer_append(b, "[", 1);
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) buffer_append(b, ",", 1);
+        if (rng() % 2) {
+            buffer_printf(b, "%lld", (long long)(rng() % 2000000) - 1000000);
+        } else {
+            buffer_printf(b, "%.6f", (double)(rng() % 100000000) / 1000.0);
+        }
+    }
+    buffer_append(b, "]", 1);
+}
+
+static void gen_record(Buffer *b, size_t id)
+{
+    buffer_printf(b, "{\"id\": %zu, \"name\": \"", id);
+    random_word(b, 4, 12);
+    buffer_append(b, " ", 1);
+    random_word(b, 4, 12);
+    buffer_append(b, "\", \"email\": \"", 13);
+    random_word(b, 4, 10);
+    buffer_append(b, "@example.com\", \"bio\": \"", 23);
+    for (size_t w = 0; w < 12; w++) {
+        if (w > 0) buffer_append(b, " ", 1);
+        random_word(b, 2, 9);
+    }
+    buffer_printf(b, "\", \"active\": %s, \"tags\": [",
+                  rng() % 2 ? "true" : "false");
+    for (size_t t = 0; t < 3; t++) {
+        if (t > 0) buffer_append(b, ", ", 2);
+        buffer_append(b, "\"", 1);
+        random_word(b, 3, 8);
+        buffer_append(b, "\"", 1);
+    }
+    buffer_append(b, "]}", 2);
+}
+
+static void gen_records(Buffer *b, size_t n)
+{
+    buffer_append(b, "[\n", 2);
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) buffer_append(b, ",\n", 2);
+        gen_record(b, i);
+    }
+    buffer_append(b, "\n]", 2);
+}
+
+static void gen_nested(Buffer *b, size_t trees, size_t depth)
+{
+    buffer_append(b, "[", 1);
+    for (size_t t = 0; t < trees; t++) {
+        if (t > 0) buffer_append(b, ",", 1);
+        for (size_t d = 0; d < depth; d++) {
+            if (d % 2 == 0) {
+                buffer_printf(b, "{\"level\": %zu, \"child\": ", d);
+            } else {
+                buffer_printf(b, "[%zu, ", d);
+            }
+        }
+        buffer_append(b, "null", 4);
+        for (size_t d = depth; d-- > 0;) {
+            buffer_append(b, d % 2 == 0 ? "}" : "]", 1);
+        }
+    }
+    buffer_append(b, "]", 1);
+}
+
+static void gen_wide(Buffer *b, size_t keys)
+{
+    buffer_append(b, "{", 1);
+    for (size_t i = 0; i < keys; i++) {
+        if (i > 0) buffer_append(b, ",", 1);
+        buffer_printf(b, "\"key_%zu_", i);
+        random_word(b, 2, 6);
+        buffer_printf(b, "\": %llu", rng() % 100000);
+    }
+    buffer_append(b, "}", 1);
+}
+
+/* records that carry a base64 payload of 8 to 64 KB */
+static void gen_blobs(Buffer *b, size_t n)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    buffer_append(b, "[\n", 2);
+    for (size_t i = 0; i < n; i++) {
+        size_t len = 4*(2048 + rng() % 14336);
+        if (i > 0) buffer_append(b, ",\n", 2);
+        buffer_printf(b, "{\"id\": %zu, \"type\": \"image/png\", \"data\": \"", i);
+        for (size_t k = 0; k < len; k++) buffer_append(b, &alphabet[rng() % 64], 1);
+        buffer_append(b, "\"}", 2);
+    }
+    buffer_append(b, "\n]", 2);
+}
+
+static void gen_ndjson(Buffer *b, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        gen_record(b, i);
+        buffer_append(b, "\n", 1);
+    }
+}
+
+static size_t count_values(const Json_Value *value)
+{
+    size_t count = 1;
+    if (json_array_is_packed(value)) {
+        count += json_array_get_size(value);
+    } else if (json_is_object(value)) {
+        for (size_t i = 0; i < json_object_get_size(value); i++) {
+            count += count_values(&json_object_get_pair(value, i)->value);
+        }
+    } else if (json_is_array(value)) {
+        for (size_t i = 0; i < json_array_get_size(value); i++) {
+            count += count_values(json_array_get_value(value, i));
+        }
+    }
+    return count;
+}
+
+static size_t bench_walk(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    *bytes = corpus->text.size;
+    return count_values(json_context_get_root(ctx));
+}
+
+/* the same count as 'walk', without recursion */
+static size_t bench_walk_cursor(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    Json_Cursor_Event event;
+    size_t count = 0;
+
+    json_cursor_begin(&cursor, json_context_get_root(ctx), JSON_CURSOR_DEPTH_FIRST);
+    while ((event = json_cursor_next(&cursor)) != JSON_CURSOR_END) {
+        if (event != JSON_CURSOR_LEAVE) count++;
+    }
+    *bytes = corpus->text.size;
+    return count;
+}
+
+/* look every member up by name, the way user code reads a document */
+static size_t query_value(const Json_Value *value, double *checksum)
+{
+    size_t ops = 0;
+    if (json_array_is_packed(value)) {
+        const double *numbers = json_array_get_numbers(value);
+        for (size_t i = 0; i < json_array_get_size(value); i++) *checksum += numbers[i];
+        ops += json_array_get_size(value);
+    } else if (json_is_object(value)) {
+        for (size_t i = 0; i < json_object_get_size(value); i++) {
+            const Json_Pair *pair = json_object_get_pair(value, i);
+            const Json_Value *member = json_object_get_value(value, json_to_string(&pair->key));
+            ops += 1 + query_value(member, checksum);
+        }
+    } else if (json_is_array(value)) {
+        for (size_t i = 0; i < json_array_get_size(value); i++) {
+            ops += 1 + query_value(json_array_get_value(value, i), checksum);
+        }
+    } else if (json_is_number(value)) {
+        *checksum += json_to_number(value);
+    }
+    return ops;
+}
+
+static size_t query_image(const Json_Image *image, const Json_Image_Node *node, double *checksum)
+{
+    size_t ops = 0;
+    if (json_image_get_type(node) == JSON_VALUE_OBJECT) {
+        for (size_t i = 0; i < json_image_object_get_size(node); i++) {
+            const char *key = json_image_object_get_key(image, node, i);
+            const Json_Image_Node *member = json_image_object_get_value(image, node, key);
+            ops += 1 + query_image(image, member, checksum);
+        }
+    } else if (json_image_get_type(node) == JSON_VALUE_ARRAY) {
+        for (size_t i = 0; i < json_image_array_get_size(node); i++) {
+            ops += 1 + query_image(image, json_image_array_get_value(image, node, i), checksum);
+        }
+    } else if (json_image_get_type(node) == JSON_VALUE_NUMBER) {
+        *checksum += json_image_to_number(node);
+    }
+    return ops;
+}
+
+static void sink_write(const void *data, size_t size, void *user)
+{
+    buffer_append(user, data, size);
+}
+
+static void parse_document(Json_Context *ctx, const char *input, size_t size)
+{
+    if (!json_parse(ctx, input, size)) {
+        fprintf(stderr, "ERROR: failed to parse benchmark input\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static size_t bench_parse(Corpus *corpus, Json_Context *stats, size_t *bytes)
+{
+    *bytes = corpus->text.size;
+    size_t values = 0;
+
+    if (corpus->ndjson) {
+        char *line = corpus->text.data;
+        char *end = corpus->text.data + corpus->text.size;
+        while (line < end) {
+            char *eol = memchr(line, '\n', end - line);
+            if (!eol) eol = end;
+            Json_Context ctx;
+            json_init(&ctx, .pack_numbers = stats->opt.pack_numbers);
+            parse_document(&ctx, line, eol - line);
+            values += ctx.stats.values[JSON_VALUE_NULL] + ctx.stats.values[JSON_VALUE_OBJECT] +
+                      ctx.stats.values[JSON_VALUE_ARRAY] + ctx.stats.values[JSON_VALUE_STRING] +
+                      ctx.stats.values[JSON_VALUE_NUMBER] + ctx.stats.values[JSON_VALUE_BOOLEAN];
+            stats->stats.allocations += ctx.stats.allocations;
+            json_fini(&ctx);
+            line = eol + 1;
+        }
+    } else {
+        Json_Context ctx;
+        json_init(&ctx, .pack_numbers = stats->opt.pack_numbers);
+        parse_document(&ctx, corpus->text.data, corpus->text.size);
+        values = count_values(json_context_get_root(&ctx));
+        stats->stats.allocations += ctx.stats.allocations;
+        json_fini(&ctx);
+    }
+
+    return values;
+}
+
+/* bench_parse with every document carved from one block, no heap */
+static size_t bench_parse_memory(Corpus *corpus, Json_Context *stats, size_t *bytes)
+{
+    char *line = corpus->text.data;
+    char *end = corpus->text.data + corpus->text.size;
+    size_t values = 0;
+
+    *bytes = corpus->text.size;
+    while (line < end) {
+        char *eol = corpus->ndjson ? memchr(line, '\n', end - line) : NULL;
+        if (!eol) eol = end;
+        Json_Context ctx;
+        json_init(&ctx, .pack_numbers = stats->opt.pack_numbers,
+                  .memory = memory, .memory_size = memory_size);
+        while (!json_parse(&ctx, line, eol - line)) {
+            if (json_context_get_parse_error(&ctx)->code != JSON_PARSE_OUT_OF_MEMORY) {
+                fprintf(stderr, "ERROR: failed to parse benchmark input\n");
+                exit(EXIT_FAILURE);
+            }
+            json_fini(&ctx);
+            memory_size = memory_size ? 2*memory_size : 1 << 20;
+            memory = realloc(memory, memory_size);
+            json_init(&ctx, .pack_numbers = stats->opt.pack_numbers,
+                      .memory = memory, .memory_size = memory_size);
+        }
+        values += corpus->ndjson ? ctx.stats.values[JSON_VALUE_NULL] + ctx.stats.values[JSON_VALUE_OBJECT] +
+                                   ctx.stats.values[JSON_VALUE_ARRAY] + ctx.stats.values[JSON_VALUE_STRING] +
+                                   ctx.stats.values[JSON_VALUE_NUMBER] + ctx.stats.values[JSON_VALUE_BOOLEAN]
+                                 : count_values(json_context_get_root(&ctx));
+        json_fini(&ctx);
+        line = eol + 1;
+    }
+
+    return values;
+}
+
+/* bench_parse one element of the top-level array at a time */
+static size_t bench_stream(Corpus *corpus, Json_Context *stats, size_t *bytes)
+{
+    Json_Context ctx;
+    Json_Stream stream;
+    const Json_Value *element;
+    size_t values = 1;
+
+    *bytes = corpus->text.size;
+    json_init(&ctx);
+    if (!json_stream_begin(&ctx, &stream, corpus->text.data, corpus->text.size, "")) {
+        fprintf(stderr, "ERROR: failed to stream benchmark input\n");
+        exit(EXIT_FAILURE);
+    }
+    while ((element = json_stream_next(&stream))) values += count_values(element);
+    if (json_context_get_parse_error(&ctx)->code != JSON_PARSE_OK) {
+        fprintf(stderr, "ERROR: failed to stream benchmark input\n");
+        exit(EXIT_FAILURE);
+    }
+    json_stream_end(&stream);
+    stats->stats.allocations += ctx.stats.allocations;
+    json_fini(&ctx);
+
+    return values;
+}
+
+static size_t bench_validate(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    char *line = corpus->text.data;
+    char *end = corpus->text.data + corpus->text.size;
+    size_t documents = 0;
+    Json_Parse_Error err;
+
+    *bytes = corpus->text.size;
+    while (line < end) {
+        char *eol = corpus->ndjson ? memchr(line, '\n', end - line) : NULL;
+        if (!eol) eol = end;
+        if (!json_validate(line, eol - line, &err)) {
+            fprintf(stderr, "ERROR: benchmark input rejected at %zu:%zu, expected %s, found %s\n",
+                    err.line, err.column, err.expected, err.found);
+            exit(EXIT_FAILURE);
+        }
+        documents++;
+        line = eol + 1;
+    }
+    (void)ctx;
+
+    return documents;
+}
+
+static size_t bench_extract(Corpus *corpus, Json_Context *stats, size_t *bytes)
+{
+    static const char *const paths[] = {"/id", "/name"};
+    const Json_Value *out[2];
+    char *line = corpus->text.data;
+    char *end = corpus->text.data + corpus->text.size;
+    size_t found = 0;
+
+    *bytes = corpus->text.size;
+    while (line < end) {
+        char *eol = memchr(line, '\n', end - line);
+        if (!eol) eol = end;
+        Json_Context ctx;
+        json_init(&ctx);
+        if (!json_extract(&ctx, line, eol - line, paths, 2, out)) {
+            fprintf(stderr, "ERROR: failed to extract from benchmark input\n");
+            exit(EXIT_FAILURE);
+        }
+        found += (out[0] != NULL) + (out[1] != NULL);
+        stats->stats.allocations += ctx.stats.allocations;
+        json_fini(&ctx);
+        line = eol + 1;
+    }
+
+    return found;
+}
+
+static size_t bench_query(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    *bytes = corpus->text.size;
+    double checksum = 0;
+    size_t ops = query_value(json_context_get_root(ctx), &checksum);
+    if (checksum == 42.4242) printf("%f\n", checksum); /* keep the walk alive */
+    (void)corpus;
+    return ops;
+}
+
+/* read the fields of every record by name, as a consumer of the corpus would */
+static size_t bench_fields(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    static const char *const fields[] = {"id", "name", "email", "bio", "active", "tags"};
+    const Json_Value *root = json_context_get_root(ctx);
+    size_t ops = 0;
+    double checksum = 0;
+
+    for (size_t i = 0; i < json_array_get_size(root); i++) {
+        const Json_Value *record = json_array_get_value(root, i);
+        for (size_t f = 0; f < sizeof(fields)/sizeof(fields[0]); f++) {
+            const Json_Value *value = json_object_get_value(record, fields[f]);
+            if (value && json_is_number(value)) checksum += json_to_number(value);
+            ops++;
+        }
+    }
+    if (checksum == 42.4242) printf("%f\n", checksum);
+    *bytes = corpus->text.size;
+    return ops;
+}
+
+/* the records a query and the same code written by hand pick out */
+#define FILTER_QUERY  ".[] | select(.active == true and .id >= 1000) | .email"
+#define PROJECT_QUERY ".[] | {id, name, tag: .tags[0]}"
+
+static bool filter_result(const Json_Value *email, void *user)
+{
+    Reader *reader = user;
+    if (json_is_string(email)) reader->checksum += json_string_length(email);
+    return true;
+}
+
+static bool project_result(const Json_Value *record, void *user)
+{
+    Reader *reader = user;
+    const Json_Value *id = json_object_get_value(record, "id");
+    const Json_Value *name = json_object_get_value(record, "name");
+    const Json_Value *tag = json_object_get_value(record, "tag");
+    if (json_is_number(id)) reader->checksum += json_to_number(id);
+    if (json_is_string(name)) reader->checksum += json_string_length(name);
+    if (json_is_string(tag)) reader->checksum += json_string_length(tag);
+    return true;
+}
+
+static size_t bench_filter(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    const Json_Value *root = json_context_get_root(ctx);
+    Reader reader = {.root = root};
+
+    for (size_t i = 0; i < json_array_get_size(root); i++) {
+        const Json_Value *record = json_array_get_value(root, i);
+        const Json_Value *active = json_object_get_value(record, "active");
+        const Json_Value *id = json_object_get_value(record, "id");
+        if (active && json_is_boolean(active) && json_to_boolean(active) &&
+            id && json_is_number(id) && json_to_number(id) >= 1000) {
+            const Json_Value *email = json_object_get_value(record, "email");
+            if (email) filter_result(email, &reader);
+        }
+    }
+    if (reader.checksum == 42.4242) printf("%f\n", reader.checksum);
+    *bytes = corpus->text.size;
+    return json_array_get_size(root);
+}
+
+static size_t bench_project(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    const Json_Value *root = json_context_get_root(ctx);
+    Reader reader = {.root = root};
+
+    for (size_t i = 0; i < json_array_get_size(root); i++) {
+        const Json_Value *record = json_array_get_value(root, i);
+        const Json_Value *id = json_object_get_value(record, "id");
+        const Json_Value *name = json_object_get_value(record, "name");
+        const Json_Value *tag = json_array_get_value(json_object_get_value(record, "tags"), 0);
+        if (id && json_is_number(id)) reader.checksum += json_to_number(id);
+        if (name && json_is_string(name)) reader.checksum += json_string_length(name);
+        if (tag && json_is_string(tag)) reader.checksum += json_string_length(tag);
+    }
+    if (reader.checksum == 42.4242) printf("%f\n", reader.checksum);
+    *bytes = corpus->text.size;
+    return json_array_get_size(root);
+}
+
+/* compiled on every run, which is part of what a caller pays */
+static size_t run_query(Json_Context *ctx, const char *text, Json_Query_Fn fn)
+{
+    const Json_Value *root = json_context_get_root(ctx);
+    Json_Query *query = json_query_compile(ctx, text);
+    Reader reader = {.root = root};
+
+    json_query_run(ctx, query, root, fn, &reader);
+    json_query_free(ctx, query);
+    if (reader.checksum == 42.4242) printf("%f\n", reader.checksum);
+    return json_array_get_size(root);
+}
+
+static size_t bench_filter_query(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    *bytes = corpus->text.size;
+    return run_query(ctx, FILTER_QUERY, filter_result);
+}
+
+static size_t bench_project_query(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    *bytes = corpus->text.size;
+    return run_query(ctx, PROJECT_QUERY, project_result);
+}
+
+static void *query_worker(void *arg)
+{
+    Reader *reader = arg;
+    reader->ops = query_value(reader->root, &reader->checksum);
+    return NULL;
+}
+
+/* every thread walks the whole frozen tree at the same time, without locks */
+static size_t bench_query_parallel(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    pthread_t workers[64];
+    Reader readers[64];
+    size_t n = threads == 0 ? 1 : threads > 64 ? 64 : threads;
+    size_t started = 0, ops = 0;
+
+    for (; started < n; started++) {
+        readers[started] = (Reader){.root = json_context_get_root(ctx)};
+        if (pthread_create(&workers[started], NULL, query_worker, &readers[started]) != 0) break;
+    }
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+        ops += readers[i].ops;
+        if (readers[i].checksum == 42.4242) printf("%f\n", readers[i].checksum);
+    }
+
+    *bytes = started*corpus->text.size;
+    return ops;
+}
+
+static size_t bench_dump(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    (void)corpus;
+    sink.size = 0;
+    json_dump(ctx);
+    *bytes = sink.size;
+    return count_values(json_context_get_root(ctx));
+}
+
+static size_t bench_dump_parallel(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    size_t values;
+    ctx->opt.threads = threads;
+    values = bench_dump(corpus, ctx, bytes);
+    ctx->opt.threads = 1;
+    return values;
+}
+
+/* the dump of 'dump' to /dev/null: through stdio, which copies every
+   byte into its buffer, and with writev, which takes long strings in place */
+static size_t bench_dump_file(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    Json_Opt opt = ctx->opt;
+    size_t written = ctx->stats.bytes_written;
+
+    (void)corpus;
+    ctx->opt.mode = JSON_FILE_OUTPUT;
+    ctx->opt.output_file = null_file;
+    json_dump(ctx);
+    fflush(null_file);
+    ctx->opt = opt;
+
+    *bytes = ctx->stats.bytes_written - written;
+    return count_values(json_context_get_root(ctx));
+}
+
+static size_t bench_dump_writev(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    Json_Opt opt = ctx->opt;
+    size_t written = ctx->stats.bytes_written;
+
+    (void)corpus;
+    ctx->opt.mode = JSON_WRITEV_OUTPUT;
+    ctx->opt.output_fd = null_fd;
+    json_dump(ctx);
+    ctx->opt = opt;
+
+    *bytes = ctx->stats.bytes_written - written;
+    return count_values(json_context_get_root(ctx));
+}
+
+static size_t bench_canonical(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    (void)corpus;
+    sink.size = 0;
+    json_canonical_dump(ctx);
+    *bytes = sink.size;
+    return count_values(json_context_get_root(ctx));
+}
+
+/* the same tree as 'canonical', hashed without writing it out */
+static size_t bench_hash(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    Json_Hash hash = json_hash(json_context_get_root(ctx));
+    if (hash.lo == 42) printf("%llx\n", (unsigned long long)hash.hi);
+    *bytes = corpus->text.size;
+    return count_values(json_context_get_root(ctx));
+}
+
+static size_t bench_cbor_encode(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    (void)corpus;
+    sink.size = 0;
+    json_cbor_dump(ctx);
+    *bytes = sink.size;
+    return count_values(json_context_get_root(ctx));
+}
+
+static size_t bench_cbor_decode(Corpus *corpus, Json_Context *stats, size_t *bytes)
+{
+    size_t values;
+    Json_Context ctx;
+
+    json_init(&ctx);
+    if (!json_cbor_parse(&ctx, corpus->cbor.data, corpus->cbor.size)) {
+        fprintf(stderr, "ERROR: failed to decode benchmark input\n");
+        exit(EXIT_FAILURE);
+    }
+    values = count_values(json_context_get_root(&ctx));
+    stats->stats.allocations += ctx.stats.allocations;
+    json_fini(&ctx);
+
+    *bytes = corpus->cbor.size;
+    return values;
+}
+
+static size_t bench_image_dump(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    (void)corpus;
+    sink.size = 0;
+    json_image_dump(ctx);
+    *bytes = sink.size;
+    return count_values(json_context_get_root(ctx));
+}
+
+static size_t bench_image_query(Corpus *corpus, Json_Context *ctx, size_t *bytes)
+{
+    Json_Image image;
+    double checksum = 0;
+    size_t ops;
+
+    (void)ctx;
+    if (!json_image_open(&image, corpus->image.data, corpus->image.size)) {
+        fprintf(stderr, "ERROR: failed to open benchmark image\n");
+        exit(EXIT_FAILURE);
+    }
+    ops = query_image(&image, json_image_get_root(&image), &checksum);
+    if (checksum == 42.4242) printf("%f\n", checksum);
+    *bytes = corpus->text.size;
+    return ops;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void run_case(Corpus *corpus, const char *op, Bench_Fn fn, Json_Context *ctx)
+{
+    double times[64];
+    size_t ops = 0, allocs = 0, bytes = 0;
+    size_t n = reps < 64 ? reps : 64;
+
+    for (size_t i = 0; i < warmup; i++) fn(corpus, ctx, &bytes);
+    for (size_t i = 0; i < n; i++) {
+        size_t before = ctx->stats.allocations;
+        unsigned long long start = now_ns();
+        ops = fn(corpus, ctx, &bytes);
+        times[i] = (double)(now_ns() - start);
+        allocs = ctx->stats.allocations - before;
+    }
+    qsort(times, n, sizeof(times[0]), compare_double);
+
+    results[result_count++] = (Result){
+        .corpus = corpus->name,
+        .op = op,
+        .bytes = bytes,
+        .ops = ops,
+        .ns = times[n/2],
+        .allocs = allocs,
+    };
+}
+
+static void report_text(void)
+{
+    printf("%-10s %-10s %10s %10s %10s %12s\n",
+           "corpus", "op", "MB", "MB/s", "ns/op", "allocs");
+    for (size_t i = 0; i < result_count; i++) {
+        Result *r = &results[i];
+        double mb = r->bytes / (1024.0*1024.0);
+        printf("%-10s %-10s %10.2f %10.1f %10.1f %12zu\n",
+               r->corpus, r->op, mb, mb / (r->ns*1e-9),
+               r->ops ? r->ns / r->ops : 0.0, r->allocs);
+    }
+}
+
+static void report_json(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "ERROR: could not open '%s'\n", path);
+        return;
+    }
+
+    Json_Context ctx;
+    json_init(&ctx, .indent = "  ", .output_file = file);
+    json_object_begin(&ctx);
+        json_key(&ctx, "reps");
+        json_number(&ctx, reps);
+        json_key(&ctx, "warmup");
+        json_number(&ctx, warmup);
+        json_key(&ctx, "scale");
+        json_number(&ctx, scale);
+        json_key(&ctx, "threads");
+        json_number(&ctx, threads);
+        json_key(&ctx, "results");
+        json_array_begin(&ctx);
+        for (size_t i = 0; i < result_count; i++) {
+            Result *r = &results[i];
+            json_object_begin(&ctx);
+                json_key(&ctx, "corpus");
+                json_string(&ctx, r->corpus);
+                json_key(&ctx, "op");
+                json_string(&ctx, r->op);
+                json_key(&ctx, "bytes");
+                json_number(&ctx, r->bytes);
+                json_key(&ctx, "ops");
+                json_number(&ctx, r->ops);
+                json_key(&ctx, "ns");
+                json_number(&ctx, r->ns);
+                json_key(&ctx, "mb_per_s");
+                json_number(&ctx, r->bytes / (1024.0*1024.0) / (r->ns*1e-9));
+                json_key(&ctx, "ns_per_op");
+                json_number(&ctx, r->ops ? r->ns / r->ops : 0.0);
+                json_key(&ctx, "allocs");
+                json_number(&ctx, r->allocs);
+            json_object_end(&ctx);
+        }
+        json_array_end(&ctx);
+    json_object_end(&ctx);
+    json_dump(&ctx);
+    fprintf(file, "\n");
+    json_fini(&ctx);
+
+    fclose(file);
+    printf("\nreport written to '%s'\n", path);
+}
+
+int main(int argc, char **argv)
+{
+    const char *report = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            reps = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            warmup = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            scale = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            report = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-r reps] [-w warmup] [-s scale] [-t threads] [-o report.json]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (reps == 0) reps = 1;
+    if (scale == 0) scale = 1;
+
+    Corpus corpora[] = {
+        {.name = "numbers"},
+        {.name = "records"},
+        {.name = "nested"},
+        {.name = "wide"},
+        {.name = "blobs"},
+        {.name = "ndjson", .ndjson = true},
+    };
+    gen_numbers(&corpora[0].text, 100000*scale);
+    gen_records(&corpora[1].text, 10000*scale);
+    gen_nested(&corpora[2].text, 100*scale, 200);
+    gen_wide(&corpora[3].text, 2000*scale);
+    gen_blobs(&corpora[4].text, 200*scale);
+    gen_ndjson(&corpora[5].text, 10000*scale);
+
+    json_init(&cursor_ctx);
+    json_cursor_init(&cursor_ctx, &cursor);
+    null_file = fopen("/dev/null", "wb");
+    null_fd = open("/dev/null", O_WRONLY);
+    if (!null_file || null_fd < 0) {
+        fprintf(stderr, "ERROR: could not open /dev/null\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(corpora)/sizeof(corpora[0]); i++) {
+        Corpus *corpus = &corpora[i];
+        Json_Context ctx;
+
+        json_init(&ctx, .mode = JSON_CALLBACK_OUTPUT, .write_bytes = sink_write,
+                  .write_user = &sink, .indent = "  ");
+        run_case(corpus, "validate", bench_validate, &ctx);
+        run_case(corpus, "parse", bench_parse, &ctx);
+        run_case(corpus, "parse-mem", bench_parse_memory, &ctx);
+        if (!corpus->ndjson && corpus->text.data[0] == '[') {
+            run_case(corpus, "stream", bench_stream, &ctx);
+        }
+        if (!corpus->ndjson) {
+            parse_document(&ctx, corpus->text.data, corpus->text.size);
+            json_stats_bind(&ctx);
+            run_case(corpus, "query", bench_query, &ctx);
+            run_case(corpus, "walk", bench_walk, &ctx);
+            run_case(corpus, "walk-cur", bench_walk_cursor, &ctx);
+            if (strcmp(corpus->name, "records") == 0) {
+                run_case(corpus, "fields", bench_fields, &ctx);
+                run_case(corpus, "filter", bench_filter, &ctx);
+                run_case(corpus, "filter-q", bench_filter_query, &ctx);
+                run_case(corpus, "project", bench_project, &ctx);
+                run_case(corpus, "project-q", bench_project_query, &ctx);
+            }
+            run_case(corpus, "dump", bench_dump, &ctx);
+            run_case(corpus, "dump-mt", bench_dump_parallel, &ctx);
+            run_case(corpus, "dump-file", bench_dump_file, &ctx);
+            run_case(corpus, "dump-wv", bench_dump_writev, &ctx);
+            run_case(corpus, "canonical", bench_canonical, &ctx);
+            run_case(corpus, "hash", bench_hash, &ctx);
+            run_case(corpus, "cbor-enc", bench_cbor_encode, &ctx);
+            buffer_append(&corpus->cbor, sink.data, sink.size);
+            run_case(corpus, "cbor-dec", bench_cbor_decode, &ctx);
+            run_case(corpus, "img-dump", bench_image_dump, &ctx);
+            buffer_append(&corpus->image, sink.data, sink.size);
+            run_case(corpus, "img-query", bench_image_query, &ctx);
+            json_freeze(&ctx);
+            run_case(corpus, "query-frz", bench_query, &ctx);
+            run_case(corpus, "query-mt", bench_query_parallel, &ctx);
+            json_stats_bind(NULL);
+        } else {
+            run_case(corpus, "extract", bench_extract, &ctx);
+        }
+        json_fini(&ctx);
+
+        /* the same document with its arrays of numbers packed */
+        if (!corpus->ndjson) {
+            json_init(&ctx, .mode = JSON_CALLBACK_OUTPUT, .write_bytes = sink_write,
+                      .write_user = &sink, .indent = "  ", .pack_numbers = true);
+            run_case(corpus, "parse-pk", bench_parse, &ctx);
+            parse_document(&ctx, corpus->text.data, corpus->text.size);
+            run_case(corpus, "query-pk", bench_query, &ctx);
+            run_case(corpus, "dump-pk", bench_dump, &ctx);
+            json_fini(&ctx);
+        }
+    }
+
+    report_text();
+    if (report) report_json(report);
+
+    for (size_t i = 0; i < sizeof(corpora)/sizeof(corpora[0]); i++) {
+        free(corpora[i].text.data);
+        free(corpora[i].cbor.data);
+        free(corpora[i].image.data);
+    }
+    free(sink.data);
+    free(memory);
+    fclose(null_file);
+    close(null_fd);
+    json_cursor_fini(&cursor);
+    json_fini(&cursor_ctx);
+    return 0;
+}
@@ -0,0 +1,190 @@
+/*
+  Overhead of json.hpp over the C API.
+
+  The same reads are written once against json.h and once against
+  json.hpp, and run over the same parsed records. Each pair is measured
+  like bench.c does (warmup, then the median of 'reps' runs); the ratio
+  column is the C++ time over the C time.
+
+  usage: bench_cpp [-r reps] [-w warmup] [-s scale]
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+typedef size_t (*Read_Fn)(const Json_Value *root, double *checksum);
+
+static size_t reps = 5;
+static size_t warmup = 2;
+static size_t scale = 1;
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ull;
+
+static unsigned long long rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void random_word(std::string &s, size_t min, size_t max)
+{
+    size_t len = min + rng() % (max - min + 1);
+    for (size_t i = 0; i < len; i++) s += (char)('a' + rng() % 26);
+}
+
+/* the records corpus of bench.c, with a couple of numeric fields */
+static std::string gen_records(size_t n)
+{
+    std::string s = "[\n";
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) s += ",\n";
+        s += "{\"id\": " + std::to_string(i) + ", \"name\": \"";
+        random_word(s, 4, 12);
+        s += "\", \"score\": " + std::to_string(rng() % 100000 / 100.0);
+        s += ", \"active\": ";
+        s += rng() % 2 ? "true" : "false";
+        s += ", \"tags\": [";
+        for (size_t t = 0; t < 3; t++) {
+            if (t > 0) s += ", ";
+            s += "\"";
+            random_word(s, 3, 8);
+            s += "\"";
+        }
+        s += "], \"pos\": [" + std::to_string(rng() % 1000) + ", " + std::to_string(rng() % 1000) + "]}";
+    }
+    s += "\n]";
+    return s;
+}
+
+/* visit every value in order, summing the numbers */
+static size_t walk_c(const Json_Value *value, double *checksum)
+{
+    size_t ops = 1;
+    if (json_is_object(value)) {
+        for (size_t i = 0; i < json_object_get_size(value); i++) {
+            ops += walk_c(&json_object_get_pair(value, i)->value, checksum);
+        }
+    } else if (json_is_array(value)) {
+        for (size_t i = 0; i < json_array_get_size(value); i++) {
+            ops += walk_c(json_array_get_value(value, i), checksum);
+        }
+    } else if (json_is_number(value)) {
+        *checksum += json_to_number(value);
+    }
+    return ops;
+}
+
+static size_t walk_cpp_value(json::Value value, double *checksum)
+{
+    size_t ops = 1;
+    if (value.is_object()) {
+        for (json::Member member : value.members()) ops += walk_cpp_value(member.value(), checksum);
+    } else if (value.is_array()) {
+        for (json::Value element : value.elements()) ops += walk_cpp_value(element, checksum);
+    } else if (value.is_number()) {
+        *checksum += value.get<double>();
+    }
+    return ops;
+}
+
+static size_t walk_cpp(const Json_Value *root, double *checksum)
+{
+    return walk_cpp_value(json::Value(root), checksum);
+}
+
+/* read named, typed fields out of every record */
+static size_t fields_c(const Json_Value *root, double *checksum)
+{
+    size_t n = json_array_get_size(root);
+    for (size_t i = 0; i < n; i++) {
+        const Json_Value *record = json_array_get_value(root, i);
+        const Json_Value *id = json_object_get_value(record, "id");
+        const Json_Value *name = json_object_get_value(record, "name");
+        const Json_Value *score = json_object_get_value(record, "score");
+        const Json_Value *active = json_object_get_value(record, "active");
+        const Json_Value *pos = json_object_get_value(record, "pos");
+        if (id && json_is_number(id)) *checksum += json_to_number(id);
+        if (name && json_is_string(name)) *checksum += json_string_length(name);
+        if (score && json_is_number(score)) *checksum += json_to_number(score);
+        if (active && json_is_boolean(active) && json_to_boolean(active)) *checksum += 1;
+        if (pos) {
+            const Json_Value *x = json_array_get_value(pos, 1);
+            if (x && json_is_number(x)) *checksum += json_to_number(x);
+        }
+    }
+    return 5*n;
+}
+
+static size_t fields_cpp(const Json_Value *root, double *checksum)
+{
+    json::Value records(root);
+    for (json::Value record : records.elements()) {
+        *checksum += record["id"].get_or(0.0);
+        *checksum += record["name"].get_or(std::string_view()).size();
+        *checksum += record["score"].get_or(0.0);
+        *checksum += record["active"].get_or(false);
+        *checksum += record["pos"][1].get_or(0.0);
+    }
+    return 5*records.size();
+}
+
+static double measure(Read_Fn fn, const Json_Value *root, size_t *ops, double *checksum)
+{
+    std::vector<double> times;
+    for (size_t i = 0; i < warmup; i++) fn(root, checksum);
+    for (size_t i = 0; i < reps; i++) {
+        auto start = std::chrono::steady_clock::now();
+        *ops = fn(root, checksum);
+        times.push_back(std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size()/2];
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i + 1 < argc; i += 2) {
+        size_t n = strtoul(argv[i + 1], NULL, 10);
+        if (strcmp(argv[i], "-r") == 0) reps = n > 0 ? n : 1;
+        else if (strcmp(argv[i], "-w") == 0) warmup = n;
+        else if (strcmp(argv[i], "-s") == 0) scale = n > 0 ? n : 1;
+    }
+
+    std::string text = gen_records(20000*scale);
+    json::Document doc;
+    if (!doc.parse(text)) {
+        fprintf(stderr, "failed to parse the corpus\n");
+        return 1;
+    }
+
+    static const struct {
+        const char *op;
+        Read_Fn c, cpp;
+    } cases[] = {
+        {"walk", walk_c, walk_cpp},
+        {"fields", fields_c, fields_cpp},
+    };
+
+    printf("%-10s %12s %12s %8s\n", "op", "C ns/op", "C++ ns/op", "ratio");
+    for (const auto &test : cases) {
+        size_t ops_c = 0, ops_cpp = 0;
+        double sum_c = 0, sum_cpp = 0;
+        double ns_c = measure(test.c, doc.root().c_value(), &ops_c, &sum_c);
+        double ns_cpp = measure(test.cpp, doc.root().c_value(), &ops_cpp, &sum_cpp);
+        if (ops_c != ops_cpp || sum_c != sum_cpp) {
+            fprintf(stderr, "%s: the two versions disagree\n", test.op);
+            return 1;
+        }
+        printf("%-10s %12.2f %12.2f %8.3f\n", test.op,
+               ns_c / ops_c, ns_cpp / ops_cpp, ns_cpp / ns_c);
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+  Parse requests into one fixed block of memory: nothing is allocated
+  from the heap, and a request too large for the block is refused
+  instead of growing the process.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+static const char *requests[] = {
+    "{\"op\": \"get\", \"keys\": [\"user:1\", \"user:2\"], \"timeout_ms\": 50}",
+    "{\"op\": \"put\", \"key\": \"user:3\", \"value\": {\"name\": \"Ada\", \"roles\": [\"admin\"]}}",
+    NULL, /* a payload far larger than the block, built below */
+};
+
+/* enough for the buffers of the context and a small request */
+static char memory[8192];
+
+int main(void)
+{
+    char *hostile = malloc(64*1024);
+    size_t n = 0;
+    n += sprintf(hostile + n, "[");
+    for (int i = 0; i < 4000; i++) n += sprintf(hostile + n, "%s\"item\"", i ? "," : "");
+    n += sprintf(hostile + n, "]");
+    requests[2] = hostile;
+
+    for (size_t i = 0; i < sizeof(requests)/sizeof(requests[0]); i++) {
+        /* every request starts over with the whole block */
+        Json_Context ctx;
+        json_init(&ctx, .memory = memory, .memory_size = sizeof(memory));
+
+        if (json_parse(&ctx, requests[i], strlen(requests[i]))) {
+            const Json_Value *op = json_object_get_value(ctx.root, "op");
+            printf("request %zu: %s, %zu bytes of the block used\n",
+                   i, json_to_string(op), json_memory_used(&ctx));
+        } else if (json_context_get_parse_error(&ctx)->code == JSON_PARSE_OUT_OF_MEMORY) {
+            printf("request %zu: refused, it does not fit in %zu bytes\n", i, sizeof(memory));
+        } else {
+            printf("request %zu: invalid\n", i);
+        }
+        json_fini(&ctx);
+    }
+
+    free(hostile);
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+  Route every allocation of a context through a user allocator that
+  keeps track of the live bytes.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+#include <assert.h>
+
+typedef struct Tracker {
+    size_t live;
+    size_t peak;
+    size_t calls;
+} Tracker;
+
+/* the size is stored in front of each block to check the one we get back */
+static void *tracker_alloc(void *user, size_t size)
+{
+    Tracker *t = user;
+    size_t *block = malloc(sizeof(size_t) + size);
+    if (!block) return NULL;
+    block[0] = size;
+    t->live += size;
+    if (t->live > t->peak) t->peak = t->live;
+    t->calls++;
+    return block + 1;
+}
+
+static void *tracker_realloc(void *user, void *ptr, size_t old_size, size_t new_size)
+{
+    Tracker *t = user;
+    size_t *block = (size_t*)ptr - 1;
+    assert(block[0] == old_size);
+    block = realloc(block, sizeof(size_t) + new_size);
+    if (!block) return NULL;
+    block[0] = new_size;
+    t->live += new_size - old_size;
+    if (t->live > t->peak) t->peak = t->live;
+    t->calls++;
+    return block + 1;
+}
+
+static void tracker_free(void *user, void *ptr, size_t size)
+{
+    Tracker *t = user;
+    size_t *block = (size_t*)ptr - 1;
+    assert(block[0] == size);
+    t->live -= size;
+    free(block);
+}
+
+const char *object = "{\"name\": \"Jack\", \"age\": 20, \"tags\": [\"a\", \"b\", \"c\"], "
+                     "\"address\": {\"city\": \"Metropolis\", \"zip\": \"12345\"}}";
+
+int main(void)
+{
+    Tracker tracker = {0};
+    Json_Context ctx;
+    json_init(&ctx, .allocator = {
+        .alloc = tracker_alloc,
+        .realloc = tracker_realloc,
+        .free = tracker_free,
+        .user = &tracker,
+    });
+
+    if (!json_parse(&ctx, object, strlen(object))) return 1;
+    printf("after parse: %zu bytes live, %zu calls\n", tracker.live, tracker.calls);
+
+    json_fini(&ctx);
+    printf("after fini:  %zu bytes live, peak %zu bytes\n", tracker.live, tracker.peak);
+    return tracker.live == 0 ? 0 : 1;
+}
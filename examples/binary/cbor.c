@@ -0,0 +1,54 @@
+/*
+  Encode a parsed document as CBOR, decode it into a second context
+  and print it as text again; a truncated copy is rejected first.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+const char *object = "{\"name\": \"Jack\", \"age\": 20, \"height\": 1.83, \"student\": false, "
+                     "\"scores\": [90, -85.5, 77], \"address\": null}";
+
+typedef struct Bytes {
+    unsigned char data[1024];
+    size_t size;
+} Bytes;
+
+static void write_bytes(const void *data, size_t size, void *user)
+{
+    Bytes *bytes = user;
+    if (bytes->size + size > sizeof(bytes->data)) return;
+    memcpy(bytes->data + bytes->size, data, size);
+    bytes->size += size;
+}
+
+int main(void)
+{
+    Bytes bytes = {0};
+    Json_Context ctx, copy;
+
+    json_init(&ctx, .mode = JSON_CALLBACK_OUTPUT,
+              .write_bytes = write_bytes, .write_user = &bytes);
+    if (!json_parse(&ctx, object, strlen(object))) return 1;
+    json_cbor_dump(&ctx);
+    json_fini(&ctx);
+
+    printf("%zu bytes of JSON, %zu bytes of CBOR:\n", strlen(object), bytes.size);
+    for (size_t i = 0; i < bytes.size; i++) printf("%02x%s", bytes.data[i], i % 16 == 15 ? "\n" : " ");
+    printf("\n\n");
+
+    json_init(&copy, .indent = "  ");
+    /* cut short, it is rejected and leaves the context as it was */
+    if (!json_cbor_parse(&copy, bytes.data, bytes.size - 1)) {
+        const Json_Parse_Error *err = json_context_get_parse_error(&copy);
+        printf("first %zu bytes: at %zu, expected %s, found %s\n\n",
+               bytes.size - 1, err->offset, err->expected, err->found);
+    }
+    if (!json_cbor_parse(&copy, bytes.data, bytes.size)) return 1;
+    json_dump(&copy);
+    printf("\n");
+    json_fini(&copy);
+
+    return 0;
+}
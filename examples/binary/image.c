@@ -0,0 +1,58 @@
+/*
+  Save a parsed document as a tree image, then map the file and query
+  it in place without parsing anything.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char *catalog = "{\"version\": 3, \"routes\": ["
+                      "{\"path\": \"/users\", \"backend\": \"users-svc\", \"timeout\": 1.5},"
+                      "{\"path\": \"/orders\", \"backend\": \"orders-svc\", \"timeout\": 3}],"
+                      "\"maintenance\": false}";
+
+int main(void)
+{
+    /* once, at build time */
+    FILE *file = fopen("catalog.img", "wb");
+    if (!file) return 1;
+    Json_Context ctx;
+    json_init(&ctx, .output_file = file);
+    if (!json_parse(&ctx, catalog, strlen(catalog))) return 1;
+    json_image_dump(&ctx);
+    json_fini(&ctx);
+    fclose(file);
+
+    /* at startup, in every worker */
+    int fd = open("catalog.img", O_RDONLY);
+    if (fd < 0) return 1;
+    struct stat st;
+    fstat(fd, &st);
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return 1;
+
+    Json_Image image;
+    if (!json_image_open(&image, data, st.st_size)) return 1;
+
+    const Json_Image_Node *root = json_image_get_root(&image);
+    const Json_Image_Node *version = json_image_object_get_value(&image, root, "version");
+    printf("version: %g\n", json_image_to_number(version));
+
+    const Json_Image_Node *routes = json_image_object_get_value(&image, root, "routes");
+    for (size_t i = 0; i < json_image_array_get_size(routes); i++) {
+        const Json_Image_Node *route = json_image_array_get_value(&image, routes, i);
+        const Json_Image_Node *path = json_image_object_get_value(&image, route, "path");
+        const Json_Image_Node *backend = json_image_object_get_value(&image, route, "backend");
+        printf("%s -> %s\n", json_image_to_string(&image, path), json_image_to_string(&image, backend));
+    }
+
+    munmap(data, st.st_size);
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+  Reading a document from C++ through json.hpp.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.hpp"
+
+#include <utility>
+#include <vector>
+
+static const char *inventory =
+    "{\"store\": \"north\", \"open\": true,"
+    " \"items\": [{\"name\": \"bolt\", \"count\": 120, \"price\": 0.25},"
+    "            {\"name\": \"nut\", \"count\": 80, \"price\": 0.1},"
+    "            {\"name\": \"washer\", \"count\": 0}]}";
+
+/* the document is moved out, its tree is not copied */
+static json::Document load(std::string_view text)
+{
+    json::Document doc;
+    if (!doc.parse(text)) {
+        const Json_Parse_Error &err = doc.parse_error();
+        fprintf(stderr, "%zu:%zu: expected %s, found %s\n",
+                err.line, err.column, err.expected, err.found);
+    }
+    return doc;
+}
+
+int main(void)
+{
+    json::Document doc = load(inventory);
+    if (!doc.root()) return 1;
+
+    std::string_view store = doc["store"].get<std::string_view>();
+    printf("store: %.*s (%s)\n", (int)store.size(), store.data(),
+           doc["open"].get_or(false) ? "open" : "closed");
+
+    double total = 0;
+    for (json::Value item : doc["items"].elements()) {
+        int count = item["count"].get<int>();
+        total += count * item["price"].get_or(0.0);
+        printf("  %-8s %d\n", item["name"].get<const char*>(), count);
+    }
+    printf("stock value: %.2f\n", total);
+
+    /* members come in document order, with their keys as views */
+    for (json::Member member : doc["items"][0].members()) {
+        printf("  key '%.*s' is a %s\n", (int)member.key().size(), member.key().data(),
+               member.value().is_string() ? "string" : "number");
+    }
+
+    /* a missing member and everything below it are empty views */
+    json::Value missing = doc["owner"]["address"]["city"];
+    printf("owner city: %s\n", missing ? missing.get<const char*>() : "(none)");
+
+    std::vector<json::Document> docs;
+    docs.push_back(std::move(doc));
+    docs.push_back(load("[1, 2, 3]"));
+    printf("documents: %zu, last has %zu elements\n", docs.size(), docs.back().root().size());
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*
+  Telling whether two documents say the same thing: the canonical form
+  sorts members and writes numbers and strings one way only, and
+  json_hash gives equal documents equal hashes without writing anything.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+const char *first =
+    "{\"name\": \"t-04\", \"range\": [-0.0, 1e3, 0.000001],"
+    " \"label\": \"line\\u000a\\u00e9\", \"\\uff21\": 1, \"\\ud83d\\ude00\": 2}";
+
+const char *second =
+    "{\"\\ud83d\\ude00\": 2, \"\\uff21\": 1.0, \"label\": \"line\\n\\u00e9\","
+    " \"range\": [0, 1000, 1E-6], \"name\": \"t-04\"}";
+
+int main(void)
+{
+    Json_Context a, b;
+    json_init(&a);
+    json_init(&b, .pack_numbers = true);
+
+    if (!json_parse(&a, first, strlen(first))) return 1;
+    if (!json_parse(&b, second, strlen(second))) return 1;
+
+    /* keys in UTF-16 order: the emoji (a surrogate pair) before U+FF21 */
+    json_canonical_dump(&a);
+    printf("\n");
+    json_canonical_dump(&b);
+    printf("\n");
+
+    /* the order of members and a packed array do not change the hash */
+    Json_Hash ha = json_hash(a.root), hb = json_hash(b.root);
+    printf("hashes %s: %016llx%016llx\n", ha.lo == hb.lo && ha.hi == hb.hi ? "match" : "differ",
+           (unsigned long long)ha.hi, (unsigned long long)ha.lo);
+
+    json_fini(&a);
+    json_fini(&b);
+    return 0;
+}
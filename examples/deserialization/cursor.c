@@ -0,0 +1,59 @@
+/*
+  Walking a document without recursion: a cursor reports every value with
+  its key and depth, can pass over a subtree, and can stop at any point.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+const char *config =
+    "{\"name\": \"edge\","
+    " \"listen\": [{\"port\": 80}, {\"port\": 443, \"tls\": {\"cert\": \"a.pem\", \"key\": \"a.key\"}}],"
+    " \"secrets\": {\"token\": \"x\", \"salt\": \"y\"},"
+    " \"limits\": {\"rps\": 100, \"burst\": 20}}";
+
+int main(void)
+{
+    Json_Context ctx;
+    json_init(&ctx);
+    if (!json_parse(&ctx, config, strlen(config))) return 1;
+
+    /* the cursor keeps its stack between walks */
+    Json_Cursor cursor;
+    json_cursor_init(&ctx, &cursor);
+
+    /* an outline, without what is under "secrets" */
+    Json_Cursor_Event event;
+    json_cursor_begin(&cursor, ctx.root, JSON_CURSOR_DEPTH_FIRST);
+    while ((event = json_cursor_next(&cursor)) != JSON_CURSOR_END) {
+        if (event == JSON_CURSOR_LEAVE) continue;
+        printf("%*s", (int)(2*cursor.depth), "");
+        if (cursor.key) {
+            printf("%s", json_to_string(cursor.key));
+        } else if (cursor.depth == 0) {
+            printf("(root)");
+        } else {
+            printf("[%zu]", cursor.index);
+        }
+        if (event == JSON_CURSOR_ENTER && cursor.key && strcmp(json_to_string(cursor.key), "secrets") == 0) {
+            json_cursor_skip(&cursor);
+            printf(" (hidden)");
+        }
+        printf("\n");
+    }
+
+    /* level by level, stopping at the first number */
+    json_cursor_begin(&cursor, ctx.root, JSON_CURSOR_BREADTH_FIRST);
+    while (json_cursor_next(&cursor) != JSON_CURSOR_END) {
+        if (json_is_number(cursor.value)) {
+            printf("shallowest number: %s = %g at depth %zu\n",
+                   json_to_string(cursor.key), json_to_number(cursor.value), cursor.depth);
+            break;
+        }
+    }
+
+    json_cursor_fini(&cursor);
+    json_fini(&ctx);
+    return 0;
+}
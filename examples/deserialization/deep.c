@@ -0,0 +1,40 @@
+/*
+  Documents nested deeper than the initial scope stack make it grow, and
+  the root has to follow it to its new place.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+#define DEPTH 64
+
+int main(void)
+{
+    char input[2*DEPTH + 8];
+    size_t n = 0;
+    for (size_t i = 0; i < DEPTH; i++) input[n++] = '[';
+    n += sprintf(input + n, "42");
+    for (size_t i = 0; i < DEPTH; i++) input[n++] = ']';
+    input[n] = '\0';
+
+    Json_Context ctx;
+    json_init(&ctx);
+
+    if (!json_parse(&ctx, input, n)) return 1;
+
+    const Json_Value *value = json_context_get_root(&ctx);
+    size_t depth = 0;
+    while (json_is_array(value) && json_array_get_size(value) == 1) {
+        value = json_array_get_value(value, 0);
+        depth++;
+    }
+    if (depth != DEPTH || !json_is_number(value)) {
+        fprintf(stderr, "expected %d nested arrays, found %zu\n", DEPTH, depth);
+        return 1;
+    }
+    printf("depth: %zu, value: %d\n", depth, (int)json_to_number(value));
+
+    json_fini(&ctx);
+    return 0;
+}
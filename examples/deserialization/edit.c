@@ -0,0 +1,43 @@
+/*
+  Editing a parsed document in place and moving a subtree from one
+  document to another.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+int main(void)
+{
+    Json_Context ctx, inbox;
+    json_init(&ctx);
+    json_init(&inbox);
+
+    const char *user = "{\"name\": \"Jack\", \"age\": 20, \"tags\": [\"a\", \"c\"], \"draft\": true}";
+    const char *message = "{\"from\": \"Jill\", \"profile\": {\"age\": 21, \"city\": \"Paris\"}}";
+    if (!json_parse(&ctx, user, strlen(user))) return 1;
+    if (!json_parse(&inbox, message, strlen(message))) return 1;
+
+    Json_Value *root = ctx.root;
+
+    /* update a member in place and replace another one */
+    json_object_get_value_mut(root, "age")->as.number += 1;
+    json_object_set(&ctx, root, "name", json_new_string(&ctx, "Jack Smith"));
+
+    /* insert into the middle of an array and drop a member */
+    Json_Value *tags = json_object_get_value_mut(root, "tags");
+    json_array_insert(&ctx, tags, 1, json_new_string(&ctx, "b"));
+    json_object_remove(&ctx, root, "draft");
+
+    /* take the profile of the message without copying it */
+    Json_Value *profile = json_object_get_value_mut(inbox.root, "profile");
+    json_object_set(&ctx, root, "friend", json_move(&ctx, &inbox, profile));
+
+    json_dump(&ctx);
+    printf("\n");
+    json_dump(&inbox);
+
+    json_fini(&inbox);
+    json_fini(&ctx);
+    return 0;
+}
@@ -0,0 +1,36 @@
+/*
+  Picking a few fields out of a message without building the whole tree.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+int main(void)
+{
+    const char *message =
+        "{\"header\": {\"type\": \"order\", \"id\": 42},"
+        " \"body\": {\"items\": [{\"sku\": \"A-1\", \"qty\": 2}, {\"sku\": \"B-7\", \"qty\": 1}]},"
+        " \"signature\": \"...\"}";
+    const char *const paths[] = {"/header/type", "/header/id", "/body/items/1/sku", "/header/priority"};
+    const Json_Value *out[4];
+
+    Json_Context ctx;
+    json_init(&ctx);
+
+    if (!json_extract(&ctx, message, strlen(message), paths, 4, out)) return 1;
+
+    for (size_t i = 0; i < 4; i++) {
+        printf("%s: ", paths[i]);
+        if (!out[i]) {
+            printf("not found\n");
+        } else if (json_is_string(out[i])) {
+            printf("%s\n", json_to_string(out[i]));
+        } else if (json_is_number(out[i])) {
+            printf("%g\n", json_to_number(out[i]));
+        }
+    }
+
+    json_fini(&ctx);
+    return 0;
+}
@@ -0,0 +1,22 @@
+/*
+  A context whose input was rejected before anything was built must
+  still be safe to release.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+const char *input = "nope";
+
+int main(void)
+{
+    Json_Context ctx;
+    json_init(&ctx);
+
+    if (json_parse(&ctx, input, strlen(input))) return 1;
+    printf("rejected: %s\n", input);
+
+    json_fini(&ctx);
+    return 0;
+}
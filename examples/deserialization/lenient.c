@@ -0,0 +1,43 @@
+/*
+  Reading a hand-written configuration file, which strict JSON rejects.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+const char *config =
+    "// server settings\n"
+    "{\n"
+    "    name: 'edge-01',\n"
+    "    port: 0x1F90,          /* 8080 */\n"
+    "    ratio: .75,\n"
+    "    limit: Infinity,\n"
+    "    hosts: ['a', 'b',],\n"
+    "}\n";
+
+int main(void)
+{
+    Json_Context strict, lenient;
+    json_init(&strict, .indent = "  ");
+    json_init(&lenient, .indent = "  ", .lenient = true);
+
+    if (!json_parse(&strict, config, strlen(config))) {
+        const Json_Parse_Error *err = json_context_get_parse_error(&strict);
+        printf("strict: %zu:%zu: expected %s, found %s\n",
+               err->line, err->column, err->expected, err->found);
+    }
+
+    if (!json_parse(&lenient, config, strlen(config))) return 1;
+
+    const Json_Value *root = json_context_get_root(&lenient);
+    printf("name: %s\n", json_to_string(json_object_get_value(root, "name")));
+    printf("port: %d\n", (int)json_to_number(json_object_get_value(root, "port")));
+    printf("ratio: %g\n", json_to_number(json_object_get_value(root, "ratio")));
+    printf("limit: %g\n", json_to_number(json_object_get_value(root, "limit")));
+    printf("hosts: %zu\n", json_array_get_size(json_object_get_value(root, "hosts")));
+
+    json_fini(&strict);
+    json_fini(&lenient);
+    return 0;
+}
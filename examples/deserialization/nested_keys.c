@@ -0,0 +1,35 @@
+/*
+  Each nested container must keep the key it was opened under, even though
+  the members parsed inside it set their own keys in the meantime.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+const char *input =
+    "{\"user\": {\"name\": \"Ada\", \"address\": {\"city\": \"London\"}},"
+    " \"tags\": [\"math\", \"engines\"]}";
+
+int main(void)
+{
+    Json_Context ctx;
+    json_init(&ctx, .indent = "  ");
+
+    if (!json_parse(&ctx, input, strlen(input))) return 1;
+
+    const Json_Value *root = json_context_get_root(&ctx);
+    const Json_Value *user = json_object_get_value(root, "user");
+    const Json_Value *address = user ? json_object_get_value(user, "address") : NULL;
+    const Json_Value *tags = json_object_get_value(root, "tags");
+    if (!user || !address || !tags) {
+        fprintf(stderr, "nested keys were lost\n");
+        return 1;
+    }
+
+    json_dump(&ctx);
+    printf("\n");
+
+    json_fini(&ctx);
+    return 0;
+}
@@ -0,0 +1,34 @@
+/*
+  Numbers keep their sign and the full precision of a double.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+const char *input = "[-1, 2.5, -0.125, 16777217, 0.1]";
+const double expected[] = {-1, 2.5, -0.125, 16777217, 0.1};
+
+int main(void)
+{
+    Json_Context ctx;
+    json_init(&ctx);
+
+    if (!json_parse(&ctx, input, strlen(input))) return 1;
+
+    const Json_Value *root = json_context_get_root(&ctx);
+    size_t count = sizeof(expected)/sizeof(expected[0]);
+    if (json_array_get_size(root) != count) return 1;
+
+    for (size_t i = 0; i < count; i++) {
+        double number = json_to_number(json_array_get_value(root, i));
+        printf("%.17g\n", number);
+        if (number != expected[i]) {
+            fprintf(stderr, "expected %.17g\n", expected[i]);
+            return 1;
+        }
+    }
+
+    json_fini(&ctx);
+    return 0;
+}
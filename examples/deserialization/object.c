@@ -2,7 +2,7 @@
 #define JSON_ENABLE_DESERIALIZATION
 #include "json.h"
 
-const char *object = "{\"name\": \"Jack\", \"age\": 20, \"student\": false, }";
+const char *object = "{\"name\": \"Jack\", \"age\": 20, \"student\": false}";
 
 int main(void)
 {
@@ -0,0 +1,65 @@
+/*
+  Reading a series of samples as plain doubles: with .pack_numbers an
+  array made only of numbers is stored as one double[] and read as a span.
+  Patches that path through a number, a string or a packed element fail
+  and leave the document as it was.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+const char *series =
+    "{\"sensor\": \"t-04, north wall, second floor\","
+    " \"samples\": [21.5, 21.7, 22.1, 22.0, 21.8, 22.4, 23.0, 22.9],"
+    " \"offsets\": [0.5, -0.25],"
+    " \"flags\": [0, 1, \"calibrated\"]}";
+
+/* each one has to fail: there is nothing below its next to last token */
+const char *bad_patches[] = {
+    "[{\"op\": \"add\", \"path\": \"/sensor/x\", \"value\": 1}]",
+    "[{\"op\": \"add\", \"path\": \"/samples/1/x\", \"value\": 1}]",
+    "[{\"op\": \"add\", \"path\": \"/offsets/0/x\", \"value\": 1}]",
+};
+
+int main(void)
+{
+    Json_Context ctx;
+    json_init(&ctx, .indent = "  ", .pack_numbers = true);
+
+    if (!json_parse(&ctx, series, strlen(series))) return 1;
+
+    const Json_Value *samples = json_object_get_value(ctx.root, "samples");
+    const double *values = json_array_get_numbers(samples);
+    size_t n = json_array_get_size(samples);
+    double sum = 0, max = values[0];
+    for (size_t i = 0; i < n; i++) {
+        sum += values[i];
+        if (values[i] > max) max = values[i];
+    }
+    printf("samples: %zu, mean %.2f, max %.1f\n", n, sum / n, max);
+
+    /* an array with anything else in it keeps its values */
+    const Json_Value *flags = json_object_get_value(ctx.root, "flags");
+    printf("flags packed: %s\n", json_array_is_packed(flags) ? "yes" : "no");
+
+    /* editing unpacks the array, the document reads the same either way */
+    json_array_insert(&ctx, json_object_get_value_mut(ctx.root, "samples"), 0, json_new_string(&ctx, "start"));
+    printf("samples packed after insert: %s\n", json_array_is_packed(samples) ? "yes" : "no");
+    json_dump(&ctx);
+    printf("\n");
+
+    for (size_t i = 0; i < sizeof(bad_patches)/sizeof(bad_patches[0]); i++) {
+        Json_Context patch;
+        json_init(&patch);
+        if (!json_parse(&patch, bad_patches[i], strlen(bad_patches[i]))) return 1;
+        bool applied = json_patch_apply(&ctx, ctx.root, patch.root);
+        printf("patch %s: %s\n", json_to_string(json_object_get_value(json_array_get_value(patch.root, 0), "path")),
+               applied ? "applied" : "refused");
+        json_fini(&patch);
+        if (applied || !json_array_is_packed(json_object_get_value(ctx.root, "offsets"))) return 1;
+    }
+
+    json_fini(&ctx);
+    return 0;
+}
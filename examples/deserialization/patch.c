@@ -0,0 +1,84 @@
+/*
+  Computing the JSON Patch that turns one document into another, applying
+  it back, and updating a document with a JSON Merge Patch.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+#include <assert.h>
+
+static char *read_file(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "failed to open file: '%s'\n", filename);
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+
+    if (size <= 0) {
+        fprintf(stderr, "file '%s' is empty\n", filename);
+        fclose(fp);
+        return NULL;
+    }
+
+    char *buf = malloc(size + 1);
+    assert(buf != NULL);
+
+    size_t read = fread(buf, 1, size, fp);
+    fclose(fp);
+
+    if (read != (size_t)size) {
+        fprintf(stderr, "Read error: expected %ld bytes, got %zu\n", size, read);
+        free(buf);
+        return NULL;
+    }
+
+    buf[size] = '\0';
+    return buf;
+}
+
+static bool parse_file(Json_Context *ctx, const char *filename)
+{
+    char *input = read_file(filename);
+    if (!input) return false;
+    bool ok = json_parse(ctx, input, strlen(input));
+    free(input);
+    return ok;
+}
+
+int main(void)
+{
+    Json_Context from, to, patch, merge;
+    json_init(&from, .indent = "  ");
+    json_init(&to, .indent = "  ");
+    json_init(&patch, .indent = "  ");
+    json_init(&merge, .indent = "  ");
+
+    if (!parse_file(&from, "test1.json")) return 1;
+    if (!parse_file(&to, "test2.json")) return 1;
+
+    /* the operations that turn test1.json into test2.json */
+    json_diff(&patch, json_context_get_root(&from), json_context_get_root(&to));
+    json_dump(&patch);
+
+    if (!json_patch_apply(&from, from.root, json_context_get_root(&patch))) return 1;
+    assert(json_equal(&from, json_context_get_root(&from), json_context_get_root(&to)));
+
+    /* null removes a member, objects are merged recursively */
+    const char *changes = "{\"user\": {\"status\": null, \"name\": \"Jane Doe\"}, \"friends\": null}";
+    if (!json_parse(&merge, changes, strlen(changes))) return 1;
+    json_merge_patch(&from, from.root, json_context_get_root(&merge));
+    json_dump(&from);
+
+    json_fini(&merge);
+    json_fini(&patch);
+    json_fini(&to);
+    json_fini(&from);
+    return 0;
+}
@@ -0,0 +1,57 @@
+/*
+  Filtering and projecting records with a query compiled once.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+const char *orders =
+    "{\"orders\": ["
+    "  {\"id\": 1, \"customer\": {\"name\": \"Ana\"}, \"total\": 42.5, \"items\": [\"lamp\", \"bulb\"]},"
+    "  {\"id\": 2, \"customer\": {\"name\": \"Bo\"}, \"total\": 8, \"items\": [\"tape\"]},"
+    "  {\"id\": 3, \"customer\": {\"name\": \"Cy\"}, \"total\": 120, \"items\": [\"desk\", \"lamp\", \"chair\"]},"
+    "  {\"id\": 4, \"customer\": {\"name\": \"Ana\"}, \"total\": 15.25, \"items\": []}"
+    "]}";
+
+/* results are only valid during the call */
+static bool print_order(const Json_Value *order, void *user)
+{
+    const Json_Value *name = json_object_get_value(order, "name");
+    const Json_Value *first = json_object_get_value(order, "first");
+
+    (void)user;
+    printf("  #%g %s, %s\n", json_to_number(json_object_get_value(order, "id")),
+           json_to_string(name), json_is_string(first) ? json_to_string(first) : "-");
+    return true;
+}
+
+int main(void)
+{
+    Json_Context ctx;
+    json_init(&ctx);
+
+    if (!json_parse(&ctx, orders, strlen(orders))) return 1;
+
+    Json_Query *big = json_query_compile(&ctx,
+        ".orders[] | select(.total >= 15 and .items | length > 0)"
+        " | {id, name: .customer.name, first: .items[0]}");
+    if (!big) return 1;
+    printf("orders of 15 or more:\n");
+    json_query_run(&ctx, big, json_context_get_root(&ctx), print_order, NULL);
+    json_query_free(&ctx, big);
+
+    /* without a callback the results are only counted */
+    Json_Query *ana = json_query_compile(&ctx, ".orders[] | select(.customer.name == \"Ana\")");
+    printf("orders of Ana: %zu\n", json_query_run(&ctx, ana, json_context_get_root(&ctx), NULL, NULL));
+    json_query_free(&ctx, ana);
+
+    /* a bad query says where it went wrong, like json_parse */
+    if (!json_query_compile(&ctx, ".orders[] | select(.total > )")) {
+        const Json_Parse_Error *err = json_context_get_parse_error(&ctx);
+        printf("column %zu: expected %s, found %s\n", err->column, err->expected, err->found);
+    }
+
+    json_fini(&ctx);
+    return 0;
+}
@@ -0,0 +1,50 @@
+/*
+  Reading an export one record at a time: only the current record is
+  built, however many the array holds.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#include "json.h"
+
+const char *export =
+    "{\"exported_at\": \"2024-05-01T00:00:00Z\","
+    " \"schema\": {\"fields\": [\"id\", \"user\", \"amount\"]},"
+    " \"records\": ["
+    "  {\"id\": 1, \"user\": \"ada\", \"amount\": 12.5},"
+    "  {\"id\": 2, \"user\": \"brian\", \"amount\": 7},"
+    "  {\"id\": 3, \"user\": \"ada\", \"amount\": 30.25, \"note\": \"refund\"},"
+    "  {\"id\": 4, \"user\": \"carol\", \"amount\": 1.75}"
+    " ]}";
+
+int main(void)
+{
+    Json_Context ctx;
+    Json_Stream stream;
+    const Json_Value *record;
+    double total = 0;
+
+    json_init(&ctx);
+    /* everything before "records" is skipped, not built */
+    if (!json_stream_begin(&ctx, &stream, export, strlen(export), "/records")) return 1;
+
+    while ((record = json_stream_next(&stream))) {
+        const Json_Value *note = json_object_get_value(record, "note");
+        double amount = json_to_number(json_object_get_value(record, "amount"));
+        printf("#%g %-6s %6.2f%s%s\n",
+               json_to_number(json_object_get_value(record, "id")),
+               json_to_string(json_object_get_value(record, "user")), amount,
+               note ? "  " : "", note ? json_to_string(note) : "");
+        total += amount;
+    }
+    if (json_context_get_parse_error(&ctx)->code != JSON_PARSE_OK) {
+        const Json_Parse_Error *err = json_context_get_parse_error(&ctx);
+        fprintf(stderr, "%zu:%zu: expected %s\n", err->line, err->column, err->expected);
+        return 1;
+    }
+    printf("%zu records, total %.2f\n", stream.count, total);
+
+    json_stream_end(&stream);
+    json_fini(&ctx);
+    return 0;
+}
@@ -0,0 +1,29 @@
+/*
+  Checking payloads before forwarding them, without building a tree.
+*/
+
+#define JSON_IMPLEMENTATION
+#include "json.h"
+
+const char *payloads[] = {
+    "{\"name\": \"Jack\", \"tags\": [\"a\", \"b\"]}",
+    "{\"name\": \"Jack\", \"tags\": [\"a\", \"b\",]}",
+    "{\"name\": \"Jack\",\n \"age\": 0x14}",
+    "[1, 2, 3",
+    "\"a bare string\"",
+};
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(payloads)/sizeof(payloads[0]); i++) {
+        Json_Parse_Error err;
+        if (json_validate(payloads[i], strlen(payloads[i]), &err)) {
+            printf("payload %zu: valid\n", i);
+        } else {
+            printf("payload %zu: %zu:%zu (offset %zu): expected %s, found %s\n",
+                   i, err.line, err.column, err.offset, err.expected, err.found);
+        }
+    }
+
+    return 0;
+}
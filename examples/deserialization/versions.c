@@ -0,0 +1,44 @@
+/*
+  Keeping several versions of a configuration that differ by a few
+  fields: every version shares what it did not change with the others.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#define JSON_ENABLE_STATS
+#include "json.h"
+
+const char *config =
+    "{\"server\": {\"host\": \"edge-01\", \"port\": 80, \"tls\": false},"
+    " \"limits\": {\"requests\": 1000, \"burst\": 50},"
+    " \"users\": [\"jack\", \"jill\"]}";
+
+int main(void)
+{
+    Json_Context ctx, patch;
+    json_init(&ctx);
+    json_init(&patch);
+
+    if (!json_parse(&ctx, config, strlen(config))) return 1;
+
+    /* v1 turns TLS on, v2 also raises a limit; only those paths are copied */
+    size_t before = ctx.stats.allocations;
+    Json_Value v1 = json_share(&ctx, ctx.root);
+    json_unshare(&ctx, &v1, "/server/tls")->as.boolean = true;
+    json_unshare(&ctx, &v1, "/server/port")->as.number = 443;
+
+    Json_Value v2 = json_share(&ctx, &v1);
+    json_unshare(&ctx, &v2, "/limits/burst")->as.number = 200;
+    printf("two versions: %zu allocations\n", ctx.stats.allocations - before);
+
+    /* the untouched subtrees are the same memory, so diffing skips them */
+    json_diff(&patch, ctx.root, &v2);
+    json_dump(&patch);
+    printf("\n");
+
+    json_value_free(&ctx, &v1);
+    json_value_free(&ctx, &v2);
+    json_fini(&patch);
+    json_fini(&ctx);
+    return 0;
+}
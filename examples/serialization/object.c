@@ -10,6 +10,10 @@ int main(void)
         json_key(&ctx, "string");
         json_string(&ctx, "hello");
 
+        /* quotes, backslashes and control bytes, NUL included, come out escaped */
+        json_key(&ctx, "quoted\n");
+        json_string_n(&ctx, "say \"hi\"\tC:\\\0end", 16);
+
         json_key(&ctx, "number");
         json_number(&ctx, 1.2);
 
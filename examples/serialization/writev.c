@@ -0,0 +1,39 @@
+/*
+  Sending a response with a large payload: JSON_WRITEV_OUTPUT copies the
+  punctuation and short values into a staging buffer, and hands the long
+  string to writev(2) where it is in the tree, without copying it.
+*/
+
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_WRITEV
+#define JSON_ENABLE_STATS
+#include "json.h"
+
+int main(void)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char payload[2048];
+    for (size_t i = 0; i < sizeof(payload); i++) payload[i] = alphabet[(i*7 + i/64) % 64];
+
+    Json_Context ctx;
+    /* a socket or a file works the same, 1 is standard output */
+    json_init(&ctx, .indent = "  ", .mode = JSON_WRITEV_OUTPUT, .output_fd = 1);
+
+    json_object_begin(&ctx);
+        json_key(&ctx, "status");
+        json_number(&ctx, 200);
+        json_key(&ctx, "type");
+        json_string(&ctx, "image/png");
+        json_key(&ctx, "data");
+        json_string_n(&ctx, payload, sizeof(payload));
+    json_object_end(&ctx);
+
+    json_dump(&ctx);
+    printf("\n");
+
+    /* all of these left in one writev call: the payload in place, the rest staged */
+    fprintf(stderr, "writes: %zu, bytes: %zu\n", ctx.stats.sink_writes, ctx.stats.bytes_written);
+
+    json_fini(&ctx);
+    return 0;
+}
@@ -0,0 +1,26 @@
+#define JSON_IMPLEMENTATION
+#define JSON_ENABLE_DESERIALIZATION
+#define JSON_ENABLE_STATS_TIMING
+#include "json.h"
+
+const char *object = "{\"name\": \"Jack\", \"age\": 20, \"scores\": [90, 85.5, 77], "
+                     "\"address\": {\"city\": \"Metropolis\", \"zip\": \"12345\"}}";
+
+int main(void)
+{
+    Json_Context ctx;
+    json_init(&ctx, .indent = "  ");
+    json_stats_bind(&ctx);
+
+    if (!json_parse(&ctx, object, strlen(object))) return 1;
+
+    const Json_Value *root = json_context_get_root(&ctx);
+    json_object_get_value(root, "address");
+
+    json_dump(&ctx);
+    printf("\n\n");
+    json_print_stats(json_context_get_stats(&ctx));
+
+    json_fini(&ctx);
+    return 0;
+}
@@ -6,9 +6,10 @@ BRIEF:
   A C library for serializing and deserializing json.
 
 NOTICE:
-  This implementation directly supports serialization,
-  but for deserialization, 'stb_c_lexer.h' needs to be used.
-  And it is not compatiable with C++. (no test)
+  This implementation has no dependencies. json_parse accepts strict
+  RFC 8259 input with an object or an array at the top level (see
+  json_validate) unless '.lenient' is set in json_init.
+  It also compiles as C++; json.hpp wraps it for C++17.
 
 USAGE:
   In exactly one source file, define the implementation macro
@@ -20,6 +21,20 @@ USAGE:
   ```
   In other files, just include the header without the macro.
 
+  Define 'JSON_ENABLE_THREADS' (and link with -pthread) to let json_dump
+  split large containers across '.threads' worker threads. The allocator
+  of such a context has to be thread-safe.
+
+  Define 'JSON_ENABLE_WRITEV' on POSIX systems for JSON_WRITEV_OUTPUT,
+  which dumps to a file descriptor with writev(2) and hands long strings
+  to it where they are in the tree instead of copying them.
+
+  Define 'JSON_ENABLE_STATS' (in every file that includes this
+  header, it changes the layout of 'Json_Context') to collect
+  per-context counters in 'ctx->stats', and additionally
+  'JSON_ENABLE_STATS_TIMING' to record the time spent in each
+  phase. Without them the instrumentation compiles to nothing.
+
 LICENSE:
   See the end of this file for further details.
 */
@@ -31,6 +46,15 @@ LICENSE:
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#if defined(JSON_ENABLE_STATS_TIMING) && !defined(JSON_ENABLE_STATS)
+#define JSON_ENABLE_STATS
+#endif
 
 typedef enum Json_Value_Type {
     JSON_VALUE_NULL = 0,
@@ -54,32 +78,109 @@ typedef enum Json_Error_Code {
     JSON_KEY_OVERFLOW,
     JSON_INCORRECT_SCOPE,
     JSON_NO_SCOPE,
+    JSON_FROZEN,
+    JSON_OUT_OF_MEMORY,
 } Json_Error_Code;
 
+typedef enum Json_Parse_Error_Code {
+    JSON_PARSE_OK = 0,
+    JSON_PARSE_UNEXPECTED_END,
+    JSON_PARSE_UNEXPECTED_TOKEN,
+    JSON_PARSE_INVALID_CHARACTER,
+    JSON_PARSE_INVALID_LITERAL,
+    JSON_PARSE_INVALID_NUMBER,
+    JSON_PARSE_UNTERMINATED_STRING,
+    JSON_PARSE_CONTROL_CHARACTER,   /* unescaped, inside a string */
+    JSON_PARSE_INVALID_ESCAPE,
+    JSON_PARSE_INVALID_UTF8,
+    JSON_PARSE_TOO_DEEP,
+    JSON_PARSE_TRAILING_DATA,
+    JSON_PARSE_UNTERMINATED_COMMENT,
+    JSON_PARSE_DUPLICATE_KEY,
+    JSON_PARSE_KEY_TOO_LONG,
+    JSON_PARSE_OUT_OF_MEMORY,
+} Json_Parse_Error_Code;
+
+/* Where and why the input was rejected. The strings are static. */
+typedef struct Json_Parse_Error {
+    Json_Parse_Error_Code code;
+    size_t offset;          /* of the offending byte */
+    size_t line;            /* 1-based */
+    size_t column;          /* 1-based, in bytes */
+    const char *expected;
+    const char *found;
+} Json_Parse_Error;
+
 typedef struct Json_Value Json_Value;
 typedef struct Json_Pair Json_Pair;
 
+/* strings of at most this many bytes are stored in the value itself */
+#define JSON_SMALL_STRING_MAX 13
+
+/* A string carries its length and may hold any byte, it is followed by a
+   NUL all the same. A small one takes the bytes from 'hash' on instead
+   of an allocation; read strings with json_to_string and
+   json_string_length. */
 struct Json_Value {
-    Json_Value_Type type;
+    uint8_t type;           /* Json_Value_Type */
+    uint8_t indexed : 1;    /* object with a key index behind its members (json_freeze) */
+    uint8_t shared : 1;     /* container referenced by several values (json_share) */
+    uint8_t small : 4;      /* small string: its length + 1 */
+    uint8_t packed : 1;     /* array of numbers stored as doubles (pack_numbers) */
+    uint16_t hash;          /* of a key that is not small, compared first */
+    uint32_t length;        /* of a string that is not small */
     union {
         char *string;
         double number;
         bool boolean;
         Json_Pair *object; /* array of Json_Pair */
         Json_Value *array; /* array of Json_Value */
+        double *numbers;   /* array of double, for a packed array */
     } as;
 };
 
 struct Json_Pair {
-    char *key;
+    Json_Value key;         /* a string */
     Json_Value value;
 };
 
+/* A node of a tree image (see json_image_dump). Offsets are relative to
+   the start of the image, so it can be mapped at any address. */
+typedef struct Json_Image_Node {
+    uint32_t type;      /* Json_Value_Type */
+    uint32_t count;     /* members, elements or string length */
+    uint64_t payload;   /* number bits, boolean, or offset of the content */
+} Json_Image_Node;
+
+typedef struct Json_Image {
+    const unsigned char *data;
+    size_t size;
+} Json_Image;
+
+/* 128 bits of json_hash, 'lo' alone is a good 64-bit hash */
+typedef struct Json_Hash {
+    uint64_t lo, hi;
+} Json_Hash;
+
 typedef enum Json_Output_Mode {
     JSON_FILE_OUTPUT = 1,
-    JSON_BUFFER_OUTPUT
+    JSON_BUFFER_OUTPUT,
+    JSON_CALLBACK_OUTPUT, /* raw bytes to 'write_bytes', also for binary output */
+#ifdef JSON_ENABLE_WRITEV
+    JSON_WRITEV_OUTPUT,   /* writev(2) to 'output_fd', long strings are not copied */
+#endif /* JSON_ENABLE_WRITEV */
 } Json_Output_Mode;
 
+/* Every allocation of a context goes through this table. The sizes
+   passed to 'realloc' and 'free' are the ones originally requested,
+   so pool and arena allocators do not need to store them. */
+typedef struct Json_Allocator {
+    void *(*alloc)(void *user, size_t size);
+    void *(*realloc)(void *user, void *ptr, size_t old_size, size_t new_size);
+    void (*free)(void *user, void *ptr, size_t size);
+    void *user;
+} Json_Allocator;
+
 typedef struct Json_Opt {
     const char *indent;
     Json_Output_Mode mode;
@@ -88,29 +189,96 @@ typedef struct Json_Opt {
     size_t output_buffer_size;
     void (*write_to_file)(const char*, FILE*);
     FILE *output_file;
+    void (*write_bytes)(const void*, size_t, void*);
+    void *write_user;           /* last argument of 'write_bytes' */
+    int output_fd;              /* JSON_WRITEV_OUTPUT, standard output if 0 */
+    Json_Allocator allocator;   /* malloc/realloc/free if not specified */
+    void *memory;               /* with 'memory_size': the one block the context
+                                   carves everything from, instead of 'allocator' */
+    size_t memory_size;
+    size_t threads;             /* json_dump workers, needs JSON_ENABLE_THREADS */
+    bool shrink_to_fit;         /* release spare capacity when a scope ends */
+    bool lenient;               /* json_parse also takes comments, trailing commas,
+                                   single quotes, bare keys, hex, Infinity, NaN and
+                                   lone \u surrogates, read as U+FFFD */
+    bool pack_numbers;          /* json_parse keeps arrays of numbers as double[] */
 } Json_Opt;
 
+#ifdef JSON_ENABLE_STATS
+typedef struct Json_Stats {
+    size_t bytes_parsed;     /* input bytes handed to the parser */
+    size_t tokens;           /* tokens consumed by the parser */
+    size_t parse_errors;     /* inputs rejected by json_parse and json_cbor_parse */
+    size_t values[JSON_VALUE_BOOLEAN + 1]; /* indexed by Json_Value_Type */
+    size_t max_depth;        /* deepest scope nesting seen */
+    size_t allocations;      /* malloc/realloc/strdup calls */
+    size_t bytes_allocated;  /* bytes requested by those calls */
+    size_t vec_reallocs;     /* growth of an existing vector */
+    size_t key_compares;     /* key comparisons while looking up members */
+    size_t sink_writes;      /* calls into the output sink */
+    size_t bytes_written;    /* bytes handed to the output sink */
+    unsigned long long parse_ns; /* only with JSON_ENABLE_STATS_TIMING */
+    unsigned long long dump_ns;  /* only with JSON_ENABLE_STATS_TIMING */
+} Json_Stats;
+#endif /* JSON_ENABLE_STATS */
+
 typedef struct Json_Context {
     Json_Scope_Type scope_type; /* current scope type */
     Json_Value *scopes;         /* array of Json_Value (object or array) */
+    Json_Value *scope_keys;     /* member key of each nested scope */
     char *error_buffer;         /* store the latest error string */
     char *current_key;          /* store the current member key */
+    size_t current_key_size;
     Json_Value *root;           /* root object */
+    size_t output_pos;          /* end of the output in the default buffer */
+    struct Json__Writev *writev; /* JSON_WRITEV_OUTPUT during a dump */
+    struct Json__Recovery *recovery; /* where a failed allocation goes back to */
+    struct Json__Held *held;    /* aris_vec, freed if that allocation fails */
     Json_Error_Code code;
+    Json_Parse_Error parse_error; /* why the last json_parse failed */
     Json_Opt opt;
+#ifdef JSON_ENABLE_STATS
+    Json_Stats stats;
+#endif /* JSON_ENABLE_STATS */
 } Json_Context;
 
 #define json_init(ctx, ...) json_init_opt(ctx, (Json_Opt){__VA_ARGS__})
 void json_init_opt(Json_Context *ctx, Json_Opt opt);
 void json_fini(Json_Context *ctx);
 void json_dump(Json_Context *ctx);
+/* Appends 's' to the NUL-terminated text in 'buffer' (start it empty),
+   or drops it if it does not fit. A context with the default writer
+   fills output_buffer itself, from its own output_pos: its dumps follow
+   one another and binary output may hold NULs. */
 void json_default_write_to_buffer(const char *s, char *buffer, size_t size);
 void json_default_write_to_file(const char *s, FILE *file);
 void json_print_value(const Json_Value *value);
 
+/* Bounded memory: with Json_Opt.memory the context allocates nothing,
+   its buffers, scopes, values, keys and strings are all carved from that
+   block. Only the latest block can be given back, so a context is meant
+   to be used for one document and then reinitialized with the same
+   block; json_dump runs on the calling thread.
+   Running out of memory, in the block or when the allocator returns NULL,
+   never ends the program. The call that ran out returns false, NULL, a
+   null value, JSON_CURSOR_END or what it counted so far, and sets the
+   context code to JSON_OUT_OF_MEMORY (a frozen context stays frozen);
+   json_parse, json_extract, json_cbor_parse and json_query_compile also
+   set the parse error JSON_PARSE_OUT_OF_MEMORY. Lengths are 32 bits, so
+   a string of 4 GiB or more, and in json_image_dump and
+   json_canonical_dump an object or array of more than UINT32_MAX
+   members, fail the same way. The tree stays valid to read and to free:
+   a parse, an extract or a diff leaves nothing behind, an edit leaves the
+   value it was given to the caller, while the builders and patches keep
+   what they did so far and a dump stops short. */
+size_t json_memory_used(const Json_Context *ctx);
+
 /* serialization */
 bool json_key(Json_Context *ctx, const char *key);
 bool json_string(Json_Context *ctx, const char *value);
+/* same as above, for text that is not NUL-terminated or holds NULs */
+bool json_key_n(Json_Context *ctx, const char *key, size_t n);
+bool json_string_n(Json_Context *ctx, const char *value, size_t n);
 bool json_number(Json_Context *ctx, double value);
 bool json_boolean(Json_Context *ctx, bool value);
 bool json_null(Json_Context *ctx);
@@ -118,32 +286,301 @@ bool json_object_begin(Json_Context *ctx);
 bool json_object_end(Json_Context *ctx);
 bool json_array_begin(Json_Context *ctx);
 bool json_array_end(Json_Context *ctx);
+/* same as above, with room for 'n' members/elements reserved upfront */
+bool json_object_begin_n(Json_Context *ctx, size_t n);
+bool json_array_begin_n(Json_Context *ctx, size_t n);
+
+/* Well-formedness check without building a tree or allocating, 'err'
+   (may be NULL) tells where the input went wrong. It takes what
+   json_parse takes by default: RFC 8259 JSON whose top level is an
+   object or an array, since the root of a tree is one. A bare scalar,
+   which RFC 8259 also allows, is rejected by both, and so is a key
+   longer than 256 bytes. Only repeated keys, which need memory to find,
+   pass here: {"a":1,"a":2} validates, json_parse fails it with
+   JSON_PARSE_DUPLICATE_KEY. */
+bool json_validate(const char *input, size_t size, Json_Parse_Error *err);
 
 #ifdef JSON_ENABLE_DESERIALIZATION
-/* deserialization */
+/* deserialization, on failure the context is left as it was and
+   json_context_get_parse_error tells why */
 bool json_parse(Json_Context *ctx, const char *input, size_t size);
+/* Scan 'input' once and build only the values at the RFC 6901 'paths':
+   an array with one slot per path, 'out[i]' pointing at the slot or NULL
+   if the path is not in the document. Everything else is skipped without
+   being validated, and the scan stops when every path is found. */
+bool json_extract(Json_Context *ctx, const char *input, size_t size,
+                  const char *const *paths, size_t n, const Json_Value **out);
+
+/* Streaming over the elements of one array, for documents too large to
+   hold as a tree: json_stream_next parses the next element and returns
+   it, or NULL after the last one and on an error, which
+   json_context_get_parse_error then tells. The element returned before
+   is freed by that call, so the context holds one element at a time;
+   until then it reads like any other value. 'pointer' (RFC 6901) names
+   the array, "" or NULL for the document itself: the values on the way
+   are skipped without being validated, and the input after the array is
+   not read. The context must not hold a tree, json_stream_end leaves it
+   without one again. json_stream_begin also returns false for a
+   malformed pointer, with no parse error. Json_Opt.memory cannot reuse
+   what the elements gave back, so it bounds the whole array instead. */
+typedef struct Json_Stream {
+    Json_Context *ctx;
+    struct Json__Parser *parser;
+    size_t count;           /* elements returned so far */
+} Json_Stream;
+bool json_stream_begin(Json_Context *ctx, Json_Stream *stream, const char *input, size_t size,
+                       const char *pointer);
+const Json_Value *json_stream_next(Json_Stream *stream);
+void json_stream_end(Json_Stream *stream);
+
+/* Queries, a subset of jq compiled once and run over any number of trees:
+
+     .  .name  ."any key"  .[2]  .[-1]   one value, null if it is missing
+     .[]                                 every element or member value
+     .[1:3]                              elements 1 and 2, as an array
+     select(.price > 10 and .tags[0] == "x")
+     {name, id: .meta.id}                an object of the named values
+     length                              of an object, array or string
+     a | b                               b on every result of a
+
+   Conditions compare (== != < <= > >=, in jq's order of types) and
+   combine (and, or, parentheses) paths to one value, 'length', '.path |
+   length' and literals. json_query_run hands every result to 'fn', which
+   returns false to stop, and returns how many there were; 'fn' may be
+   NULL to only count them. Results point into the tree, except for
+   lengths, slices and objects built by the query, which are only valid
+   during the call. A query holds the scratch space of its slices and
+   objects, so it is run by one thread at a time. On a syntax error
+   json_query_compile returns NULL and json_context_get_parse_error tells
+   where the query went wrong. */
+typedef struct Json_Query Json_Query;
+typedef bool (*Json_Query_Fn)(const Json_Value *value, void *user);
+Json_Query *json_query_compile(Json_Context *ctx, const char *query);
+size_t json_query_run(Json_Context *ctx, Json_Query *query, const Json_Value *root,
+                      Json_Query_Fn fn, void *user);
+void json_query_free(Json_Context *ctx, Json_Query *query);
 #endif /* JSON_ENABLE_DESERIALIZATION */
 
+/* binary encoding (CBOR, RFC 8949), written to the same output as json_dump.
+   json_cbor_parse fails like json_parse: nothing of the input is kept and
+   the parse error has the byte offset, the input counting as one line. */
+void json_cbor_dump(Json_Context *ctx);
+bool json_cbor_parse(Json_Context *ctx, const void *data, size_t size);
+
+/* tree image: written once, then mapped and queried in place */
+void json_image_dump(Json_Context *ctx);
+bool json_image_open(Json_Image *image, const void *data, size_t size);
+const Json_Image_Node *json_image_get_root(const Json_Image *image);
+const Json_Image_Node *json_image_object_get_value(const Json_Image *image, const Json_Image_Node *node, const char *key);
+const char *json_image_object_get_key(const Json_Image *image, const Json_Image_Node *node, size_t idx);
+const Json_Image_Node *json_image_object_get_member(const Json_Image *image, const Json_Image_Node *node, size_t idx);
+const Json_Image_Node *json_image_array_get_value(const Json_Image *image, const Json_Image_Node *node, size_t idx);
+const char *json_image_to_string(const Json_Image *image, const Json_Image_Node *node);
+double json_image_to_number(const Json_Image_Node *node);
+#define json_image_object_get_size(node) ((node)->type == JSON_VALUE_OBJECT ? (size_t)(node)->count : 0)
+#define json_image_array_get_size(node)  ((node)->type == JSON_VALUE_ARRAY ? (size_t)(node)->count : 0)
+#define json_image_get_type(node)        ((Json_Value_Type)(node)->type)
+#define json_image_to_boolean(node)      ((node)->payload != 0)
+#define json_image_string_length(node)   ((size_t)(node)->count)
+
+/* Canonical JSON (RFC 8785), written to the same output as json_dump:
+   members sorted by key, no whitespace, the shortest number that reads
+   back the same and only the escapes JSON requires, so equal documents
+   give the same bytes. json_hash hashes that structure straight from the
+   tree instead: values json_equal finds equal hash the same, whatever
+   the order of their members or whether an array is packed, and the hash
+   is the same on every run and platform. */
+void json_canonical_dump(Json_Context *ctx);
+Json_Hash json_hash(const Json_Value *value);
+
+/* diff and patch (RFC 6902 JSON Patch, RFC 7396 JSON Merge Patch)
+   json_diff builds the patch array like json_parse builds a document, so
+   'from' and 'to' must not belong to the tree being built. A failed patch
+   may leave 'doc' partially patched. */
+bool json_equal(Json_Context *ctx, const Json_Value *a, const Json_Value *b);
+bool json_diff(Json_Context *ctx, const Json_Value *from, const Json_Value *to);
+bool json_patch_apply(Json_Context *ctx, Json_Value *doc, const Json_Value *patch);
+bool json_merge_patch(Json_Context *ctx, Json_Value *doc, const Json_Value *patch);
+
+#ifdef JSON_ENABLE_STATS
+/* statistics */
+void json_stats_reset(Json_Context *ctx);
+void json_stats_bind(Json_Context *ctx);
+void json_print_stats(const Json_Stats *stats);
+#define json_context_get_stats(context) (&(context)->stats)
+#endif /* JSON_ENABLE_STATS */
+
 /* query */
 const Json_Value *json_object_get_value(const Json_Value *root, const char *key);
+const Json_Value *json_object_get_value_n(const Json_Value *root, const char *key, size_t n);
 const Json_Pair *json_object_get_pair(const Json_Value *root, size_t idx);
 size_t json_object_get_size(const Json_Value *root);
 const Json_Value *json_array_get_value(const Json_Value *root, size_t idx);
 size_t json_array_get_size(const Json_Value *root);
+/* A packed array has no element values: json_array_get_value gives NULL
+   and its numbers are read as one span of json_array_get_size doubles.
+   Editing it turns it back into an array of values first. */
+const double *json_array_get_numbers(const Json_Value *root);
+#define json_array_is_packed(value) (json_is_array(value) && (value)->packed)
 #define json_context_get_root(context) ((context)->root)
+#define json_context_get_parse_error(context) (&(context)->parse_error)
 #define json_is_number(value)  ((value)->type == JSON_VALUE_NUMBER)
 #define json_is_string(value)  ((value)->type == JSON_VALUE_STRING)
 #define json_is_boolean(value) ((value)->type == JSON_VALUE_BOOLEAN)
 #define json_is_object(value)  ((value)->type == JSON_VALUE_OBJECT)
 #define json_is_array(value)   ((value)->type == JSON_VALUE_ARRAY)
 #define json_to_number(value)  ((value)->as.number)
-#define json_to_string(value)  ((value)->as.string)
 #define json_to_boolean(value) ((value)->as.boolean)
+static inline char *json_to_string(const Json_Value *value)
+{
+    return value->small ? (char*)&value->hash : value->as.string;
+}
+static inline size_t json_string_length(const Json_Value *value)
+{
+    return value->small ? (size_t)value->small - 1 : (size_t)value->length;
+}
+
+/* Walking a tree without recursion. json_cursor_next reports the values
+   from 'root' down one by one. Depth-first, an object or an array comes
+   with JSON_CURSOR_ENTER before its members and JSON_CURSOR_LEAVE after
+   them; breadth-first, level by level, only with ENTER. Right after an
+   ENTER, json_cursor_skip passes over its members. The cursor keeps its
+   own stack, allocated from 'ctx' and kept from one walk to the next, so
+   a deep tree costs no call stack and the walk may stop at any event.
+   The cursor only reads 'root', which may belong to another context; a
+   frozen tree can be walked by as many cursors as threads, each with a
+   context of its own, and must not change during a walk. 'value' and
+   'key' last until the next call (the element of a packed array is a
+   copy in the cursor). */
+typedef enum Json_Cursor_Event {
+    JSON_CURSOR_END = 0,    /* the walk is over */
+    JSON_CURSOR_VALUE,      /* a string, number, boolean or null */
+    JSON_CURSOR_ENTER,      /* an object or array, before its members */
+    JSON_CURSOR_LEAVE,      /* an object or array, after its members (depth-first) */
+} Json_Cursor_Event;
+
+typedef enum Json_Cursor_Order {
+    JSON_CURSOR_DEPTH_FIRST = 0,
+    JSON_CURSOR_BREADTH_FIRST,
+} Json_Cursor_Order;
+
+/* an object or array whose members are still to come */
+typedef struct Json_Cursor__Frame {
+    const Json_Value *value;
+    const Json_Value *key;
+    size_t index, depth;
+    size_t next, size;          /* its next member, and how many it has */
+} Json_Cursor__Frame;
+
+typedef struct Json_Cursor {
+    const Json_Value *value;    /* of the last event */
+    const Json_Value *key;      /* its key in the enclosing object, NULL otherwise */
+    size_t index;               /* its position in the enclosing object or array */
+    size_t depth;               /* 0 for the root */
+
+    Json_Context *ctx;
+    Json_Cursor__Frame *frames; /* aris_vec, a stack or (breadth-first) a queue */
+    Json_Cursor__Frame *top;    /* the innermost open container, depth-first */
+    size_t head;                /* first frame of the queue */
+    const Json_Value *root;     /* until its event */
+    Json_Cursor_Order order;
+    Json_Value element;         /* the current element of a packed array */
+} Json_Cursor;
+
+void json_cursor_init(Json_Context *ctx, Json_Cursor *cursor);
+void json_cursor_begin(Json_Cursor *cursor, const Json_Value *root, Json_Cursor_Order order);
+Json_Cursor_Event json_cursor_next(Json_Cursor *cursor);
+void json_cursor_skip(Json_Cursor *cursor);
+void json_cursor_fini(Json_Cursor *cursor);
+
+/* Read-only sharing. json_freeze indexes the keys of every larger object
+   and makes the tree read-only: building, parsing into and editing the
+   context fail with JSON_FROZEN until json_thaw. While frozen, the query
+   functions above and json_image_* only read the tree, so any number of
+   threads may call them without locks, as long as the context is handed
+   to them after json_freeze returns (thread creation, a mutex or a
+   release store all do). Statistics are not atomic: reader threads must
+   not json_stats_bind the frozen context. */
+bool json_freeze(Json_Context *ctx);
+void json_thaw(Json_Context *ctx);
+#define json_context_is_frozen(context) ((context)->code == JSON_FROZEN)
+
+/* editing, on a finished tree: inserted values are owned by the container
+   afterwards and must come from the same context (json_new_*, a take or
+   json_move). Pointers into a container are invalidated by insertions
+   and removals on it. */
+Json_Value json_new_string(Json_Context *ctx, const char *value);
+Json_Value json_new_string_n(Json_Context *ctx, const char *value, size_t n);
+Json_Value json_new_number(double value);
+Json_Value json_new_boolean(bool value);
+Json_Value json_new_null(void);
+Json_Value json_new_object(void);
+Json_Value json_new_array(void);
+void json_value_free(Json_Context *ctx, Json_Value *value);
+Json_Value *json_object_set(Json_Context *ctx, Json_Value *object, const char *key, Json_Value value);
+bool json_object_take(Json_Context *ctx, Json_Value *object, const char *key, Json_Value *out);
+bool json_object_remove(Json_Context *ctx, Json_Value *object, const char *key);
+Json_Value *json_array_insert(Json_Context *ctx, Json_Value *array, size_t idx, Json_Value value);
+Json_Value *json_array_set(Json_Context *ctx, Json_Value *array, size_t idx, Json_Value value);
+bool json_array_take(Json_Context *ctx, Json_Value *array, size_t idx, Json_Value *out);
+bool json_array_remove(Json_Context *ctx, Json_Value *array, size_t idx);
+/* move 'value' out of the tree of 'src' (a null is left in its place);
+   the subtree is relinked as is when both contexts share the allocator */
+Json_Value json_move(Json_Context *dst, Json_Context *src, Json_Value *value);
+#define json_object_get_value_mut(root, key) ((Json_Value*)json_object_get_value((root), (key)))
+#define json_array_get_value_mut(root, idx)  ((Json_Value*)json_array_get_value((root), (idx)))
+
+/* Copy-on-write versions. json_share returns another reference to the
+   object or array 'value' instead of a copy, so a new version of a
+   document costs one value. The editing functions above copy a shared
+   container one level deep before changing it, sharing its children, and
+   json_unshare does that for every container from 'root' down to
+   'pointer' (RFC 6901) and returns the value there, ready to be changed.
+   A change to a version therefore copies only that path. All versions
+   belong to contexts with the same allocator, and to one thread at a time
+   since the reference counts are not atomic; that includes a frozen one,
+   whose shared subtrees json_freeze leaves as they are. */
+Json_Value json_share(Json_Context *ctx, Json_Value *value);
+Json_Value *json_unshare(Json_Context *ctx, Json_Value *root, const char *pointer);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
 
 #endif /* JSON_H */
 
 #ifdef JSON_IMPLEMENTATION
 
+#include <ctype.h>
+#include <float.h>
+#include <stddef.h>
+#include <math.h>
+#include <setjmp.h>
+#ifdef JSON_ENABLE_THREADS
+#include <pthread.h>
+#endif /* JSON_ENABLE_THREADS */
+#ifdef JSON_ENABLE_WRITEV
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif /* JSON_ENABLE_WRITEV */
+
+/* C++ does not convert void* to other pointers implicitly, and warns
+   about the fields that designated initializers leave out */
+#ifdef __cplusplus
+#include <type_traits>
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif /* __GNUC__ */
+#define JSON__VOID_TO(vec, ptr) \
+    static_cast<std::remove_reference<decltype(vec)>::type>((void*)(ptr))
+#define JSON__THREAD_LOCAL thread_local
+#else
+#define JSON__VOID_TO(vec, ptr) ((void*)(ptr))
+#define JSON__THREAD_LOCAL _Thread_local
+#endif /* __cplusplus */
+
 typedef struct aris_vec_tor_header {
     size_t size;
     size_t capacity;
@@ -153,110 +590,682 @@ typedef struct aris_vec_tor_header {
     ((aris_vec_tor_header*)((char*)(vec) - sizeof(aris_vec_tor_header)))
 #define aris_vec__size(vec) ((vec) ? aris_vec__header(vec)->size : 0)
 #define aris_vec__capacity(vec)  ((vec) ? aris_vec__header(vec)->capacity : 0)
-#define aris_vec__push(vec, item)                                              \
+#define aris_vec__grow(ctx, vec, new_capacity)                                \
     do {                                                                       \
-        if (aris_vec__size(vec) + 1 > aris_vec__capacity(vec)) {               \
-            size_t new_capacity, alloc_size;                                   \
-            aris_vec_tor_header *new_header;                                   \
-                                                                               \
-            new_capacity = aris_vec__capacity(vec) == 0                        \
-                           ? 16 : 2 * aris_vec__capacity(vec);                 \
-            alloc_size = sizeof(aris_vec_tor_header) +                         \
-                         new_capacity*sizeof(*(vec));                          \
+        size_t aris__capacity = (new_capacity);                                \
+        size_t aris__alloc_size = sizeof(aris_vec_tor_header) +                \
+                                  aris__capacity*sizeof(*(vec));               \
+        aris_vec_tor_header *aris__header;                                     \
                                                                                \
-            if (vec) {                                                         \
-                new_header = realloc(aris_vec__header(vec), alloc_size);       \
-            } else {                                                           \
-                new_header = malloc(alloc_size);                               \
-                new_header->size = 0;                                          \
-            }                                                                  \
-            new_header->capacity = new_capacity;                               \
-                                                                               \
-            (vec) = (void*)((char*)new_header + sizeof(aris_vec_tor_header));  \
+        if (vec) {                                                             \
+            aris__header = (aris_vec_tor_header*)json__realloc(ctx,            \
+                aris_vec__header(vec), sizeof(aris_vec_tor_header) +           \
+                aris_vec__capacity(vec)*sizeof(*(vec)), aris__alloc_size);     \
+            JSON__STAT_ADD(ctx, vec_reallocs, 1);                              \
+        } else {                                                               \
+            aris__header = (aris_vec_tor_header*)json__malloc(ctx,             \
+                                                              aris__alloc_size); \
+            aris__header->size = 0;                                            \
         }                                                                      \
+        aris__header->capacity = aris__capacity;                               \
                                                                                \
+        (vec) = JSON__VOID_TO(vec,                                             \
+            (char*)aris__header + sizeof(aris_vec_tor_header));                \
+    } while (0)
+/* make sure the next push does not grow the vector */
+#define aris_vec__room(ctx, vec)                                               \
+    do {                                                                       \
+        if (aris_vec__size(vec) + 1 > aris_vec__capacity(vec)) {               \
+            aris_vec__grow(ctx, vec, aris_vec__capacity(vec) == 0              \
+                                     ? 16 : 2 * aris_vec__capacity(vec));      \
+        }                                                                      \
+    } while (0)
+#define aris_vec__push(ctx, vec, item)                                         \
+    do {                                                                       \
+        aris_vec__room(ctx, vec);                                              \
         (vec)[aris_vec__header(vec)->size++] = (item);                         \
     } while (0)
+/* make room for exactly 'n' elements in total */
+#define aris_vec__reserve(ctx, vec, n)                                         \
+    do {                                                                       \
+        if ((size_t)(n) > aris_vec__capacity(vec)) {                           \
+            aris_vec__grow(ctx, vec, (size_t)(n));                             \
+        }                                                                      \
+    } while (0)
+#define aris_vec__shrink(ctx, vec)                                             \
+    do {                                                                       \
+        if (aris_vec__size(vec) == 0) {                                        \
+            aris_vec__free(ctx, vec);                                          \
+        } else if (aris_vec__size(vec) < aris_vec__capacity(vec)) {            \
+            aris_vec__grow(ctx, vec, aris_vec__size(vec));                     \
+        }                                                                      \
+    } while (0)
 #define aris_vec__pop(vec) ((vec)[--aris_vec__header(vec)->size])
-#define aris_vec__free(vec)                   \
-    do {                                      \
-        if (vec) free(aris_vec__header(vec)); \
-        (vec) = NULL;                         \
+#define aris_vec__free(ctx, vec)                                               \
+    do {                                                                       \
+        if (vec) json__free(ctx, aris_vec__header(vec),                        \
+                            sizeof(aris_vec_tor_header) +                      \
+                            aris_vec__capacity(vec)*sizeof(*(vec)));           \
+        (vec) = NULL;                                                          \
     } while (0)
 #define aris_vec__reset(vec) ((vec) ? aris_vec__header(vec)->size = 0 : 0)
 
+#define JSON__ERROR_BUFFER_SIZE 1024
+#define JSON__KEY_MAX_SIZE      256
+#define JSON__ARENA_ALIGN       8   /* of every block carved from Json_Opt.memory */
+
+#define JSON__CBOR_MAX_DEPTH    1024
+#define JSON__PARALLEL_MIN_SIZE 256  /* smallest container split across threads */
+#define JSON__WRITEV_STAGING    16384 /* bytes copied before a writev */
+#define JSON__WRITEV_IOVECS     64  /* entries of one writev, below IOV_MAX (1024 on Linux and BSD) */
+#define JSON__WRITEV_MIN        512 /* shorter strings are copied, not referenced */
+#define JSON__IMAGE_MAGIC       0x494e534aU /* "JSNI" */
+#define JSON__IMAGE_VERSION     1
+#define JSON__IMAGE_ENDIAN      0x01020304U
+#define JSON__KEY_INDEX_MIN     8   /* smaller objects are scanned */
+#define JSON__SLOT_CACHE_BITS   6   /* 64 member slots remembered per thread */
+#define JSON__SHAPE_DEPTH       16  /* deepest objects whose key order the parser follows */
+#define JSON__NOT_FOUND         ((size_t)-1)
+#define JSON__MAX_DEPTH         1024 /* nesting accepted by json_validate */
+#define JSON__QUERY_STACK       16  /* values, and parentheses, a query condition nests */
+#define JSON__REFS(items)       (((size_t*)aris_vec__header(items))[-1]) /* of a shared vector */
+#define JSON__READABLE(ctx)     ((ctx)->code == JSON_OK || (ctx)->code == JSON_FROZEN)
+#define JSON__IS_DIGIT(c)       ((unsigned char)((c) - '0') < 10)
+#if defined(__GNUC__) || defined(__clang__)
+#define JSON__PREFETCH(p)       __builtin_prefetch(p)
+#else
+#define JSON__PREFETCH(p)       ((void)(p))
+#endif
+#define JSON__IS_IDENT(c)       (isalnum((unsigned char)(c)) || (c) == '_' || (c) == '$')
+#define JSON__ONES              0x0101010101010101ull
+#define JSON__HIGHS             0x8080808080808080ull
+/* some byte of the 8 in 'v' may be a control byte, a quote or a backslash */
+#define JSON__NEEDS_ESCAPE(v)                                                   \
+    ((((v) - JSON__ONES*0x20) | (((v) ^ JSON__ONES*'"') - JSON__ONES) |         \
+      (((v) ^ JSON__ONES*'\\') - JSON__ONES)) & ~(v) & JSON__HIGHS)
+#define JSON__DEPTH_GET(bits, i) (((bits)[(i)/64] >> ((i)%64)) & 1)
+#define JSON__DEPTH_SET(bits, i, on)                                    \
+    ((bits)[(i)/64] = ((bits)[(i)/64] & ~((uint64_t)1 << ((i)%64))) |  \
+                      ((uint64_t)(on) << ((i)%64)))
+
+/* tokens of json__lex, punctuation is the character itself */
+enum {
+    JSON__TOKEN_END = 256,
+    JSON__TOKEN_STRING,
+    JSON__TOKEN_NUMBER,
+    JSON__TOKEN_TRUE,
+    JSON__TOKEN_FALSE,
+    JSON__TOKEN_NULL,
+    JSON__TOKEN_IDENT,  /* lenient mode only */
+    JSON__TOKEN_COMPARE, /* queries only: == != < <= > >= */
+    JSON__TOKEN_ERROR,
+};
+
+typedef struct Json__Lexer {
+    const char *begin;
+    const char *cur;
+    const char *end;
+    const char *start;              /* first byte of the last token */
+    int token;
+    bool lenient;                   /* accept the extensions of Json_Opt.lenient */
+    bool escaped;                   /* the last string has escapes */
+    Json_Parse_Error_Code code;     /* why the last token is JSON__TOKEN_ERROR */
+    const char *error_at;
+} Json__Lexer;
+
+/* the keys of an object, in order */
+typedef struct Json__Shape {
+    const Json_Pair *pairs;
+    size_t size;
+} Json__Shape;
+
+/* where a key was last found, see json__object_find */
+typedef struct Json__Slot_Cache {
+    const char *key;    /* as passed in, usually a literal */
+    size_t slot;
+} Json__Slot_Cache;
+
 #ifdef JSON_ENABLE_DESERIALIZATION
-#define STB_C_LEXER_IMPLEMENTATION
-#include "stb_c_lexer.h"
+typedef struct Json__Parser {
+    Json__Lexer lex;
+    size_t *sizes;  /* element count of every container, in document order */
+    size_t *open;   /* aris_vec, entries of 'sizes' for the containers open while scanning */
+    size_t next;    /* entry of 'sizes' for the next container */
+    size_t depth;   /* open containers */
+    char *scratch;  /* aris_vec, unescaped strings */
+    double *numbers; /* aris_vec, leading numbers of the array being read */
+    Json__Shape shapes[JSON__SHAPE_DEPTH]; /* last object read at each depth */
+    char key[JSON__KEY_MAX_SIZE + 1];
+} Json__Parser;
+
+typedef struct Json__Extract_Token {
+    size_t offset;  /* of the unescaped token in 'names' */
+    size_t size;
+    size_t index;   /* the token as an array index, or JSON__NOT_FOUND */
+} Json__Extract_Token;
+
+typedef struct Json__Extract_Path {
+    size_t token;   /* first entry in 'tokens' */
+    size_t count;
+    bool found;
+} Json__Extract_Path;
+
+typedef struct Json__Extractor {
+    const char *begin;
+    const char *end;
+    Json__Extract_Path *paths;
+    Json__Extract_Token *tokens;    /* aris_vec */
+    char *names;                    /* aris_vec */
+    size_t *active;                 /* aris_vec, stack of the paths still matching */
+    char *scratch;                  /* aris_vec, unescaped strings */
+    Json__Parser parser;            /* of the container being stored */
+    size_t remaining;
+} Json__Extractor;
+
+/* instructions of a compiled query, in the order they run */
+enum {
+    JSON__QUERY_END,        /* a result */
+    JSON__QUERY_KEY,        /* member named by literal 'arg', or null */
+    JSON__QUERY_INDEX,      /* element 'from' (from the end if negative), or null */
+    JSON__QUERY_SLICE,      /* elements [from, to) as an array */
+    JSON__QUERY_EACH,       /* every element or member value */
+    JSON__QUERY_LENGTH,
+    JSON__QUERY_SELECT,     /* the condition up to 'next' decides if the value goes on */
+    JSON__QUERY_OBJECT,     /* an object of the 'arg' fields up to 'next' */
+    JSON__QUERY_FIELD,      /* key literal 'arg', valued by the path up to 'next' */
+    JSON__QUERY_PATH,       /* push the value of the path up to 'next' */
+    JSON__QUERY_LITERAL,    /* push literal 'arg' */
+    JSON__QUERY_COMPARE,    /* pop two values, push their comparison 'arg' */
+    JSON__QUERY_AND,        /* false on a falsy value and skip to 'next', or pop it */
+    JSON__QUERY_OR,         /* true on a truthy value and skip to 'next', or pop it */
+    JSON__QUERY_TRUTH,      /* the value on top as a boolean */
+};
+
+typedef struct Json__Query_Op {
+    int code;
+    size_t arg;
+    size_t next;            /* first instruction after the ones this one owns */
+    int64_t from, to;
+    Json_Value *items;      /* aris_vec, the array a slice hands on */
+    Json_Pair *pairs;       /* aris_vec, the object a projection hands on */
+} Json__Query_Op;
+
+typedef struct Json__Query_Compiler {
+    Json__Lexer lex;
+    Json_Query *query;
+    size_t depth;           /* values on the condition stack */
+    size_t nesting;         /* open parentheses */
+    bool boolean;           /* the last operand gives a boolean */
+    char *scratch;          /* aris_vec, unescaped strings */
+} Json__Query_Compiler;
+
+typedef struct Json__Query_Run {
+    Json_Context *ctx;
+    Json_Query *query;
+    Json_Query_Fn fn;
+    void *user;
+    size_t count;
+} Json__Query_Run;
+
+struct Json_Query {
+    Json__Query_Op *ops;    /* aris_vec */
+    Json_Value *literals;   /* aris_vec, keys and constants */
+};
 #endif /* JSON_ENABLE_DESERIALIZATION */
 
-#define JSON__ERROR_BUFFER_SIZE 1024
-#define JSON__KEY_MAX_SIZE      256
+/* Layout of an image, all in native byte order and 8-byte aligned:
+
+     header
+     strings:  bytes + NUL
+     array:    Json_Image_Node[count]
+     object:   Json_Image__Member[count], then uint32_t[count] with the
+               member indices sorted by key for binary search */
+typedef struct Json_Image__Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t endian;
+    uint32_t reserved;
+    uint64_t size;
+    Json_Image_Node root;
+} Json_Image__Header;
+
+typedef struct Json_Image__Member {
+    uint64_t key;       /* offset of the NUL-terminated key */
+    uint64_t key_size;
+    Json_Image_Node value;
+} Json_Image__Member;
+
+typedef struct Json_Image__Builder {
+    unsigned char *data;    /* aris_vec */
+    uint32_t *tmp;          /* aris_vec, scratch space of the key sort */
+} Json_Image__Builder;
+
+/* json_canonical_dump gathers its output before it goes to the sink */
+typedef struct Json__Canonical {
+    uint32_t *order;        /* aris_vec, sorted member indices of the open objects */
+    uint32_t *tmp;          /* aris_vec, scratch space of the key sort */
+    size_t used;
+    char buffer[4096];
+} Json__Canonical;
+
+#ifdef JSON_ENABLE_WRITEV
+/* JSON_WRITEV_OUTPUT during a dump: short writes are copied into
+   'staging' and long strings of the tree get an entry of their own, and
+   all of it goes out in one writev when either runs out of room */
+typedef struct Json__Writev {
+    struct iovec iov[JSON__WRITEV_IOVECS];
+    size_t count;           /* entries of 'iov' in use */
+    size_t staged;          /* bytes in 'staging' */
+    size_t covered;         /* staged bytes that already have an entry */
+    bool failed;            /* writev failed, the rest of the dump is dropped */
+    char staging[JSON__WRITEV_STAGING];
+} Json__Writev;
+#endif /* JSON_ENABLE_WRITEV */
+
+typedef int (*Json__Key_Compare)(const char *a, size_t a_size, const char *b, size_t b_size);
+
+/* the outermost json_parse or builder call, see JSON__RECOVER */
+typedef struct Json__Recovery {
+    jmp_buf jump;
+} Json__Recovery;
+
+/* what a call has allocated and not linked into a tree yet: a value, or
+   a scratch block of 'size' bytes if 'block' is set */
+typedef struct Json__Held {
+    Json_Value value;
+    void *block;
+    size_t size;
+} Json__Held;
+
+/* Json_Opt.memory, with this at its start: blocks are carved from the
+   front and only the last one can grow in place or be given back */
+typedef struct Json__Arena {
+    char *begin;
+    char *top;              /* first free byte */
+    char *end;
+    char *last;             /* the latest block, NULL once it is given back */
+} Json__Arena;
+
+/* temporary hash index over the keys of an object */
+typedef struct Json__Key_Index {
+    size_t *slots;  /* member index + 1, 0 for an empty slot */
+    size_t mask;
+    size_t size;    /* members covered by the index */
+} Json__Key_Index;
+
+#ifdef JSON_ENABLE_STATS
+#define JSON__STAT_ADD(ctx, field, n) ((ctx)->stats.field += (n))
+#define JSON__STAT_MAX(ctx, field, n)                       \
+    do {                                                    \
+        if ((ctx)->stats.field < (n)) (ctx)->stats.field = (n); \
+    } while (0)
+#else
+#define JSON__STAT_ADD(ctx, field, n) ((void)0)
+#define JSON__STAT_MAX(ctx, field, n) ((void)0)
+#endif /* JSON_ENABLE_STATS */
+
+#ifdef JSON_ENABLE_STATS_TIMING
+#define JSON__TIMER_BEGIN(ctx) unsigned long long json__timer_start = json__now_ns()
+#define JSON__TIMER_END(ctx, field) \
+    JSON__STAT_ADD(ctx, field, json__now_ns() - json__timer_start)
+#else
+#define JSON__TIMER_BEGIN(ctx) ((void)0)
+#define JSON__TIMER_END(ctx, field) ((void)0)
+#endif /* JSON_ENABLE_STATS_TIMING */
+
+/* around every dump, so that JSON_WRITEV_OUTPUT stages its output on the
+   stack of the dumping function and writes out what is left at the end */
+#ifdef JSON_ENABLE_WRITEV
+#define JSON__OUTPUT_BEGIN(ctx) Json__Writev json__writev; json__writev_begin(ctx, &json__writev)
+#define JSON__OUTPUT_END(ctx) json__writev_end(ctx)
+#else
+#define JSON__OUTPUT_BEGIN(ctx) ((void)0)
+#define JSON__OUTPUT_END(ctx) ((void)0)
+#endif /* JSON_ENABLE_WRITEV */
+
+/* Run 'body' so that an allocation failing anywhere under it comes back
+   here, frees what was held (json__hold) and runs 'fail' instead. Inside
+   another such call 'body' just runs, the outermost one recovers; 'body'
+   must not return. Every public function that allocates goes through
+   here. A local of the function using it that 'body' changes is
+   indeterminate after the longjmp (C11 7.13.2.1), so state that 'fail'
+   or the code after it reads lives in a caller's frame, as json_parse
+   keeps the parser that json__parse recovers. */
+#define JSON__RECOVER(ctx, body, fail)                                         \
+    do {                                                                       \
+        Json__Recovery json__recovery;                                         \
+        if ((ctx)->recovery) {                                                 \
+            body;                                                              \
+        } else if (setjmp(json__recovery.jump) == 0) {                         \
+            (ctx)->recovery = &json__recovery;                                 \
+            body;                                                              \
+            (ctx)->recovery = NULL;                                            \
+        } else {                                                               \
+            (ctx)->recovery = NULL;                                            \
+            json__drop_held(ctx);                                              \
+            fail;                                                              \
+        }                                                                      \
+    } while (0)
 
+static void *json__malloc(Json_Context *ctx, size_t size);
+static void *json__realloc(Json_Context *ctx, void *ptr, size_t old_size, size_t new_size);
+static void json__free(Json_Context *ctx, void *ptr, size_t size);
+static void json__hold_room(Json_Context *ctx);
+static void json__hold(Json_Context *ctx, const Json_Value *value);
+static void json__release(Json_Context *ctx);
+static void *json__hold_block(Json_Context *ctx, size_t size);
+static void json__release_block(Json_Context *ctx, void *block, size_t size);
+static void json__drop_held(Json_Context *ctx);
+static Json_Value json__new_string(Json_Context *ctx, const char *s, size_t n);
+static Json_Value json__new_key(Json_Context *ctx, const char *key, size_t n);
+static void json__free_string(Json_Context *ctx, Json_Value *value);
+static bool json__key_equal(const Json_Value *key, const char *s, size_t n, uint16_t hash);
+static bool json__key(Json_Context *ctx, const char *key, size_t n, bool check);
+static const Json_Value *json__object_find(Json_Context *ctx, const Json_Value *root, const char *key, size_t n);
 static void json__write(Json_Context *ctx, const char *s);
+static void json__write_n(Json_Context *ctx, const char *s, size_t n);
+static void json__write_ref(Json_Context *ctx, const char *s, size_t n);
 static void json__set_error(Json_Context *ctx, const char *key, Json_Error_Code code);
 static Json_Value *json__get_current_scope(Json_Context *ctx);
-static void json__append_element(Json_Context *ctx, char *key, Json_Value value);
-static void json__free_value(Json_Value *value);
-static void json__free_pair(Json_Pair *pair);
+static Json_Value json__member_key(Json_Context *ctx);
+static Json_Value json__held_key(Json_Context *ctx);
+static void json__element_room(Json_Context *ctx, Json_Value *scope);
+static void json__append_element(Json_Context *ctx, Json_Value key, Json_Value value);
+static void json__append_scalar(Json_Context *ctx, Json_Value value);
+static void json__append_string(Json_Context *ctx, const char *s, size_t n);
+static void json__free_value(Json_Context *ctx, Json_Value *value);
+static void json__free_pair(Json_Context *ctx, Json_Pair *pair);
 static void json__push_scope(Json_Context *ctx, Json_Value scope);
 static Json_Value json__pop_scope(Json_Context *ctx);
+static size_t json__escape(unsigned char ch, char *out);
+static size_t json__plain_size(const char *s, size_t n);
+static void json__dump_string(Json_Context *ctx, const char *s, size_t n);
 static void json__dump_pair(Json_Context *ctx, size_t level, Json_Pair *pair, bool comma);
+static void json__dump(Json_Context *ctx);
 static void json__dump_value(Json_Context *ctx, size_t level, Json_Value *value, bool indent);
+static void json__dump_members(Json_Context *ctx, size_t level, Json_Value *value, size_t begin, size_t end);
+#ifdef JSON_ENABLE_THREADS
+static void json__dump_members_parallel(Json_Context *ctx, size_t level, Json_Value *value, size_t size);
+#endif /* JSON_ENABLE_THREADS */
+#ifdef JSON_ENABLE_WRITEV
+static void json__writev_begin(Json_Context *ctx, Json__Writev *w);
+static void json__writev_end(Json_Context *ctx);
+static void json__writev_copy(Json_Context *ctx, Json__Writev *w, const char *s, size_t n);
+static void json__writev_ref(Json_Context *ctx, Json__Writev *w, const char *s, size_t n);
+static void json__writev_cover(Json__Writev *w);
+static void json__writev_flush(Json_Context *ctx, Json__Writev *w);
+#endif /* JSON_ENABLE_WRITEV */
+static void json__dump_numbers(Json_Context *ctx, size_t level, const double *numbers,
+                               size_t begin, size_t end, size_t size);
+static size_t json__format_number(double number, char *out);
 static void json__dump_indent(Json_Context *ctx, size_t level);
 static bool json_scope_begin(Json_Context *ctx, Json_Value scope);
 static bool json_scope_end(Json_Context *ctx);
+static void json__cbor_head(Json_Context *ctx, unsigned char major, unsigned long long arg);
+static void json__cbor_dump_value(Json_Context *ctx, const Json_Value *value);
+static bool json__cbor_fail(Json_Context *ctx, const unsigned char **data, const unsigned char *at,
+                            Json_Parse_Error_Code code, const char *expected, const char *found);
+static bool json__cbor_bad_arg(Json_Context *ctx, const unsigned char **data,
+                               const unsigned char *item, unsigned char info);
+static bool json__cbor_parse(Json_Context *ctx, const unsigned char **data, const unsigned char *end);
+static bool json__cbor_parse_value(Json_Context *ctx, const unsigned char **data,
+                                   const unsigned char *end, size_t depth);
+static void json__image_dump(Json_Context *ctx, Json_Image__Builder *b);
+static void json__image_write(Json_Context *ctx, Json_Image__Builder *b);
+static size_t json__image_reserve(Json_Context *ctx, Json_Image__Builder *b, size_t size, size_t align);
+static Json_Image_Node json__image_build(Json_Context *ctx, Json_Image__Builder *b, const Json_Value *value);
+static void json__sort_keys(uint32_t *idx, uint32_t *tmp, size_t n, const Json_Pair *pairs,
+                            Json__Key_Compare compare);
+static int json__image_key_compare(const char *a, size_t a_size, const char *b, size_t b_size);
+static void json__canonical_write(Json_Context *ctx, Json__Canonical *c, const char *s, size_t n);
+static void json__canonical_dump(Json_Context *ctx, Json__Canonical *c);
+static void json__canonical_value(Json_Context *ctx, Json__Canonical *c, const Json_Value *value);
+static void json__canonical_string(Json_Context *ctx, Json__Canonical *c, const char *s, size_t n);
+static size_t json__canonical_number(double number, char *out);
+static int json__canonical_key_compare(const char *a, size_t a_size, const char *b, size_t b_size);
+static Json_Hash json__hash_value(const Json_Value *value);
+static void json__hash_string(Json_Hash *h, const char *s, size_t n);
+static void json__hash_word(Json_Hash *h, uint64_t word);
+static uint64_t json__hash_mix(uint64_t x);
+static const void *json__image_at(const Json_Image *image, uint64_t offset, uint64_t size);
+static const char *json__string_or_empty(const Json_Value *value);
+static size_t json__hash_key(const char *key, size_t n);
+static void json__key_index_init(Json_Context *ctx, Json__Key_Index *index,
+                                 const Json_Pair *pairs, size_t size, size_t extra);
+static void json__key_index_fini(Json_Context *ctx, Json__Key_Index *index);
+static void json__key_index_add(Json__Key_Index *index, const Json_Pair *pairs, size_t idx);
+static size_t json__key_index_find(const Json__Key_Index *index, const Json_Pair *pairs, const Json_Value *key);
+static Json_Value json__clone_value(Json_Context *ctx, const Json_Value *value);
+static bool json__equal(Json_Context *ctx, const Json_Value *a, const Json_Value *b);
+static bool json__patch_apply(Json_Context *ctx, Json_Value *doc, const Json_Value *patch);
+static bool json__merge_patch(Json_Context *ctx, Json_Value *doc, const Json_Value *patch);
+static size_t *json__frozen_index(const Json_Value *object);
+static size_t json__frozen_bytes(const Json_Value *object);
+static void json__freeze_value(Json_Context *ctx, Json_Value *value);
+static void json__thaw_value(Json_Context *ctx, Json_Value *value);
+static void *json__items(const Json_Value *value);
+static void json__set_items(Json_Value *value, void *items);
+static size_t json__items_bytes(const Json_Value *value);
+static void json__free_items(Json_Context *ctx, Json_Value *value);
+static Json_Value json__share(Json_Context *ctx, Json_Value *value);
+static void json__unshare(Json_Context *ctx, Json_Value *value);
+static Json_Value *json__unshare_path(Json_Context *ctx, Json_Value *root, const char *pointer);
+static bool json__edit(Json_Context *ctx, Json_Value *value);
+static void json__object_add(Json_Context *ctx, Json_Value *object, const char *key, size_t n,
+                             Json_Value value);
+static void json__unpack(Json_Context *ctx, Json_Value *array);
+static const Json_Value *json__element(const Json_Value *array, size_t idx, Json_Value *tmp);
+static Json_Cursor_Event json__cursor_emit(Json_Cursor *cursor, const Json_Value *value,
+                                           const Json_Value *key, size_t idx, size_t depth);
+static void json__cursor_grow(Json_Cursor *cursor);
+static void json__append_value(Json_Context *ctx, const Json_Value *value);
+static size_t json__path_push(Json_Context *ctx, char **path, const char *token, size_t n);
+static void json__path_pop(char **path, size_t len);
+static bool json__diff(Json_Context *ctx, char **path, const Json_Value *from, const Json_Value *to);
+static void json__diff_root(Json_Context *ctx, char **path, const Json_Value *from, const Json_Value *to);
+static void json__diff_op(Json_Context *ctx, const char *op, const char *path, const Json_Value *value);
+static void json__diff_value(Json_Context *ctx, char **path, const Json_Value *from, const Json_Value *to);
+static bool json__pointer_token(const char **pointer, char *token, size_t size);
+static bool json__pointer_index(const char *token, size_t *index);
+static Json_Value *json__pointer_parent(Json_Context *ctx, Json_Value *doc, const char *pointer,
+                                       char *token, size_t size);
+static const Json_Value *json__pointer_get(const Json_Value *doc, const char *pointer, Json_Value *tmp);
+static bool json__pointer_put(Json_Context *ctx, Json_Value *doc, const char *pointer,
+                              Json_Value value, bool replace);
+static bool json__pointer_take(Json_Context *ctx, Json_Value *doc, const char *pointer, Json_Value *out);
+static bool json__same_allocator(const Json_Allocator *a, const Json_Allocator *b);
+static int json__lex(Json__Lexer *lx);
+static const char *json__lex_comments(Json__Lexer *lx, const char *c);
+static int json__lex_ident(Json__Lexer *lx, const char *c);
+static const char *json__lex_string(Json__Lexer *lx, const char *c);
+static long json__hex4(const char *c, const char *end);
+static size_t json__string_size(const Json__Lexer *lx);
+static const char *json__lex_number(Json__Lexer *lx, const char *c);
+static int json__lex_fail(Json__Lexer *lx, Json_Parse_Error_Code code, const char *at);
+static const char *json__lex_error(Json__Lexer *lx, Json_Parse_Error_Code code, const char *at);
+static const char *json__token_name(int token);
+static void json__parse_error(Json_Parse_Error *err, const Json__Lexer *lx,
+                              const char *expected);
+static void json__error_position(Json_Parse_Error *err, const char *begin, const char *at);
+static void json__parse_unwind(Json_Context *ctx, size_t depth);
 #ifdef JSON_ENABLE_DESERIALIZATION
-static long json__peek(stb_lexer *lex);
-static long json__advance(stb_lexer *lex);
-static bool json__consume(stb_lexer *lex, long expected, const char *msg);
-static bool json__parse_value(Json_Context *ctx, stb_lexer *lex);
-static bool json__parse_array(Json_Context *ctx, stb_lexer *lex);
-static bool json__parse_object(Json_Context *ctx, stb_lexer *lex);
+static int json__advance(Json_Context *ctx, Json__Parser *p);
+static bool json__parse_fail(Json_Context *ctx, Json__Parser *p, Json_Parse_Error_Code code,
+                             const char *expected);
+static bool json__parse(Json_Context *ctx, Json__Parser *p, const char *input, size_t size);
+static void json__parser_free(Json_Context *ctx, Json__Parser *p);
+static bool json__parse_document(Json_Context *ctx, Json__Parser *p, const char *input, size_t size);
+static bool json__stream_open(Json_Context *ctx, Json_Stream *stream, const char *input, size_t size,
+                              const char *pointer);
+static bool json__stream_seek(Json_Context *ctx, Json__Parser *p, const char *pointer);
+static bool json__stream_skip(Json_Context *ctx, Json__Parser *p, int close);
+static bool json__stream_element(Json_Context *ctx, Json__Parser *p);
+static void json__stream_drop(Json_Context *ctx);
+static void json__scan_sizes(Json_Context *ctx, Json__Parser *p, const char *input, size_t size);
+static bool json__token_is_word(int token);
+static size_t json__next_size(Json__Parser *p);
+static const char *json__token_string(Json_Context *ctx, Json__Parser *p, size_t *n);
+static double json__token_number(Json_Context *ctx, Json__Parser *p);
+static bool json__parse_value(Json_Context *ctx, Json__Parser *p);
+static bool json__parse_array(Json_Context *ctx, Json__Parser *p);
+static bool json__parse_numbers(Json_Context *ctx, Json__Parser *p, size_t size);
+static bool json__parse_object(Json_Context *ctx, Json__Parser *p);
+static const Json_Value *json__last_value(Json_Context *ctx);
+static const char *json__skip_ws(const char *c, const char *end);
+static const char *json__skip_string(const char *c, const char *end);
+static const char *json__skip_value(const char *c, const char *end);
+static size_t json__unescape(char *dst, const char *src, size_t n);
+static bool json__extract(Json_Context *ctx, Json__Extractor *e, const char *const *paths, size_t n,
+                          const Json_Value **out);
+static bool json__extract_document(Json_Context *ctx, Json__Extractor *e, const char *const *paths,
+                                   size_t n, const Json_Value **out);
+static bool json__extract_compile(Json_Context *ctx, Json__Extractor *e, size_t i, const char *pointer);
+static bool json__extract_key_match(Json_Context *ctx, Json__Extractor *e, const Json__Extract_Token *token,
+                                    const char *key, size_t size);
+static const char *json__extract_value(Json_Context *ctx, Json__Extractor *e, const char *c,
+                                       size_t first, size_t last, size_t depth);
+static bool json__extract_store(Json_Context *ctx, Json__Extractor *e, size_t i, const char *c, const char *end);
+static const Json_Value *json__extract_resolve(const Json__Extractor *e, const Json_Value *value,
+                                               const Json__Extract_Path *path, size_t depth,
+                                               Json_Value *tmp);
+static int json__query_lex(Json__Query_Compiler *qc);
+static bool json__query_word(const Json__Query_Compiler *qc, const char *word);
+static bool json__query_compile(Json_Context *ctx, Json__Query_Compiler *qc);
+static bool json__query_parse(Json_Context *ctx, Json__Query_Compiler *qc);
+static bool json__query_fail(Json_Context *ctx, Json__Query_Compiler *qc, const char *expected);
+static size_t json__query_emit(Json_Context *ctx, Json__Query_Compiler *qc, int code, size_t arg);
+static bool json__query_literal(Json_Context *ctx, Json__Query_Compiler *qc, bool key, size_t *idx);
+static bool json__query_integer(Json_Context *ctx, Json__Query_Compiler *qc, int64_t *out);
+static bool json__query_pipe(Json_Context *ctx, Json__Query_Compiler *qc);
+static bool json__query_stage(Json_Context *ctx, Json__Query_Compiler *qc);
+static bool json__query_path(Json_Context *ctx, Json__Query_Compiler *qc, bool single);
+static bool json__query_brackets(Json_Context *ctx, Json__Query_Compiler *qc, bool single);
+static bool json__query_object(Json_Context *ctx, Json__Query_Compiler *qc);
+static bool json__query_or(Json_Context *ctx, Json__Query_Compiler *qc);
+static bool json__query_and(Json_Context *ctx, Json__Query_Compiler *qc);
+static bool json__query_comparison(Json_Context *ctx, Json__Query_Compiler *qc);
+static bool json__query_operand(Json_Context *ctx, Json__Query_Compiler *qc);
+static bool json__query_push(Json_Context *ctx, Json__Query_Compiler *qc, size_t n);
+static void json__query_run(Json__Query_Run *run, const Json_Value *root);
+static bool json__query_eval(Json__Query_Run *run, size_t pc, const Json_Value *value);
+static const Json_Value *json__query_step(const Json_Query *q, const Json__Query_Op *op,
+                                          const Json_Value *value, Json_Value *tmp);
+static Json_Value json__query_slice(Json_Context *ctx, Json__Query_Op *op, const Json_Value *value);
+static Json_Value json__query_project(Json__Query_Run *run, size_t pc, const Json_Value *value);
+static bool json__query_test(Json__Query_Run *run, size_t pc, size_t end, const Json_Value *value);
+static bool json__query_compare(Json_Context *ctx, const Json_Value *a, const Json_Value *b, size_t op);
+static int json__query_rank(const Json_Value *value);
+static bool json__query_truthy(const Json_Value *value);
 #endif /* JSON_ENABLE_DESERIALIZATION */
+#ifdef JSON_ENABLE_STATS_TIMING
+static unsigned long long json__now_ns(void);
+#endif /* JSON_ENABLE_STATS_TIMING */
+static void *json__libc_alloc(void *user, size_t size);
+static void *json__libc_realloc(void *user, void *ptr, size_t old_size, size_t new_size);
+static void json__libc_free(void *user, void *ptr, size_t size);
+static Json__Arena *json__arena_init(void *memory, size_t size);
+static void *json__arena_alloc(void *user, size_t size);
+static void *json__arena_realloc(void *user, void *ptr, size_t old_size, size_t new_size);
+static void json__arena_free(void *user, void *ptr, size_t size);
+static void json__out_of_memory(Json_Context *ctx);
+static void json__memory_error(Json_Context *ctx);
+static void json__alloc_buffers(Json_Context *ctx);
+
+static const Json_Allocator json__default_allocator = {
+    .alloc = json__libc_alloc,
+    .realloc = json__libc_realloc,
+    .free = json__libc_free,
+};
 
 void json_init_opt(Json_Context *ctx, Json_Opt opt)
 {
-    ctx->scopes = NULL;
-    ctx->scope_type = JSON_SCOPE_NULL;
-    ctx->code = JSON_NO_SCOPE;
-    ctx->root = NULL;
-    ctx->error_buffer= malloc(JSON__ERROR_BUFFER_SIZE + 1);
-    ctx->current_key = malloc(JSON__KEY_MAX_SIZE + 1);
-    if (!ctx->error_buffer || !ctx->current_key) {
-        perror("malloc");
-        exit(EXIT_FAILURE);
-    }
-    json__set_error(ctx, NULL, JSON_NO_SCOPE);
-
     /* use the default configuration if it is not specified */
     if (!opt.indent)          opt.indent = "\t";
     if (!opt.mode)            opt.mode = JSON_FILE_OUTPUT;
     if (!opt.write_to_buffer) opt.write_to_buffer = json_default_write_to_buffer;
     if (!opt.write_to_file)   opt.write_to_file = json_default_write_to_file;
     if (!opt.output_file)     opt.output_file = stdout;
+    if (!opt.output_fd)       opt.output_fd = 1;
+    if (opt.memory) {
+        /* an arena is not shared between threads */
+        opt.allocator = (Json_Allocator){
+            .alloc = json__arena_alloc,
+            .realloc = json__arena_realloc,
+            .free = json__arena_free,
+            .user = json__arena_init(opt.memory, opt.memory_size),
+        };
+        opt.threads = 0;
+    }
+    if (!opt.allocator.alloc) opt.allocator = json__default_allocator;
     ctx->opt = opt;
+
+    ctx->scopes = NULL;
+    ctx->scope_keys = NULL;
+    ctx->scope_type = JSON_SCOPE_NULL;
+    ctx->code = JSON_NO_SCOPE;
+    ctx->root = NULL;
+    ctx->output_pos = 0;
+    ctx->writev = NULL;
+    ctx->recovery = NULL;
+    ctx->held = NULL;
+    ctx->current_key_size = 0;
+#ifdef JSON_ENABLE_STATS
+    json_stats_reset(ctx);
+#endif /* JSON_ENABLE_STATS */
+    /* Json_Opt.memory may be too small even for these */
+    ctx->error_buffer = NULL;
+    ctx->current_key = NULL;
+    JSON__RECOVER(ctx, json__alloc_buffers(ctx), ctx->code = JSON_OUT_OF_MEMORY; return);
+    json__set_error(ctx, NULL, JSON_NO_SCOPE);
+}
+
+size_t json_memory_used(const Json_Context *ctx)
+{
+    const Json__Arena *arena = (const Json__Arena*)ctx->opt.allocator.user;
+
+    if (!ctx->opt.memory || !arena) return 0;
+    return (size_t)(arena->top - arena->begin);
 }
 
 void json_fini(Json_Context *ctx)
 {
+    /* scopes a failed build left open are not attached to root yet */
+    while (aris_vec__size(ctx->scopes) > 1) {
+        json__free_value(ctx, &ctx->scopes[--aris_vec__header(ctx->scopes)->size]);
+    }
     /* ctx->root has the reference of ctx->scopes[0], so free the
        attached pairs first throuth root. */
-    json__free_value(ctx->root);
+    if (ctx->root) json__free_value(ctx, ctx->root);
     ctx->root = NULL;
-    aris_vec__free(ctx->scopes);
+    aris_vec__free(ctx, ctx->scopes);
+    while (aris_vec__size(ctx->scope_keys) > 0) {
+        json__free_string(ctx, &ctx->scope_keys[--aris_vec__header(ctx->scope_keys)->size]);
+    }
+    aris_vec__free(ctx, ctx->scope_keys);
+    aris_vec__free(ctx, ctx->held);
     ctx->scope_type = JSON_SCOPE_NULL;
     ctx->code = JSON_NO_SCOPE;
-    if (ctx->error_buffer) free(ctx->error_buffer);
-    if (ctx->current_key) free(ctx->current_key);
+    if (ctx->error_buffer) json__free(ctx, ctx->error_buffer, JSON__ERROR_BUFFER_SIZE + 1);
+    if (ctx->current_key) json__free(ctx, ctx->current_key, JSON__KEY_MAX_SIZE + 1);
     ctx->error_buffer = NULL;
     ctx->current_key = NULL;
 }
 
 void json_dump(Json_Context *ctx)
 {
-    if (ctx->code != JSON_OK) return;
-    json__dump_value(ctx, 0, ctx->root, true);
+    if (!JSON__READABLE(ctx)) return;
+    JSON__TIMER_BEGIN(ctx);
+    JSON__OUTPUT_BEGIN(ctx);
+    json__dump(ctx);
+    JSON__OUTPUT_END(ctx);
+    JSON__TIMER_END(ctx, dump_ns);
+}
+
+/* apart from json_dump, whose writev state a longjmp would leave
+   indeterminate in the frame of the setjmp */
+static void json__dump(Json_Context *ctx)
+{
+    JSON__RECOVER(ctx, json__dump_value(ctx, 0, ctx->root, true), json__memory_error(ctx));
 }
 
 void json_print_value(const Json_Value *value)
@@ -272,7 +1281,7 @@ void json_print_value(const Json_Value *value)
         printf("type: array, value: [...]\n");
         break;
     case JSON_VALUE_STRING:
-        printf("type: string, value: '%s'\n", value->as.string);
+        printf("type: string, value: '%.*s'\n", (int)json_string_length(value), json_to_string(value));
         break;
     case JSON_VALUE_NUMBER:
         printf("type: number, value: '%.15g'\n", value->as.number);
@@ -288,10 +1297,12 @@ void json_print_value(const Json_Value *value)
 
 void json_default_write_to_buffer(const char *s, char *buffer, size_t size)
 {
-    static size_t pos = 0;
+    /* the text written so far ends at the first NUL */
+    const char *end = (const char*)memchr(buffer, '\0', size);
+    size_t pos = end ? (size_t)(end - buffer) : 0;
     size_t len = strlen(s);
     if (pos + len < size) {
-        strncpy(buffer+pos, s, len);
+        memcpy(buffer+pos, s, len);
         pos += len;
         buffer[pos] = '\0';
     }
@@ -303,6 +1314,31 @@ void json_default_write_to_file(const char *s, FILE *file)
 }
 
 bool json_key(Json_Context *ctx, const char *key)
+{
+    return json_key_n(ctx, key, key ? strlen(key) : 0);
+}
+
+bool json_string(Json_Context *ctx, const char *value)
+{
+    return json_string_n(ctx, value, value ? strlen(value) : 0);
+}
+
+bool json_key_n(Json_Context *ctx, const char *key, size_t n)
+{
+    return json__key(ctx, key, n, true);
+}
+
+bool json_string_n(Json_Context *ctx, const char *value, size_t n)
+{
+    if (ctx->code != JSON_OK) return false;
+
+    JSON__RECOVER(ctx, json__append_string(ctx, value, n), json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY));
+
+    return ctx->code == JSON_OK;
+}
+
+/* json_key_n, where the caller may already know the key is not taken */
+static bool json__key(Json_Context *ctx, const char *key, size_t n, bool check)
 {
     if (ctx->code != JSON_OK) return false;
 
@@ -310,58 +1346,45 @@ bool json_key(Json_Context *ctx, const char *key)
         json__set_error(ctx, NULL, JSON_NULL_KEY);
         return false;
     }
-    if (strlen(key) > JSON__KEY_MAX_SIZE) {
-        json__set_error(ctx, key, JSON_KEY_OVERFLOW);
+
+    /* the key waits here for its value, the messages need it terminated */
+    size_t size = n < JSON__KEY_MAX_SIZE ? n : JSON__KEY_MAX_SIZE;
+    memcpy(ctx->current_key, key, size);
+    ctx->current_key[size] = '\0';
+    ctx->current_key_size = size;
+    if (n > JSON__KEY_MAX_SIZE) {
+        json__set_error(ctx, ctx->current_key, JSON_KEY_OVERFLOW);
         return false;
     }
 
     if (ctx->scope_type == JSON_SCOPE_NULL) {
-        json__set_error(ctx, key, JSON_NO_SCOPE);
+        json__set_error(ctx, ctx->current_key, JSON_NO_SCOPE);
         return false;
     } else if (ctx->scope_type == JSON_SCOPE_OBJECT) {
         /* check if the key already exists */
         Json_Value *scope = json__get_current_scope(ctx);
-        if (json_object_get_value(scope, key)) {
-            json__set_error(ctx, key, JSON_DOUBLE_KEY);
+        if (check && json__object_find(ctx, scope, key, n)) {
+            json__set_error(ctx, ctx->current_key, JSON_DOUBLE_KEY);
             return false;
-        } else {
-            snprintf(ctx->current_key, JSON__KEY_MAX_SIZE, "%s", key);
-            return true;
         }
+        return true;
     } else {
         json__set_error(ctx, NULL, JSON_INCORRECT_SCOPE);
         return false;
     }
 }
 
-bool json_string(Json_Context *ctx, const char *value)
-{
-    if (ctx->code != JSON_OK) return false;
-
-    Json_Value pair_value = {
-        .type = JSON_VALUE_STRING,
-        .as.string = value ? strdup(value) : NULL
-    };
-    char *pair_key = ctx->scope_type == JSON_SCOPE_ARRAY
-                     ? NULL : strdup(ctx->current_key);
-    json__append_element(ctx, pair_key, pair_value);
-
-    return true;
-}
-
 bool json_number(Json_Context *ctx, double value)
 {
     if (ctx->code != JSON_OK) return false;
 
     Json_Value pair_value = {
         .type = JSON_VALUE_NUMBER,
-        .as.number = value
+        .as = {.number = value},
     };
-    char *pair_key = ctx->scope_type == JSON_SCOPE_ARRAY
-                     ? NULL : strdup(ctx->current_key);
-    json__append_element(ctx, pair_key, pair_value);
+    JSON__RECOVER(ctx, json__append_scalar(ctx, pair_value), json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY));
 
-    return true;
+    return ctx->code == JSON_OK;
 }
 
 bool json_boolean(Json_Context *ctx, bool value)
@@ -370,13 +1393,11 @@ bool json_boolean(Json_Context *ctx, bool value)
 
     Json_Value pair_value = {
         .type = JSON_VALUE_BOOLEAN,
-        .as.boolean = value
+        .as = {.boolean = value},
     };
-    char *pair_key = ctx->scope_type == JSON_SCOPE_ARRAY
-                     ? NULL : strdup(ctx->current_key);
-    json__append_element(ctx, pair_key, pair_value);
+    JSON__RECOVER(ctx, json__append_scalar(ctx, pair_value), json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY));
 
-    return true;
+    return ctx->code == JSON_OK;
 }
 
 bool json_null(Json_Context *ctx)
@@ -386,11 +1407,9 @@ bool json_null(Json_Context *ctx)
     Json_Value pair_value = {
         .type = JSON_VALUE_NULL
     };
-    char *pair_key = ctx->scope_type == JSON_SCOPE_ARRAY
-                     ? NULL : strdup(ctx->current_key);
-    json__append_element(ctx, pair_key, pair_value);
+    JSON__RECOVER(ctx, json__append_scalar(ctx, pair_value), json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY));
 
-    return true;
+    return ctx->code == JSON_OK;
 }
 
 bool json_object_begin(Json_Context *ctx)
@@ -400,15 +1419,17 @@ bool json_object_begin(Json_Context *ctx)
     }
     Json_Value scope = {
         .type = JSON_VALUE_OBJECT,
-        .as.object = NULL,
+        .as = {.object = NULL},
     };
-    return json_scope_begin(ctx, scope);
+    JSON__RECOVER(ctx, json_scope_begin(ctx, scope), json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY));
+    return ctx->code == JSON_OK;
 }
 
 bool json_object_end(Json_Context *ctx)
 {
     if (ctx->code != JSON_OK) return false;
-    return json_scope_end(ctx);
+    JSON__RECOVER(ctx, json_scope_end(ctx), json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY));
+    return ctx->code == JSON_OK;
 }
 
 bool json_array_begin(Json_Context *ctx)
@@ -418,489 +1439,5543 @@ bool json_array_begin(Json_Context *ctx)
     }
     Json_Value scope = {
         .type = JSON_VALUE_ARRAY,
-        .as.array = NULL,
+        .as = {.array = NULL},
     };
-    return json_scope_begin(ctx, scope);
+    JSON__RECOVER(ctx, json_scope_begin(ctx, scope), json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY));
+    return ctx->code == JSON_OK;
 }
 
 bool json_array_end(Json_Context *ctx)
 {
     if (ctx->code != JSON_OK) return false;
-    return json_scope_end(ctx);
+    JSON__RECOVER(ctx, json_scope_end(ctx), json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY));
+    return ctx->code == JSON_OK;
 }
 
-#ifdef JSON_ENABLE_DESERIALIZATION
-bool json_parse(Json_Context *ctx, const char *input, size_t size)
+bool json_object_begin_n(Json_Context *ctx, size_t n)
 {
-    if (size == 0) return false;
-
-    stb_lexer lex = {0};
-    long token;
-    static char string_store[4096];
+    if (!json_object_begin(ctx)) return false;
+    JSON__RECOVER(ctx, aris_vec__reserve(ctx, json__get_current_scope(ctx)->as.object, n),
+                  json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY));
+    return ctx->code == JSON_OK;
+}
 
-    stb_c_lexer_init(&lex, input, input + size,
-                     string_store, sizeof(string_store));
+bool json_array_begin_n(Json_Context *ctx, size_t n)
+{
+    if (!json_array_begin(ctx)) return false;
+    JSON__RECOVER(ctx, aris_vec__reserve(ctx, json__get_current_scope(ctx)->as.array, n),
+                  json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY));
+    return ctx->code == JSON_OK;
+}
 
-    token = json__peek(&lex);
-    if (token == '{') {
-        return json__parse_object(ctx, &lex);
-    } else if (token == '[') {
-        return json__parse_array(ctx, &lex);
-    } else {
+bool json_validate(const char *input, size_t size, Json_Parse_Error *err)
+{
+    Json__Lexer lx = {.begin = input, .cur = input, .end = input + size};
+    uint64_t objects[JSON__MAX_DEPTH/64]; /* one bit per open scope, set for objects */
+    size_t depth = 0;
+    bool value = true;  /* 'token' has to start a value */
+    bool object = false;
+    const char *expected = "'{' or '['";
+    int token = json__lex(&lx);
+
+    if (token != '{' && token != '[') {
+        if (err) json__parse_error(err, &lx, expected);
         return false;
     }
-}
-#endif /* JSON_ENABLE_DESERIALIZATION */
+    for (;;) {
+        if (value) {
+            if (token == '{' || token == '[') {
+                expected = "fewer nested scopes";
+                if (depth == JSON__MAX_DEPTH) {
+                    lx.code = JSON_PARSE_TOO_DEEP;
+                    break;
+                }
+                object = token == '{';
+                JSON__DEPTH_SET(objects, depth, object);
+                depth++;
+
+                token = json__lex(&lx);
+                if (token == (object ? '}' : ']')) {
+                    depth--;
+                    value = false;
+                    continue;
+                }
+                if (object) {
+                    expected = "a string key or '}'";
+                    if (token != JSON__TOKEN_STRING) break;
+                    expected = "a key of at most 256 bytes";
+                    if (json__string_size(&lx) > JSON__KEY_MAX_SIZE) {
+                        lx.code = JSON_PARSE_KEY_TOO_LONG;
+                        break;
+                    }
+                    expected = "':'";
+                    if ((token = json__lex(&lx)) != ':') break;
+                    token = json__lex(&lx);
+                }
+            } else {
+                expected = "a value";
+                if (token < JSON__TOKEN_STRING || token > JSON__TOKEN_NULL) break;
+                value = false;
+            }
+            continue;
+        }
 
-const Json_Value *json_object_get_value(const Json_Value *root, const char *key)
-{
-    if (!key || !json_is_object(root)) return NULL;
+        token = json__lex(&lx);
+        if (depth == 0) {
+            expected = "end of input";
+            if (token == JSON__TOKEN_END) {
+                if (err) *err = (Json_Parse_Error){JSON_PARSE_OK};
+                return true;
+            }
+            if (token != JSON__TOKEN_ERROR) lx.code = JSON_PARSE_TRAILING_DATA;
+            break;
+        }
 
-    for (size_t i = 0; i < aris_vec__size(root->as.object); i++) {
-        Json_Pair *pair = &root->as.object[i];
-        if (pair->key && strcmp(pair->key, key) == 0) return &pair->value;
+        object = JSON__DEPTH_GET(objects, depth - 1);
+        if (token == (object ? '}' : ']')) {
+            depth--;
+            continue;
+        }
+        expected = object ? "',' or '}'" : "',' or ']'";
+        if (token != ',') break;
+
+        token = json__lex(&lx);
+        if (object) {
+            expected = "a string key";
+            if (token != JSON__TOKEN_STRING) break;
+            expected = "a key of at most 256 bytes";
+            if (json__string_size(&lx) > JSON__KEY_MAX_SIZE) {
+                lx.code = JSON_PARSE_KEY_TOO_LONG;
+                break;
+            }
+            expected = "':'";
+            if ((token = json__lex(&lx)) != ':') break;
+            token = json__lex(&lx);
+        }
+        value = true;
     }
 
-    return NULL;
+    if (err) json__parse_error(err, &lx, expected);
+    return false;
 }
 
-const Json_Pair *json_object_get_pair(const Json_Value *root, size_t idx)
+#ifdef JSON_ENABLE_DESERIALIZATION
+bool json_parse(Json_Context *ctx, const char *input, size_t size)
 {
-    if (!json_is_object(root) || idx >= aris_vec__size(root->as.object)) return NULL;
-    return &root->as.object[idx];
-}
+    Json__Parser p = {0};
+    bool ok = json__parse(ctx, &p, input, size);
 
-size_t json_object_get_size(const Json_Value *root)
-{
-    return json_is_object(root) ? aris_vec__size(root->as.object) : 0;
+    json__parser_free(ctx, &p);
+    return ok;
 }
 
-const Json_Value *json_array_get_value(const Json_Value *root, size_t idx)
+/* json_parse with a zeroed parser whose vectors the caller frees, also
+   when the parse is part of another call that runs out of memory */
+static bool json__parse(Json_Context *ctx, Json__Parser *p, const char *input, size_t size)
 {
-    if (!json_is_array(root) || idx >= aris_vec__size(root->as.array)) return NULL;
-    return &root->as.array[idx];
+    size_t depth = aris_vec__size(ctx->scopes);
+    bool ok;
+
+    ctx->parse_error = (Json_Parse_Error){JSON_PARSE_OK};
+    if (ctx->code == JSON_FROZEN) return false;
+    if (ctx->code == JSON_OUT_OF_MEMORY) {
+        ctx->parse_error.code = JSON_PARSE_OUT_OF_MEMORY;
+        return false;
+    }
+    JSON__TIMER_BEGIN(ctx);
+    JSON__STAT_ADD(ctx, bytes_parsed, size);
+    p->lex = (Json__Lexer){
+        .begin = input, .cur = input, .end = input + size,
+        .lenient = ctx->opt.lenient,
+    };
+
+    /* the root of a tree is a scope, so the document has to be one too */
+    json__advance(ctx, p);
+    if (p->lex.token == '{' || p->lex.token == '[') {
+        JSON__RECOVER(ctx, ok = json__parse_document(ctx, p, input, size),
+                      ok = json__parse_fail(ctx, p, JSON_PARSE_OUT_OF_MEMORY, "a document that fits in memory");
+                      json__memory_error(ctx));
+    } else {
+        ok = json__parse_fail(ctx, p, JSON_PARSE_OK, "'{' or '['");
+    }
+    if (!ok) json__parse_unwind(ctx, depth);
+    JSON__TIMER_END(ctx, parse_ns);
+
+    return ok;
 }
 
-size_t json_array_get_size(const Json_Value *root)
+static void json__parser_free(Json_Context *ctx, Json__Parser *p)
 {
-    return json_is_array(root) ? aris_vec__size(root->as.array) : 0;
+    aris_vec__free(ctx, p->sizes);
+    aris_vec__free(ctx, p->open);
+    aris_vec__free(ctx, p->scratch);
+    aris_vec__free(ctx, p->numbers);
 }
 
-static void json__write(Json_Context *ctx, const char *s)
+bool json_extract(Json_Context *ctx, const char *input, size_t size,
+                  const char *const *paths, size_t n, const Json_Value **out)
 {
-    if (ctx->opt.mode == JSON_BUFFER_OUTPUT) {
-        ctx->opt.write_to_buffer(s, ctx->opt.output_buffer,
-                                 ctx->opt.output_buffer_size);
-    } else {
-        ctx->opt.write_to_file(s, ctx->opt.output_file);
+    Json__Extractor e = {.begin = input, .end = input + size, .remaining = n};
+    bool ok = json__extract(ctx, &e, paths, n, out);
+
+    if (e.paths) json__free(ctx, e.paths, (n + 1)*sizeof(*e.paths));
+    aris_vec__free(ctx, e.tokens);
+    aris_vec__free(ctx, e.names);
+    aris_vec__free(ctx, e.active);
+    aris_vec__free(ctx, e.scratch);
+    json__parser_free(ctx, &e.parser);
+    /* the results that were found went with the tree */
+    if (ctx->parse_error.code == JSON_PARSE_OUT_OF_MEMORY) {
+        for (size_t i = 0; i < n; i++) out[i] = NULL;
     }
+
+    return ok;
 }
 
-static void json__set_error(Json_Context *ctx, const char *key, Json_Error_Code code)
+/* json_extract with an extractor whose memory the caller frees, also
+   when the extraction runs out of memory: a longjmp leaves it intact
+   only outside the frame of the setjmp */
+static bool json__extract(Json_Context *ctx, Json__Extractor *e, const char *const *paths, size_t n,
+                          const Json_Value **out)
 {
-    ctx->code = code;
-
-    switch (code) {
-    case JSON_OK:
-        break;
+    size_t depth = aris_vec__size(ctx->scopes);
+    bool ok;
 
-    case JSON_DOUBLE_KEY:
-        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
-                 "ERROR: double key '%s'!\n", key);
-        break;
+    for (size_t i = 0; i < n; i++) out[i] = NULL;
+    ctx->parse_error = (Json_Parse_Error){JSON_PARSE_OK};
+    if (!json_array_begin_n(ctx, n)) return false;
 
-    case JSON_NULL_KEY:
-        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
-                 "ERROR: null key!\n");
-        break;
+    JSON__RECOVER(ctx, ok = json__extract_document(ctx, e, paths, n, out),
+                  ok = false; json__parse_unwind(ctx, depth); json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY);
+                  ctx->parse_error.code = JSON_PARSE_OUT_OF_MEMORY);
 
-    case JSON_KEY_OVERFLOW:
-        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
-                 "ERROR: key overflow '%s' (maxsize = %d)!\n",
-                 key, JSON__KEY_MAX_SIZE);
-        break;
+    return ok;
+}
 
-    case JSON_NO_SCOPE:
-        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
-                 "ERROR: what was done without a scope!\n");
-        break;
+static bool json__extract_document(Json_Context *ctx, Json__Extractor *e, const char *const *paths,
+                                   size_t n, const Json_Value **out)
+{
+    const char *input = e->begin;
+    size_t size = (size_t)(e->end - e->begin);
+    const char *c;
+    bool ok = true;
+
+    /* one slot per path, filled as the paths are found */
+    for (size_t i = 0; i < n; i++) json_null(ctx);
+    e->paths = (Json__Extract_Path*)json__malloc(ctx, (n + 1)*sizeof(*e->paths));
+    for (size_t i = 0; i < n && ok; i++) {
+        ok = json__extract_compile(ctx, e, i, paths[i]);
+        aris_vec__push(ctx, e->active, i);
+    }
 
-    case JSON_INCORRECT_SCOPE:
-        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
-                 "ERROR: what was done within incorrect scope!\n");
-        break;
+    if (ok && n > 0) {
+        c = json__extract_value(ctx, e, json__skip_ws(input, e->end), 0, n, 0);
+        ok = c != NULL;
+    }
+    JSON__STAT_ADD(ctx, bytes_parsed, size);
+
+    /* the scan stops at the first thing it cannot skip, which is not
+       always where the input goes wrong: let the validator say where */
+    if (!ok) {
+        Json_Parse_Error error;
+        if (!json_validate(input, size, &error)) {
+            if (ctx->parse_error.code == JSON_PARSE_OK) JSON__STAT_ADD(ctx, parse_errors, 1);
+            ctx->parse_error = error;
+        }
+    }
 
-    default:
-        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
-                 "ERROR: unknown code!\n");
-        break;
+    Json_Value *results = json__get_current_scope(ctx);
+    if (results) {
+        for (size_t i = 0; i < n; i++) {
+            if (e->paths[i].found) out[i] = &results->as.array[i];
+        }
+    } else {
+        ok = false;
     }
+    json_array_end(ctx);
+
+    return ok;
 }
 
-static Json_Value *json__get_current_scope(Json_Context *ctx)
+bool json_stream_begin(Json_Context *ctx, Json_Stream *stream, const char *input, size_t size,
+                       const char *pointer)
 {
-    if (ctx->code != JSON_OK) return NULL;
-    if (aris_vec__size(ctx->scopes) == 0) return NULL;
-    return &ctx->scopes[aris_vec__size(ctx->scopes) - 1];
+    bool ok = false;
+
+    stream->ctx = ctx;
+    stream->parser = NULL;
+    stream->count = 0;
+    ctx->parse_error = (Json_Parse_Error){JSON_PARSE_OK};
+    if (ctx->root || ctx->code == JSON_FROZEN) return false;
+    if (ctx->code == JSON_OUT_OF_MEMORY) {
+        ctx->parse_error.code = JSON_PARSE_OUT_OF_MEMORY;
+        return false;
+    }
+    JSON__STAT_ADD(ctx, bytes_parsed, size);
+
+    JSON__RECOVER(ctx, ok = json__stream_open(ctx, stream, input, size, pointer ? pointer : ""),
+                  ok = false; ctx->parse_error.code = JSON_PARSE_OUT_OF_MEMORY; json__memory_error(ctx));
+    if (!ok) json_stream_end(stream);
+
+    return ok;
 }
 
-static void json__append_element(Json_Context *ctx, char *key, Json_Value value)
+const Json_Value *json_stream_next(Json_Stream *stream)
 {
-    Json_Value *scope = json__get_current_scope(ctx);
-    if (ctx->scope_type == JSON_SCOPE_OBJECT) {
-        Json_Pair pair = {key, value};
-        aris_vec__push(scope->as.object, pair);
-    } else if (ctx->scope_type == JSON_SCOPE_ARRAY) {
-        aris_vec__push(scope->as.array, value);
+    Json_Context *ctx = stream->ctx;
+    Json__Parser *p = stream->parser;
+    Json__Shape shapes[JSON__SHAPE_DEPTH];
+    Json_Value *elements;
+    bool ok = false;
+
+    if (!p || ctx->parse_error.code != JSON_PARSE_OK) return NULL;
+    if (p->lex.token == ']') {
+        json__stream_drop(ctx);
+        return NULL;
+    }
+
+    memcpy(shapes, p->shapes, sizeof(shapes));
+    JSON__RECOVER(ctx, ok = json__stream_element(ctx, p),
+                  ok = json__parse_fail(ctx, p, JSON_PARSE_OUT_OF_MEMORY, "an element that fits in memory");
+                  json__memory_error(ctx));
+    if (!ok) {
+        json__parse_unwind(ctx, 1);
+        json__stream_drop(ctx);
+        return NULL;
+    }
+
+    /* the element before goes, and with it the shapes only it had set */
+    elements = ctx->root->as.array;
+    if (aris_vec__size(elements) == 2) {
+        json__free_value(ctx, &elements[0]);
+        elements[0] = elements[1];
+        aris_vec__header(elements)->size = 1;
+    }
+    for (size_t i = 0; i < JSON__SHAPE_DEPTH; i++) {
+        if (p->shapes[i].pairs == shapes[i].pairs) p->shapes[i] = (Json__Shape){NULL, 0};
     }
+    stream->count++;
+
+    return &elements[0];
 }
 
-static void json__free_value(Json_Value *value)
+void json_stream_end(Json_Stream *stream)
 {
-    switch (value->type) {
-    case JSON_VALUE_OBJECT:
-        for (size_t i = 0; i < aris_vec__size(value->as.object); i++) {
-            json__free_pair(&value->as.object[i]);
-        }
-        aris_vec__free(value->as.object);
-        break;
+    Json_Context *ctx = stream->ctx;
+    Json__Parser *p = stream->parser;
 
-    case JSON_VALUE_ARRAY:
-        for (size_t i = 0; i < aris_vec__size(value->as.array); i++) {
-            json__free_value(&value->as.array[i]);
-        }
-        aris_vec__free(value->as.array);
-        break;
+    if (!p) return;
+    json__parser_free(ctx, p);
+    json__free(ctx, p, sizeof(*p));
+    stream->parser = NULL;
 
-    case JSON_VALUE_STRING:
-        if (value->as.string) free(value->as.string);
-        value->as.string = NULL;
-        break;
+    json__parse_unwind(ctx, 0);
+    json__set_error(ctx, NULL, JSON_NO_SCOPE);
+}
 
-    case JSON_VALUE_NUMBER:
-    case JSON_VALUE_BOOLEAN:
-    case JSON_VALUE_NULL:
-        break;
+Json_Query *json_query_compile(Json_Context *ctx, const char *query)
+{
+    Json__Query_Compiler qc = {0};
+    bool ok;
 
-    default:
-        break;
+    ctx->parse_error = (Json_Parse_Error){JSON_PARSE_OK};
+    qc.lex = (Json__Lexer){
+        .begin = query, .cur = query, .end = query + strlen(query),
+        .lenient = true,    /* for the bare words */
+    };
+
+    ok = json__query_compile(ctx, &qc);
+    aris_vec__free(ctx, qc.scratch);
+    if (!ok) {
+        json_query_free(ctx, qc.query);
+        return NULL;
     }
+
+    return qc.query;
 }
 
-static void json__free_pair(Json_Pair *pair)
+size_t json_query_run(Json_Context *ctx, Json_Query *query, const Json_Value *root,
+                      Json_Query_Fn fn, void *user)
 {
-    if (pair->key) free(pair->key);
-    pair->key = NULL;
-    json__free_value(&pair->value);
+    Json__Query_Run run = {.ctx = ctx, .query = query, .fn = fn, .user = user};
+
+    if (root) json__query_run(&run, root);
+    return run.count;
 }
 
-static void json__push_scope(Json_Context *ctx, Json_Value scope)
+/* the count outlives a failure in the caller's frame, not in the one of
+   the setjmp */
+static void json__query_run(Json__Query_Run *run, const Json_Value *root)
 {
-    aris_vec__push(ctx->scopes, scope);
-    ctx->scope_type = scope.type == JSON_VALUE_ARRAY
-                      ? JSON_SCOPE_ARRAY : JSON_SCOPE_OBJECT;
+    JSON__RECOVER(run->ctx, json__query_eval(run, 0, root), json__memory_error(run->ctx));
 }
 
-static Json_Value json__pop_scope(Json_Context *ctx)
+void json_query_free(Json_Context *ctx, Json_Query *query)
 {
-    Json_Value res = ctx->scopes[--aris_vec__header(ctx->scopes)->size];
+    if (!query) return;
 
-    if (aris_vec__size(ctx->scopes) > 0) {
-        Json_Value *scope = json__get_current_scope(ctx);
-        ctx->scope_type = scope->type == JSON_VALUE_ARRAY
-                          ? JSON_SCOPE_ARRAY : JSON_SCOPE_OBJECT;
+    for (size_t i = 0; i < aris_vec__size(query->ops); i++) {
+        aris_vec__free(ctx, query->ops[i].items);
+        aris_vec__free(ctx, query->ops[i].pairs);
     }
+    for (size_t i = 0; i < aris_vec__size(query->literals); i++) {
+        json__free_string(ctx, &query->literals[i]);
+    }
+    aris_vec__free(ctx, query->ops);
+    aris_vec__free(ctx, query->literals);
+    json__free(ctx, query, sizeof(*query));
+}
+#endif /* JSON_ENABLE_DESERIALIZATION */
+
+bool json_equal(Json_Context *ctx, const Json_Value *a, const Json_Value *b)
+{
+    bool equal = false;
+
+    JSON__RECOVER(ctx, equal = json__equal(ctx, a, b), equal = false; json__memory_error(ctx));
+    return equal;
+}
+
+bool json_diff(Json_Context *ctx, const Json_Value *from, const Json_Value *to)
+{
+    char *path = NULL;
+    bool ok = json__diff(ctx, &path, from, to);
+
+    aris_vec__free(ctx, path);
+    return ok;
+}
+
+/* json_diff with a path the caller frees, kept out of the frame of the
+   setjmp so that a longjmp leaves it intact */
+static bool json__diff(Json_Context *ctx, char **path, const Json_Value *from, const Json_Value *to)
+{
+    size_t depth = aris_vec__size(ctx->scopes);
+    bool ok;
+
+    if (!json_array_begin(ctx)) return false;
+    /* like a parse, a diff that runs out of memory leaves nothing behind */
+    JSON__RECOVER(ctx, json__diff_root(ctx, path, from, to); ok = json_array_end(ctx),
+                  ok = false; json__parse_unwind(ctx, depth); json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY));
+
+    return ok;
+}
+
+bool json_patch_apply(Json_Context *ctx, Json_Value *doc, const Json_Value *patch)
+{
+    bool ok = false;
+
+    if (ctx->code == JSON_FROZEN || !json_is_array(patch)) return false;
+    JSON__RECOVER(ctx, ok = json__patch_apply(ctx, doc, patch), ok = false; json__memory_error(ctx));
+    return ok;
+}
+
+bool json_merge_patch(Json_Context *ctx, Json_Value *doc, const Json_Value *patch)
+{
+    bool ok = false;
+
+    if (ctx->code == JSON_FROZEN) return false;
+    JSON__RECOVER(ctx, ok = json__merge_patch(ctx, doc, patch), ok = false; json__memory_error(ctx));
+    return ok;
+}
+
+static bool json__equal(Json_Context *ctx, const Json_Value *a, const Json_Value *b)
+{
+    if (a->type != b->type) return false;
+    /* versions share the subtrees they did not change */
+    if ((json_is_object(a) || json_is_array(a)) && json__items(a) == json__items(b)) return true;
+
+    switch (a->type) {
+    case JSON_VALUE_OBJECT: {
+        size_t size = aris_vec__size(a->as.object);
+        Json__Key_Index index;
+        bool equal = true;
+
+        if (size != aris_vec__size(b->as.object)) return false;
+        json__key_index_init(ctx, &index, a->as.object, size, 0);
+        for (size_t i = 0; i < size && equal; i++) {
+            Json_Pair *pair = &b->as.object[i];
+            size_t j = json__key_index_find(&index, a->as.object, &pair->key);
+            equal = j != JSON__NOT_FOUND &&
+                    json__equal(ctx, &a->as.object[j].value, &pair->value);
+        }
+        json__key_index_fini(ctx, &index);
+        return equal;
+    }
+
+    case JSON_VALUE_ARRAY:
+        if (aris_vec__size(a->as.array) != aris_vec__size(b->as.array)) return false;
+        for (size_t i = 0; i < aris_vec__size(a->as.array); i++) {
+            Json_Value tmp_a, tmp_b;
+            if (!json__equal(ctx, json__element(a, i, &tmp_a), json__element(b, i, &tmp_b))) return false;
+        }
+        return true;
+
+    case JSON_VALUE_STRING:
+        return json_string_length(a) == json_string_length(b) &&
+               memcmp(json__string_or_empty(a), json__string_or_empty(b), json_string_length(a)) == 0;
+
+    case JSON_VALUE_NUMBER:
+        return a->as.number == b->as.number;
+
+    case JSON_VALUE_BOOLEAN:
+        return a->as.boolean == b->as.boolean;
+
+    default:
+        return true;
+    }
+}
+
+/* a failed operation leaves the ones before it applied */
+static bool json__patch_apply(Json_Context *ctx, Json_Value *doc, const Json_Value *patch)
+{
+    for (size_t i = 0; i < aris_vec__size(patch->as.array); i++) {
+        const Json_Value *operation = &patch->as.array[i];
+        const Json_Value *op = json_object_get_value(operation, "op");
+        const Json_Value *path = json_object_get_value(operation, "path");
+        const Json_Value *from = json_object_get_value(operation, "from");
+        const Json_Value *value = json_object_get_value(operation, "value");
+        const char *name;
+        bool ok;
+
+        if (!op || !json_is_string(op) || !path || !json_is_string(path)) return false;
+        if (from && !json_is_string(from)) return false;
+        name = json__string_or_empty(op);
+
+        if (strcmp(name, "add") == 0 || strcmp(name, "replace") == 0) {
+            if (!value) return false;
+            json__hold_room(ctx);
+            Json_Value copy = json__clone_value(ctx, value);
+            json__hold(ctx, &copy);
+            ok = json__pointer_put(ctx, doc, json__string_or_empty(path), copy,
+                                   name[0] == 'r');
+            json__release(ctx);
+            if (!ok) json__free_value(ctx, &copy);
+        } else if (strcmp(name, "remove") == 0) {
+            Json_Value removed;
+            ok = json__pointer_take(ctx, doc, json__string_or_empty(path), &removed);
+            if (ok) json__free_value(ctx, &removed);
+        } else if (strcmp(name, "move") == 0) {
+            const char *src, *dst = json__string_or_empty(path);
+            size_t len;
+            Json_Value moved;
+            if (!from) return false;
+            src = json__string_or_empty(from);
+            len = strlen(src);
+            /* a value cannot be moved into one of its own children */
+            if (strncmp(src, dst, len) == 0 && dst[len] == '/') return false;
+            json__hold_room(ctx);
+            ok = json__pointer_take(ctx, doc, src, &moved);
+            if (ok) {
+                json__hold(ctx, &moved);
+                ok = json__pointer_put(ctx, doc, dst, moved, false);
+                json__release(ctx);
+                if (!ok) json__free_value(ctx, &moved);
+            }
+        } else if (strcmp(name, "copy") == 0) {
+            const Json_Value *source;
+            Json_Value tmp;
+            if (!from) return false;
+            source = json__pointer_get(doc, json__string_or_empty(from), &tmp);
+            ok = source != NULL;
+            if (ok) {
+                json__hold_room(ctx);
+                Json_Value copy = json__clone_value(ctx, source);
+                json__hold(ctx, &copy);
+                ok = json__pointer_put(ctx, doc, json__string_or_empty(path), copy, false);
+                json__release(ctx);
+                if (!ok) json__free_value(ctx, &copy);
+            }
+        } else if (strcmp(name, "test") == 0) {
+            Json_Value tmp;
+            const Json_Value *target = json__pointer_get(doc, json__string_or_empty(path), &tmp);
+            ok = value && target && json__equal(ctx, target, value);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) return false;
+    }
+
+    return true;
+}
+
+static bool json__merge_patch(Json_Context *ctx, Json_Value *doc, const Json_Value *patch)
+{
+    Json__Key_Index index;
+    size_t size, patch_size;
+    bool *removed;
+
+    if (!json_is_object(patch)) {
+        Json_Value copy = json__clone_value(ctx, patch);
+        json__free_value(ctx, doc);
+        *doc = copy;
+        return true;
+    }
+    if (!json_is_object(doc)) {
+        json__free_value(ctx, doc);
+        *doc = (Json_Value){.type = JSON_VALUE_OBJECT};
+    }
+    json__unshare(ctx, doc);
+
+    /* members are only appended while merging, so their indices stay valid
+       and the removed ones are compacted at the end */
+    size = aris_vec__size(doc->as.object);
+    patch_size = aris_vec__size(patch->as.object);
+    json__key_index_init(ctx, &index, doc->as.object, size, patch_size);
+    removed = (bool*)json__hold_block(ctx, size + patch_size + 1);
+    memset(removed, 0, size + patch_size + 1);
+
+    for (size_t i = 0; i < patch_size; i++) {
+        Json_Pair *pair = &patch->as.object[i];
+        size_t j = json__key_index_find(&index, doc->as.object, &pair->key);
+
+        if (pair->value.type == JSON_VALUE_NULL) {
+            if (j != JSON__NOT_FOUND) removed[j] = true;
+        } else if (j != JSON__NOT_FOUND) {
+            removed[j] = false;
+            json__merge_patch(ctx, &doc->as.object[j].value, &pair->value);
+        } else {
+            /* the member is added first and merged in place, so what a
+               failure leaves behind is part of 'doc' */
+            aris_vec__room(ctx, doc->as.object);
+            Json_Pair member = {json__clone_value(ctx, &pair->key), {.type = JSON_VALUE_NULL}};
+            aris_vec__push(ctx, doc->as.object, member);
+            j = aris_vec__size(doc->as.object) - 1;
+            json__key_index_add(&index, doc->as.object, j);
+            json__merge_patch(ctx, &doc->as.object[j].value, &pair->value);
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < aris_vec__size(doc->as.object); i++) {
+        if (removed[i]) {
+            json__free_pair(ctx, &doc->as.object[i]);
+        } else {
+            doc->as.object[kept++] = doc->as.object[i];
+        }
+    }
+    if (doc->as.object) aris_vec__header(doc->as.object)->size = kept;
+
+    json__release_block(ctx, removed, size + patch_size + 1);
+    json__key_index_fini(ctx, &index);
+    return true;
+}
+
+Json_Value json_new_string(Json_Context *ctx, const char *value)
+{
+    return json_new_string_n(ctx, value, value ? strlen(value) : 0);
+}
+
+Json_Value json_new_string_n(Json_Context *ctx, const char *value, size_t n)
+{
+    Json_Value result = json_new_null();
+
+    JSON__RECOVER(ctx, result = json__new_string(ctx, value, n),
+                  result = json_new_null(); json__memory_error(ctx));
+    return result;
+}
+
+Json_Value json_new_number(double value)
+{
+    Json_Value result = {.type = JSON_VALUE_NUMBER};
+    result.as.number = value;
+    return result;
+}
+
+Json_Value json_new_boolean(bool value)
+{
+    Json_Value result = {.type = JSON_VALUE_BOOLEAN};
+    result.as.boolean = value;
+    return result;
+}
+
+Json_Value json_new_null(void)
+{
+    return (Json_Value){.type = JSON_VALUE_NULL};
+}
+
+Json_Value json_new_object(void)
+{
+    return (Json_Value){.type = JSON_VALUE_OBJECT};
+}
+
+Json_Value json_new_array(void)
+{
+    return (Json_Value){.type = JSON_VALUE_ARRAY};
+}
+
+void json_value_free(Json_Context *ctx, Json_Value *value)
+{
+    if (ctx->code == JSON_FROZEN) return;
+    json__free_value(ctx, value);
+    *value = json_new_null();
+}
+
+Json_Value *json_object_set(Json_Context *ctx, Json_Value *object, const char *key, Json_Value value)
+{
+    if (ctx->code == JSON_FROZEN || !key || !json_is_object(object)) return NULL;
+    if (!json__edit(ctx, object)) return NULL;
+
+    size_t n = strlen(key);
+    Json_Value *member = (Json_Value*)json__object_find(ctx, object, key, n);
+    if (member) {
+        json__free_value(ctx, member);
+        *member = value;
+        return member;
+    }
+
+    JSON__RECOVER(ctx, json__object_add(ctx, object, key, n, value), json__memory_error(ctx); return NULL);
+    return &object->as.object[aris_vec__size(object->as.object) - 1].value;
+}
+
+bool json_object_take(Json_Context *ctx, Json_Value *object, const char *key, Json_Value *out)
+{
+    if (ctx->code == JSON_FROZEN || !key || !json_is_object(object)) return false;
+    if (!json__edit(ctx, object)) return false;
+
+    size_t size = aris_vec__size(object->as.object);
+    size_t n = strlen(key);
+    uint16_t hash = n > JSON_SMALL_STRING_MAX ? (uint16_t)json__hash_key(key, n) : 0;
+    for (size_t i = 0; i < size; i++) {
+        Json_Pair *pair = &object->as.object[i];
+        JSON__STAT_ADD(ctx, key_compares, 1);
+        if (!json__key_equal(&pair->key, key, n, hash)) continue;
+
+        *out = pair->value;
+        json__free_string(ctx, &pair->key);
+        memmove(pair, pair + 1, (size - i - 1)*sizeof(*pair));
+        aris_vec__header(object->as.object)->size--;
+        return true;
+    }
+
+    return false;
+}
+
+bool json_object_remove(Json_Context *ctx, Json_Value *object, const char *key)
+{
+    Json_Value removed;
+    if (!json_object_take(ctx, object, key, &removed)) return false;
+    json__free_value(ctx, &removed);
+    return true;
+}
+
+Json_Value *json_array_insert(Json_Context *ctx, Json_Value *array, size_t idx, Json_Value value)
+{
+    if (ctx->code == JSON_FROZEN || !json_is_array(array)) return NULL;
+
+    size_t size = aris_vec__size(array->as.array);
+    if (idx > size) return NULL;
+    if (!json__edit(ctx, array)) return NULL;
+
+    JSON__RECOVER(ctx, aris_vec__push(ctx, array->as.array, value), json__memory_error(ctx); return NULL);
+    memmove(&array->as.array[idx + 1], &array->as.array[idx],
+            (size - idx)*sizeof(*array->as.array));
+    array->as.array[idx] = value;
+    return &array->as.array[idx];
+}
+
+Json_Value *json_array_set(Json_Context *ctx, Json_Value *array, size_t idx, Json_Value value)
+{
+    if (ctx->code == JSON_FROZEN || !json_is_array(array) || idx >= aris_vec__size(array->as.array)) {
+        return NULL;
+    }
+    if (!json__edit(ctx, array)) return NULL;
+
+    json__free_value(ctx, &array->as.array[idx]);
+    array->as.array[idx] = value;
+    return &array->as.array[idx];
+}
+
+bool json_array_take(Json_Context *ctx, Json_Value *array, size_t idx, Json_Value *out)
+{
+    if (ctx->code == JSON_FROZEN || !json_is_array(array)) return false;
+
+    size_t size = aris_vec__size(array->as.array);
+    if (idx >= size) return false;
+    if (!json__edit(ctx, array)) return false;
+
+    *out = array->as.array[idx];
+    memmove(&array->as.array[idx], &array->as.array[idx + 1],
+            (size - idx - 1)*sizeof(*array->as.array));
+    aris_vec__header(array->as.array)->size--;
+    return true;
+}
+
+bool json_array_remove(Json_Context *ctx, Json_Value *array, size_t idx)
+{
+    Json_Value removed;
+    if (!json_array_take(ctx, array, idx, &removed)) return false;
+    json__free_value(ctx, &removed);
+    return true;
+}
+
+Json_Value json_move(Json_Context *dst, Json_Context *src, Json_Value *value)
+{
+    Json_Value result = *value;
+
+    if (src->code == JSON_FROZEN) return json_new_null();
+    /* the memory can only change hands if both sides free it the same way */
+    if (!json__same_allocator(&dst->opt.allocator, &src->opt.allocator)) {
+        JSON__RECOVER(dst, result = json__clone_value(dst, value),
+                      json__memory_error(dst); return json_new_null());
+        json__free_value(src, value);
+    }
+    *value = json_new_null();
+
+    return result;
+}
+
+Json_Value json_share(Json_Context *ctx, Json_Value *value)
+{
+    Json_Value result = json_new_null();
+
+    JSON__RECOVER(ctx, result = json__share(ctx, value), result = json_new_null(); json__memory_error(ctx));
+    return result;
+}
+
+Json_Value *json_unshare(Json_Context *ctx, Json_Value *root, const char *pointer)
+{
+    Json_Value *value = NULL;
+
+    if (ctx->code == JSON_FROZEN) return NULL;
+    JSON__RECOVER(ctx, value = json__unshare_path(ctx, root, pointer), value = NULL; json__memory_error(ctx));
+    return value;
+}
+
+/* a failure leaves the containers above it unshared, which changes no value */
+static Json_Value *json__unshare_path(Json_Context *ctx, Json_Value *root, const char *pointer)
+{
+    char token[JSON__KEY_MAX_SIZE + 1];
+    Json_Value *parent, *value = NULL;
+    size_t i;
+
+    if (!*pointer) {
+        value = root;
+    } else if ((parent = json__pointer_parent(ctx, root, pointer, token, sizeof(token)))) {
+        if (json_is_object(parent)) {
+            value = (Json_Value*)json__object_find(ctx, parent, token, strlen(token));
+        } else if (json_is_array(parent) && json__pointer_index(token, &i) &&
+                   i < aris_vec__size(parent->as.array)) {
+            value = &parent->as.array[i];
+        }
+    }
+    if (value) json__unshare(ctx, value);
+    return value;
+}
+
+static Json_Value json__share(Json_Context *ctx, Json_Value *value)
+{
+    void *items;
+
+    if (!json_is_object(value) && !json_is_array(value)) return json__clone_value(ctx, value);
+    /* a frozen tree is not changed, not even its counts */
+    if (ctx->code == JSON_FROZEN || value->indexed) return json__clone_value(ctx, value);
+    if (!(items = json__items(value))) return (Json_Value){.type = value->type};
+
+    /* the owner count goes in front of the vector, which has to move */
+    if (!value->shared) {
+        size_t bytes = json__items_bytes(value);
+        size_t *refs = (size_t*)json__malloc(ctx, sizeof(*refs) + bytes);
+        memcpy(refs + 1, aris_vec__header(items), bytes);
+        json__free(ctx, aris_vec__header(items), bytes);
+        *refs = 1;
+        json__set_items(value, (char*)(refs + 1) + sizeof(aris_vec_tor_header));
+        value->shared = true;
+    }
+    JSON__REFS(json__items(value))++;
+
+    return *value;
+}
+
+/* a container of its own, of values, ready to be changed; false once
+   out of memory */
+static bool json__edit(Json_Context *ctx, Json_Value *value)
+{
+    bool ok = false;
+
+    JSON__RECOVER(ctx, json__unshare(ctx, value); json__unpack(ctx, value); ok = true,
+                  ok = false; json__memory_error(ctx));
+    return ok;
+}
+
+/* a new member; room is made first so that a failure leaves no key behind */
+static void json__object_add(Json_Context *ctx, Json_Value *object, const char *key, size_t n,
+                             Json_Value value)
+{
+    size_t size = aris_vec__size(object->as.object);
+
+    if (size == aris_vec__capacity(object->as.object)) {
+        aris_vec__reserve(ctx, object->as.object, size == 0 ? 16 : 2*size);
+    }
+    Json_Pair pair = {json__new_key(ctx, key, n), value};
+    aris_vec__push(ctx, object->as.object, pair);
+}
+
+#ifdef JSON_ENABLE_STATS
+/* query functions take no context, so they report to the one bound here */
+static JSON__THREAD_LOCAL Json_Context *json__stats_ctx = NULL;
+
+void json_stats_reset(Json_Context *ctx)
+{
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+}
+
+void json_stats_bind(Json_Context *ctx)
+{
+    json__stats_ctx = ctx;
+}
+
+void json_print_stats(const Json_Stats *stats)
+{
+    printf("bytes parsed:    %zu\n", stats->bytes_parsed);
+    printf("tokens:          %zu\n", stats->tokens);
+    printf("parse errors:    %zu\n", stats->parse_errors);
+    printf("values:          null %zu, object %zu, array %zu, "
+           "string %zu, number %zu, boolean %zu\n",
+           stats->values[JSON_VALUE_NULL], stats->values[JSON_VALUE_OBJECT],
+           stats->values[JSON_VALUE_ARRAY], stats->values[JSON_VALUE_STRING],
+           stats->values[JSON_VALUE_NUMBER], stats->values[JSON_VALUE_BOOLEAN]);
+    printf("max depth:       %zu\n", stats->max_depth);
+    printf("allocations:     %zu (%zu bytes)\n",
+           stats->allocations, stats->bytes_allocated);
+    printf("vector reallocs: %zu\n", stats->vec_reallocs);
+    printf("key compares:    %zu\n", stats->key_compares);
+    printf("sink writes:     %zu (%zu bytes)\n",
+           stats->sink_writes, stats->bytes_written);
+#ifdef JSON_ENABLE_STATS_TIMING
+    printf("parse time:      %llu ns\n", stats->parse_ns);
+    printf("dump time:       %llu ns\n", stats->dump_ns);
+#endif /* JSON_ENABLE_STATS_TIMING */
+}
+#endif /* JSON_ENABLE_STATS */
+
+const Json_Value *json_object_get_value(const Json_Value *root, const char *key)
+{
+    return key ? json_object_get_value_n(root, key, strlen(key)) : NULL;
+}
+
+const Json_Value *json_object_get_value_n(const Json_Value *root, const char *key, size_t n)
+{
+#ifdef JSON_ENABLE_STATS
+    return json__object_find(json__stats_ctx, root, key, n);
+#else
+    return json__object_find(NULL, root, key, n);
+#endif /* JSON_ENABLE_STATS */
+}
+
+const Json_Pair *json_object_get_pair(const Json_Value *root, size_t idx)
+{
+    if (!json_is_object(root) || idx >= aris_vec__size(root->as.object)) return NULL;
+    return &root->as.object[idx];
+}
+
+size_t json_object_get_size(const Json_Value *root)
+{
+    return json_is_object(root) ? aris_vec__size(root->as.object) : 0;
+}
+
+const Json_Value *json_array_get_value(const Json_Value *root, size_t idx)
+{
+    if (!json_is_array(root) || root->packed || idx >= aris_vec__size(root->as.array)) return NULL;
+    return &root->as.array[idx];
+}
+
+const double *json_array_get_numbers(const Json_Value *root)
+{
+    return json_array_is_packed(root) ? root->as.numbers : NULL;
+}
+
+size_t json_array_get_size(const Json_Value *root)
+{
+    return json_is_array(root) ? aris_vec__size(root->as.array) : 0;
+}
+
+void json_cursor_init(Json_Context *ctx, Json_Cursor *cursor)
+{
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->ctx = ctx;
+    cursor->element = json_new_number(0);
+}
+
+void json_cursor_begin(Json_Cursor *cursor, const Json_Value *root, Json_Cursor_Order order)
+{
+    aris_vec__reset(cursor->frames);
+    cursor->top = NULL;
+    cursor->head = 0;
+    cursor->root = root;
+    cursor->order = order;
+}
+
+Json_Cursor_Event json_cursor_next(Json_Cursor *cursor)
+{
+    Json_Cursor__Frame *frame = cursor->top;
+    const Json_Value *container, *key = NULL, *value, *sibling = NULL;
+    size_t idx;
+
+    if (frame) {
+        if (frame->next == frame->size) {
+            cursor->value = frame->value;
+            cursor->key = frame->key;
+            cursor->index = frame->index;
+            cursor->depth = frame->depth;
+            cursor->top = frame > cursor->frames ? frame - 1 : NULL;
+            aris_vec__header(cursor->frames)->size--;
+            return JSON_CURSOR_LEAVE;
+        }
+    } else {
+        if (cursor->order == JSON_CURSOR_BREADTH_FIRST) {
+            size_t size = aris_vec__size(cursor->frames);
+            for (; cursor->head < size; cursor->head++) {
+                if (cursor->frames[cursor->head].next < cursor->frames[cursor->head].size) {
+                    frame = &cursor->frames[cursor->head];
+                    break;
+                }
+            }
+        }
+        if (!frame) {
+            value = cursor->root;
+            cursor->root = NULL;
+            if (value) return json__cursor_emit(cursor, value, NULL, 0, 0);
+            cursor->value = NULL;
+            cursor->key = NULL;
+            return JSON_CURSOR_END;
+        }
+    }
+
+    /* the next member of 'frame'; while the program looks at it, the
+       members of the next sibling are fetched, depth-first they come
+       right after it */
+    container = frame->value;
+    idx = frame->next++;
+    if (container->type == JSON_VALUE_OBJECT) {
+        key = &container->as.object[idx].key;
+        value = &container->as.object[idx].value;
+        if (idx + 1 < frame->size) sibling = &container->as.object[idx + 1].value;
+    } else if (!container->packed) {
+        value = &container->as.array[idx];
+        if (idx + 1 < frame->size) sibling = &container->as.array[idx + 1];
+    } else {
+        cursor->element.as.number = container->as.numbers[idx];
+        value = &cursor->element;
+    }
+    if (sibling && (sibling->type == JSON_VALUE_OBJECT || sibling->type == JSON_VALUE_ARRAY)) {
+        JSON__PREFETCH(sibling->as.array);
+    }
+
+    return json__cursor_emit(cursor, value, key, idx, frame->depth + 1);
+}
+
+void json_cursor_skip(Json_Cursor *cursor)
+{
+    Json_Cursor__Frame *frame;
+
+    /* right after ENTER, the container is the last frame pushed, on the
+       stack or the queue, and none of its members came yet */
+    if (aris_vec__size(cursor->frames) == 0) return;
+    frame = &cursor->frames[aris_vec__size(cursor->frames) - 1];
+    if (frame->value != cursor->value || frame->next > 0) return;
+
+    if (cursor->order == JSON_CURSOR_BREADTH_FIRST) {
+        aris_vec__header(cursor->frames)->size--;
+    } else {
+        frame->next = frame->size;
+    }
+}
+
+void json_cursor_fini(Json_Cursor *cursor)
+{
+    aris_vec__free(cursor->ctx, cursor->frames);
+}
+
+static void json__cursor_grow(Json_Cursor *cursor)
+{
+    size_t capacity = aris_vec__capacity(cursor->frames);
+    aris_vec__reserve(cursor->ctx, cursor->frames, capacity ? 2*capacity : 16);
+}
+
+static Json_Cursor_Event json__cursor_emit(Json_Cursor *cursor, const Json_Value *value,
+                                           const Json_Value *key, size_t idx, size_t depth)
+{
+    Json_Cursor__Frame frame = {
+        .value = value,
+        .key = key,
+        .index = idx,
+        .depth = depth,
+        .next = 0,
+    };
+
+    cursor->value = value;
+    cursor->key = key;
+    cursor->index = idx;
+    cursor->depth = depth;
+    if (value->type != JSON_VALUE_OBJECT && value->type != JSON_VALUE_ARRAY) return JSON_CURSOR_VALUE;
+    frame.size = aris_vec__size(value->as.array);
+
+    /* the queue drops the frames it is done with once they are half of it */
+    if (cursor->head >= 64 && cursor->head*2 >= aris_vec__size(cursor->frames)) {
+        size_t left = aris_vec__size(cursor->frames) - cursor->head;
+        memmove(cursor->frames, cursor->frames + cursor->head, left*sizeof(*cursor->frames));
+        aris_vec__header(cursor->frames)->size = left;
+        cursor->head = 0;
+    }
+    /* the only allocation of a walk, which ends here without the room */
+    if (aris_vec__size(cursor->frames) == aris_vec__capacity(cursor->frames)) {
+        JSON__RECOVER(cursor->ctx, json__cursor_grow(cursor),
+                      json__memory_error(cursor->ctx); cursor->value = NULL; cursor->key = NULL;
+                      return JSON_CURSOR_END);
+    }
+    aris_vec__push(cursor->ctx, cursor->frames, frame);
+    if (cursor->order == JSON_CURSOR_DEPTH_FIRST) {
+        cursor->top = &cursor->frames[aris_vec__size(cursor->frames) - 1];
+    }
+
+    return JSON_CURSOR_ENTER;
+}
+
+bool json_freeze(Json_Context *ctx)
+{
+    if (ctx->code == JSON_FROZEN) return true;
+    if (ctx->code != JSON_OK || !ctx->root || aris_vec__size(ctx->scopes) > 1) return false;
+
+    /* every index is in place before the tree is published; the ones
+       that were made go again if the others do not fit */
+    JSON__RECOVER(ctx, json__freeze_value(ctx, ctx->root),
+                  json__set_error(ctx, NULL, JSON_FROZEN); json_thaw(ctx);
+                  if (ctx->code == JSON_OK) json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY);
+                  return false);
+    json__set_error(ctx, NULL, JSON_FROZEN);
+
+    return true;
+}
+
+void json_thaw(Json_Context *ctx)
+{
+    if (ctx->code != JSON_FROZEN) return;
+
+    /* the indices are cut off in place, out of memory the tree stays frozen */
+    JSON__RECOVER(ctx, json__thaw_value(ctx, ctx->root); ctx->code = JSON_OK, (void)0);
+}
+
+static void *json__libc_alloc(void *user, size_t size)
+{
+    (void)user;
+    return malloc(size);
+}
+
+static void *json__libc_realloc(void *user, void *ptr, size_t old_size, size_t new_size)
+{
+    (void)user;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+static void json__libc_free(void *user, void *ptr, size_t size)
+{
+    (void)user;
+    (void)size;
+    free(ptr);
+}
+
+static void *json__malloc(Json_Context *ctx, size_t size)
+{
+    void *ptr;
+
+    JSON__STAT_ADD(ctx, allocations, 1);
+    JSON__STAT_ADD(ctx, bytes_allocated, size);
+    ptr = ctx->opt.allocator.alloc(ctx->opt.allocator.user, size);
+    if (!ptr && size > 0) json__out_of_memory(ctx);
+    return ptr;
+}
+
+static void *json__realloc(Json_Context *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+    JSON__STAT_ADD(ctx, allocations, 1);
+    JSON__STAT_ADD(ctx, bytes_allocated, new_size);
+    ptr = ctx->opt.allocator.realloc(ctx->opt.allocator.user, ptr, old_size, new_size);
+    if (!ptr && new_size > 0) json__out_of_memory(ctx);
+    return ptr;
+}
+
+/* back to the outermost public call, see JSON__RECOVER */
+static void json__out_of_memory(Json_Context *ctx)
+{
+    longjmp(ctx->recovery->jump, 1);
+}
+
+/* the code of a failed call; a frozen tree stays frozen */
+static void json__memory_error(Json_Context *ctx)
+{
+    if (ctx->code != JSON_FROZEN) json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY);
+}
+
+static void json__alloc_buffers(Json_Context *ctx)
+{
+    ctx->error_buffer = (char*)json__malloc(ctx, JSON__ERROR_BUFFER_SIZE + 1);
+    ctx->current_key = (char*)json__malloc(ctx, JSON__KEY_MAX_SIZE + 1);
+}
+
+/* NULL if the block cannot even hold the header, every allocation fails then */
+static Json__Arena *json__arena_init(void *memory, size_t size)
+{
+    char *begin = (char*)memory;
+    char *end = begin + size;
+    char *header = begin + (JSON__ARENA_ALIGN - (uintptr_t)begin % JSON__ARENA_ALIGN) % JSON__ARENA_ALIGN;
+    Json__Arena *arena = (Json__Arena*)header;
+
+    if ((size_t)(end - begin) < (size_t)(header - begin) + sizeof(*arena)) return NULL;
+    arena->begin = begin;
+    arena->top = header + sizeof(*arena);
+    arena->end = end;
+    arena->last = NULL;
+    return arena;
+}
+
+static void *json__arena_alloc(void *user, size_t size)
+{
+    Json__Arena *arena = (Json__Arena*)user;
+    char *block;
+
+    if (!arena) return NULL;
+    block = arena->top + (JSON__ARENA_ALIGN - (uintptr_t)arena->top % JSON__ARENA_ALIGN) % JSON__ARENA_ALIGN;
+    if (block > arena->end || size > (size_t)(arena->end - block)) return NULL;
+    arena->top = block + size;
+    arena->last = block;
+    return block;
+}
+
+static void *json__arena_realloc(void *user, void *ptr, size_t old_size, size_t new_size)
+{
+    Json__Arena *arena = (Json__Arena*)user;
+    char *block;
+
+    if (!ptr) return json__arena_alloc(user, new_size);
+    if (ptr == arena->last) {
+        if (new_size > (size_t)(arena->end - arena->last)) return NULL;
+        arena->top = arena->last + new_size;
+        return ptr;
+    }
+    if (new_size <= old_size) return ptr;
+
+    block = (char*)json__arena_alloc(user, new_size);
+    if (block) memcpy(block, ptr, old_size);
+    return block;
+}
+
+static void json__arena_free(void *user, void *ptr, size_t size)
+{
+    Json__Arena *arena = (Json__Arena*)user;
+
+    (void)size;
+    if (arena && ptr && ptr == arena->last) {
+        arena->top = arena->last;
+        arena->last = NULL;
+    }
+}
+
+static void json__free(Json_Context *ctx, void *ptr, size_t size)
+{
+    ctx->opt.allocator.free(ctx->opt.allocator.user, ptr, size);
+}
+
+/* Values that are being built, before they are linked into a tree, are
+   held in the context so that running out of memory frees them: the
+   room is made before the value is allocated, then json__hold takes it
+   and json__release gives it up once it is linked. Holds nest. */
+static void json__hold_room(Json_Context *ctx)
+{
+    aris_vec__room(ctx, ctx->held);
+}
+
+static void json__hold(Json_Context *ctx, const Json_Value *value)
+{
+    Json__Held held = {*value, NULL, 0};
+    aris_vec__push(ctx, ctx->held, held);
+}
+
+static void json__release(Json_Context *ctx)
+{
+    aris_vec__header(ctx->held)->size--;
+}
+
+/* a scratch block, held until json__release_block frees it */
+static void *json__hold_block(Json_Context *ctx, size_t size)
+{
+    Json__Held held = {{JSON_VALUE_NULL}, NULL, size};
+
+    json__hold_room(ctx);
+    held.block = json__malloc(ctx, size);
+    aris_vec__push(ctx, ctx->held, held);
+    return held.block;
+}
+
+static void json__release_block(Json_Context *ctx, void *block, size_t size)
+{
+    size_t i = aris_vec__size(ctx->held);
+
+    while (i-- > 0 && ctx->held[i].block != block) {}
+    memmove(&ctx->held[i], &ctx->held[i + 1], (aris_vec__size(ctx->held) - i - 1)*sizeof(*ctx->held));
+    aris_vec__header(ctx->held)->size--;
+    json__free(ctx, block, size);
+}
+
+static void json__drop_held(Json_Context *ctx)
+{
+    while (aris_vec__size(ctx->held) > 0) {
+        Json__Held *held = &ctx->held[--aris_vec__header(ctx->held)->size];
+        if (held->block) {
+            json__free(ctx, held->block, held->size);
+        } else {
+            json__free_value(ctx, &held->value);
+        }
+    }
+}
+
+static Json_Value json__new_string(Json_Context *ctx, const char *s, size_t n)
+{
+    Json_Value value = {.type = JSON_VALUE_STRING};
+    char *chars;
+
+    if (n <= JSON_SMALL_STRING_MAX) {
+        value.small = (uint8_t)(n + 1);
+        chars = json_to_string(&value);
+    } else {
+        /* the length has 32 bits, a longer string fails like an allocation */
+        if (n > UINT32_MAX) json__out_of_memory(ctx);
+        value.length = (uint32_t)n;
+        value.as.string = chars = (char*)json__malloc(ctx, n + 1);
+    }
+    if (n > 0) memcpy(chars, s, n);
+    chars[n] = '\0';
+
+    return value;
+}
+
+/* a key that is not small also gets its hash, to be told apart quickly */
+static Json_Value json__new_key(Json_Context *ctx, const char *key, size_t n)
+{
+    Json_Value value = json__new_string(ctx, key, n);
+    if (!value.small) value.hash = (uint16_t)json__hash_key(key, n);
+    return value;
+}
+
+static void json__free_string(Json_Context *ctx, Json_Value *value)
+{
+    if (value->type != JSON_VALUE_STRING || value->small) return;
+    if (value->as.string) json__free(ctx, value->as.string, value->length + 1);
+    value->as.string = NULL;
+}
+
+/* Keys of up to JSON_SMALL_STRING_MAX bytes are always small, so 'hash'
+   (of 's', json__hash_key) only matters for longer ones. */
+static bool json__key_equal(const Json_Value *key, const char *s, size_t n, uint16_t hash)
+{
+    if (json_string_length(key) != n) return false;
+    if (!key->small && key->hash != hash) return false;
+    return memcmp(json_to_string(key), s, n) == 0;
+}
+
+/* Records of one shape have every key at the same slot, so a loop that
+   reads the same key string (usually a literal) out of each of them finds
+   it where it was the last time. The slot is only a guess, the key found
+   there is always compared. */
+static JSON__THREAD_LOCAL Json__Slot_Cache json__slot_cache[1 << JSON__SLOT_CACHE_BITS];
+
+static const Json_Value *json__object_find(Json_Context *ctx, const Json_Value *root, const char *key, size_t n)
+{
+    size_t hash = 0;
+    Json__Slot_Cache *cached;
+
+    if (!key || !json_is_object(root)) return NULL;
+    if (n > JSON_SMALL_STRING_MAX || root->indexed) hash = json__hash_key(key, n);
+
+    if (root->indexed) {
+        const size_t *index = json__frozen_index(root);
+        size_t slot = hash & index[0];
+        for (; index[1 + slot]; slot = (slot + 1) & index[0]) {
+            Json_Pair *pair = &root->as.object[index[1 + slot] - 1];
+#ifdef JSON_ENABLE_STATS
+            if (ctx) JSON__STAT_ADD(ctx, key_compares, 1);
+#endif /* JSON_ENABLE_STATS */
+            if (json__key_equal(&pair->key, key, n, (uint16_t)hash)) return &pair->value;
+        }
+        return NULL;
+    }
+
+    cached = &json__slot_cache[((uint64_t)(uintptr_t)key*0x9E3779B97F4A7C15ull) >> (64 - JSON__SLOT_CACHE_BITS)];
+    if (cached->key == key && cached->slot < aris_vec__size(root->as.object)) {
+        Json_Pair *pair = &root->as.object[cached->slot];
+#ifdef JSON_ENABLE_STATS
+        if (ctx) JSON__STAT_ADD(ctx, key_compares, 1);
+#endif /* JSON_ENABLE_STATS */
+        if (json__key_equal(&pair->key, key, n, (uint16_t)hash)) return &pair->value;
+    }
+
+    for (size_t i = 0; i < aris_vec__size(root->as.object); i++) {
+        Json_Pair *pair = &root->as.object[i];
+#ifdef JSON_ENABLE_STATS
+        if (ctx) JSON__STAT_ADD(ctx, key_compares, 1);
+#endif /* JSON_ENABLE_STATS */
+        if (json__key_equal(&pair->key, key, n, (uint16_t)hash)) {
+            cached->key = key;
+            cached->slot = i;
+            return &pair->value;
+        }
+    }
+    (void)ctx;
+
+    return NULL;
+}
+
+static void json__write(Json_Context *ctx, const char *s)
+{
+    json__write_n(ctx, s, strlen(s));
+}
+
+static void json__write_n(Json_Context *ctx, const char *s, size_t n)
+{
+    JSON__STAT_ADD(ctx, sink_writes, 1);
+    JSON__STAT_ADD(ctx, bytes_written, n);
+
+    if (ctx->opt.mode == JSON_CALLBACK_OUTPUT) {
+        ctx->opt.write_bytes(s, n, ctx->opt.write_user);
+#ifdef JSON_ENABLE_WRITEV
+    } else if (ctx->opt.mode == JSON_WRITEV_OUTPUT) {
+        json__writev_copy(ctx, ctx->writev, s, n);
+#endif /* JSON_ENABLE_WRITEV */
+    } else if (ctx->opt.mode == JSON_BUFFER_OUTPUT &&
+               ctx->opt.write_to_buffer == json_default_write_to_buffer) {
+        /* keep the position per context and accept any byte */
+        if (ctx->output_pos + n < ctx->opt.output_buffer_size) {
+            memcpy(ctx->opt.output_buffer + ctx->output_pos, s, n);
+            ctx->output_pos += n;
+            ctx->opt.output_buffer[ctx->output_pos] = '\0';
+        }
+    } else if (ctx->opt.mode == JSON_FILE_OUTPUT &&
+               ctx->opt.write_to_file == json_default_write_to_file) {
+        fwrite(s, 1, n, ctx->opt.output_file);
+    } else {
+        /* user callbacks take NUL-terminated strings */
+        char chunk[256];
+        while (n > 0) {
+            size_t len = n < sizeof(chunk) - 1 ? n : sizeof(chunk) - 1;
+            memcpy(chunk, s, len);
+            chunk[len] = '\0';
+            if (ctx->opt.mode == JSON_BUFFER_OUTPUT) {
+                ctx->opt.write_to_buffer(chunk, ctx->opt.output_buffer,
+                                         ctx->opt.output_buffer_size);
+            } else {
+                ctx->opt.write_to_file(chunk, ctx->opt.output_file);
+            }
+            s += len;
+            n -= len;
+        }
+    }
+}
+
+/* 's' is in the tree and stays valid until the dump returns, so
+   JSON_WRITEV_OUTPUT may hand a long one to writev where it is */
+static void json__write_ref(Json_Context *ctx, const char *s, size_t n)
+{
+#ifdef JSON_ENABLE_WRITEV
+    if (ctx->opt.mode == JSON_WRITEV_OUTPUT && n >= JSON__WRITEV_MIN) {
+        JSON__STAT_ADD(ctx, sink_writes, 1);
+        JSON__STAT_ADD(ctx, bytes_written, n);
+        json__writev_ref(ctx, ctx->writev, s, n);
+        return;
+    }
+#endif /* JSON_ENABLE_WRITEV */
+    json__write_n(ctx, s, n);
+}
+
+static void json__set_error(Json_Context *ctx, const char *key, Json_Error_Code code)
+{
+    ctx->code = code;
+    if (!ctx->error_buffer) return;
+
+    switch (code) {
+    case JSON_OK:
+        break;
+
+    case JSON_DOUBLE_KEY:
+        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
+                 "ERROR: double key '%s'!\n", key);
+        break;
+
+    case JSON_NULL_KEY:
+        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
+                 "ERROR: null key!\n");
+        break;
+
+    case JSON_KEY_OVERFLOW:
+        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
+                 "ERROR: key overflow '%s' (maxsize = %d)!\n",
+                 key, JSON__KEY_MAX_SIZE);
+        break;
+
+    case JSON_NO_SCOPE:
+        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
+                 "ERROR: what was done without a scope!\n");
+        break;
+
+    case JSON_INCORRECT_SCOPE:
+        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
+                 "ERROR: what was done within incorrect scope!\n");
+        break;
+
+    case JSON_FROZEN:
+        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
+                 "ERROR: the tree is frozen (read-only)!\n");
+        break;
+
+    case JSON_OUT_OF_MEMORY:
+        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
+                 "ERROR: out of memory!\n");
+        break;
+
+    default:
+        snprintf(ctx->error_buffer, JSON__ERROR_BUFFER_SIZE+1,
+                 "ERROR: unknown code!\n");
+        break;
+    }
+}
+
+static Json_Value *json__get_current_scope(Json_Context *ctx)
+{
+    if (ctx->code != JSON_OK) return NULL;
+    if (aris_vec__size(ctx->scopes) == 0) return NULL;
+    return &ctx->scopes[aris_vec__size(ctx->scopes) - 1];
+}
+
+/* the key of the next member, or a null for an array element */
+static Json_Value json__member_key(Json_Context *ctx)
+{
+    if (ctx->scope_type != JSON_SCOPE_OBJECT) return json_new_null();
+    return json__new_key(ctx, ctx->current_key, ctx->current_key_size);
+}
+
+/* json__member_key, held until its value is appended */
+static Json_Value json__held_key(Json_Context *ctx)
+{
+    Json_Value key;
+
+    json__hold_room(ctx);
+    key = json__member_key(ctx);
+    json__hold(ctx, &key);
+    return key;
+}
+
+/* Room for one more element in 'scope', made before anything is
+   allocated for it: json__append_element then cannot fail, and running
+   out of memory leaves the scope as it was. */
+static void json__element_room(Json_Context *ctx, Json_Value *scope)
+{
+    json__unshare(ctx, scope);
+    if (scope->type == JSON_VALUE_OBJECT) {
+        aris_vec__room(ctx, scope->as.object);
+    } else {
+        aris_vec__room(ctx, scope->as.array);
+    }
+}
+
+/* after json__element_room on the current scope */
+static void json__append_element(Json_Context *ctx, Json_Value key, Json_Value value)
+{
+    Json_Value *scope = json__get_current_scope(ctx);
+    JSON__STAT_ADD(ctx, values[value.type], 1);
+    if (ctx->scope_type == JSON_SCOPE_OBJECT) {
+        Json_Pair pair = {key, value};
+        aris_vec__push(ctx, scope->as.object, pair);
+    } else if (ctx->scope_type == JSON_SCOPE_ARRAY) {
+        aris_vec__push(ctx, scope->as.array, value);
+    }
+}
+
+static void json__append_scalar(Json_Context *ctx, Json_Value value)
+{
+    json__element_room(ctx, json__get_current_scope(ctx));
+    json__append_element(ctx, json__member_key(ctx), value);
+}
+
+static void json__append_string(Json_Context *ctx, const char *s, size_t n)
+{
+    Json_Value key, value;
+
+    json__element_room(ctx, json__get_current_scope(ctx));
+    key = json__held_key(ctx);
+    value = json__new_string(ctx, s, n);
+    json__release(ctx);
+    json__append_element(ctx, key, value);
+}
+
+static void json__free_value(Json_Context *ctx, Json_Value *value)
+{
+    /* a shared container is freed by its last owner */
+    if (value->shared && --JSON__REFS(json__items(value)) > 0) {
+        json__set_items(value, NULL);
+        value->shared = false;
+        return;
+    }
+
+    switch (value->type) {
+    case JSON_VALUE_OBJECT:
+        for (size_t i = 0; i < aris_vec__size(value->as.object); i++) {
+            json__free_pair(ctx, &value->as.object[i]);
+        }
+        json__free_items(ctx, value);
+        break;
+
+    case JSON_VALUE_ARRAY:
+        for (size_t i = 0; !value->packed && i < aris_vec__size(value->as.array); i++) {
+            json__free_value(ctx, &value->as.array[i]);
+        }
+        json__free_items(ctx, value);
+        break;
+
+    case JSON_VALUE_STRING:
+        json__free_string(ctx, value);
+        break;
+
+    case JSON_VALUE_NUMBER:
+    case JSON_VALUE_BOOLEAN:
+    case JSON_VALUE_NULL:
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void json__free_pair(Json_Context *ctx, Json_Pair *pair)
+{
+    json__free_string(ctx, &pair->key);
+    json__free_value(ctx, &pair->value);
+}
+
+static void json__push_scope(Json_Context *ctx, Json_Value scope)
+{
+    aris_vec__push(ctx, ctx->scopes, scope);
+    /* the push may have moved the root scope */
+    if (ctx->root) ctx->root = &ctx->scopes[0];
+    JSON__STAT_MAX(ctx, max_depth, aris_vec__size(ctx->scopes));
+    ctx->scope_type = scope.type == JSON_VALUE_ARRAY
+                      ? JSON_SCOPE_ARRAY : JSON_SCOPE_OBJECT;
+}
+
+static Json_Value json__pop_scope(Json_Context *ctx)
+{
+    Json_Value res = ctx->scopes[--aris_vec__header(ctx->scopes)->size];
+
+    if (aris_vec__size(ctx->scopes) > 0) {
+        Json_Value *scope = json__get_current_scope(ctx);
+        ctx->scope_type = scope->type == JSON_VALUE_ARRAY
+                          ? JSON_SCOPE_ARRAY : JSON_SCOPE_OBJECT;
+    }
+
+    return res;
+}
+
+/* The escape of a quote, a backslash or a control byte 'ch' goes to
+   'out', in the short form where JSON has one; its size is returned.
+   Every other byte is written as it is. */
+static size_t json__escape(unsigned char ch, char *out)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out[0] = '\\';
+    switch (ch) {
+    case '"':  out[1] = '"';  return 2;
+    case '\\': out[1] = '\\'; return 2;
+    case '\b': out[1] = 'b';  return 2;
+    case '\f': out[1] = 'f';  return 2;
+    case '\n': out[1] = 'n';  return 2;
+    case '\r': out[1] = 'r';  return 2;
+    case '\t': out[1] = 't';  return 2;
+    default:
+        memcpy(out + 1, "u00", 3);
+        out[4] = hex[ch >> 4];
+        out[5] = hex[ch & 15];
+        return 6;
+    }
+}
+
+/* how many bytes 's' starts with that need no escape */
+static size_t json__plain_size(const char *s, size_t n)
+{
+    size_t i = 0;
+
+    for (;;) {
+        /* eight at a time while none is a control byte, quote or backslash */
+        for (; n - i >= 8; i += 8) {
+            uint64_t v;
+            memcpy(&v, s + i, 8);
+            if (JSON__NEEDS_ESCAPE(v)) break;
+        }
+        /* then byte by byte through the eight that may hold one */
+        size_t stop = n - i > 8 ? i + 8 : n;
+        for (; i < stop; i++) {
+            unsigned char ch = (unsigned char)s[i];
+            if (ch < 0x20 || ch == '"' || ch == '\\') return i;
+        }
+        if (i == n) return i;
+    }
+}
+
+/* 's' quoted and escaped, the runs between escapes written in place */
+static void json__dump_string(Json_Context *ctx, const char *s, size_t n)
+{
+    size_t plain = 0;   /* first byte not written yet */
+    char escape[6];
+
+    json__write(ctx, "\"");
+    for (size_t i = json__plain_size(s, n); i < n; i = plain + json__plain_size(s + plain, n - plain)) {
+        size_t size = json__escape((unsigned char)s[i], escape);
+        if (i > plain) json__write_ref(ctx, s + plain, i - plain);
+        json__write_n(ctx, escape, size);
+        plain = i + 1;
+    }
+    if (n > plain) json__write_ref(ctx, s + plain, n - plain);
+    json__write(ctx, "\"");
+}
+
+static void json__dump_pair(Json_Context *ctx, size_t level, Json_Pair *pair, bool comma)
+{
+    json__dump_indent(ctx, level);
+
+    json__dump_string(ctx, json_to_string(&pair->key), json_string_length(&pair->key));
+    json__write(ctx, ": ");
+    json__dump_value(ctx, level, &pair->value, false);
+
+    if (comma) {
+        json__write(ctx, ",\n");
+    } else {
+        json__write(ctx, "\n");
+    }
+}
+
+static void json__dump_value(Json_Context *ctx, size_t level, Json_Value *value, bool indent)
+{
+    char buffer[32];
+    size_t size;
+
+    if (indent) json__dump_indent(ctx, level);
+
+    switch (value->type) {
+    case JSON_VALUE_OBJECT:
+    case JSON_VALUE_ARRAY:
+        size = value->type == JSON_VALUE_OBJECT
+               ? aris_vec__size(value->as.object) : aris_vec__size(value->as.array);
+        json__write(ctx, value->type == JSON_VALUE_OBJECT ? "{\n" : "[\n");
+#ifdef JSON_ENABLE_THREADS
+        if (ctx->opt.threads > 1 && size >= JSON__PARALLEL_MIN_SIZE) {
+            json__dump_members_parallel(ctx, level, value, size);
+        } else {
+            json__dump_members(ctx, level, value, 0, size);
+        }
+#else
+        json__dump_members(ctx, level, value, 0, size);
+#endif /* JSON_ENABLE_THREADS */
+        json__dump_indent(ctx, level);
+        json__write(ctx, value->type == JSON_VALUE_OBJECT ? "}" : "]");
+        break;
+
+    case JSON_VALUE_STRING:
+        json__dump_string(ctx, json__string_or_empty(value), json_string_length(value));
+        break;
+
+    case JSON_VALUE_NUMBER:
+        json__write_n(ctx, buffer, json__format_number(value->as.number, buffer));
+        break;
+
+    case JSON_VALUE_BOOLEAN:
+        if (value->as.boolean) {
+            json__write(ctx, "true");
+        } else {
+            json__write(ctx, "false");
+        }
+        break;
+
+    case JSON_VALUE_NULL:
+        json__write(ctx, "null");
+        break;
+
+    default:
+        break;
+    }
+}
+
+/* dump the members [begin, end) of a container exactly as the sequential
+   dump of the whole container would, so ranges can be joined */
+static void json__dump_members(Json_Context *ctx, size_t level, Json_Value *value, size_t begin, size_t end)
+{
+    if (value->type == JSON_VALUE_OBJECT) {
+        size_t size = aris_vec__size(value->as.object);
+        for (size_t i = begin; i < end; i++) {
+            json__dump_pair(ctx, level+1, &value->as.object[i], i != size - 1);
+        }
+    } else if (value->packed) {
+        json__dump_numbers(ctx, level+1, value->as.numbers, begin, end, aris_vec__size(value->as.numbers));
+    } else {
+        size_t size = aris_vec__size(value->as.array);
+        for (size_t i = begin; i < end; i++) {
+            json__dump_value(ctx, level+1, &value->as.array[i], true);
+            json__write(ctx, i == size - 1 ? "\n" : ",\n");
+        }
+    }
+}
+
+/* The elements [begin, end) of a packed array, laid out as
+   json__dump_members would but formatted into a buffer that goes to the
+   sink once it is full, instead of four writes per number. */
+static void json__dump_numbers(Json_Context *ctx, size_t level, const double *numbers,
+                               size_t begin, size_t end, size_t size)
+{
+    char buffer[4096];
+    size_t used = 0;
+    size_t indent = strlen(ctx->opt.indent);
+    bool inline_indent = level*indent + 32 <= sizeof(buffer);
+
+    for (size_t i = begin; i < end; i++) {
+        if (used + level*indent + 32 > sizeof(buffer)) {
+            json__write_n(ctx, buffer, used);
+            used = 0;
+        }
+        if (inline_indent) {
+            for (size_t l = 0; l < level; l++) {
+                memcpy(buffer + used, ctx->opt.indent, indent);
+                used += indent;
+            }
+        } else {
+            json__dump_indent(ctx, level);
+        }
+        used += json__format_number(numbers[i], buffer + used);
+        if (i != size - 1) buffer[used++] = ',';
+        buffer[used++] = '\n';
+    }
+    if (used > 0) json__write_n(ctx, buffer, used);
+}
+
+/* "%.15g", with integers of up to 15 digits written directly, and null
+   for NaN and the infinities, which JSON has no literal for; 'out' has
+   room for 32 bytes */
+static size_t json__format_number(double number, char *out)
+{
+    if (number > -1e15 && number < 1e15 && number == (double)(long long)number &&
+        !(number == 0 && signbit(number))) {
+        long long i = (long long)number;
+        unsigned long long u = i < 0 ? 0ull - (unsigned long long)i : (unsigned long long)i;
+        char digits[20];
+        size_t n = 0, len = 0;
+
+        do {
+            digits[n++] = (char)('0' + u % 10);
+            u /= 10;
+        } while (u > 0);
+        if (i < 0) out[len++] = '-';
+        while (n > 0) out[len++] = digits[--n];
+        out[len] = '\0';
+        return len;
+    }
+
+    if (isnan(number) || isinf(number)) {
+        memcpy(out, "null", 5);
+        return 4;
+    }
+
+    return (size_t)snprintf(out, 32, "%.15g", number);
+}
+
+#ifdef JSON_ENABLE_THREADS
+typedef struct Json__Dump_Chunk {
+    Json_Context ctx;   /* copy of the dumping context, writes to 'output' */
+    char *output;       /* aris_vec */
+    size_t begin, end;
+    bool failed;        /* ran out of memory, 'output' is cut short */
+} Json__Dump_Chunk;
+
+typedef struct Json__Dump_Job {
+    Json__Dump_Chunk *chunks;
+    size_t count;
+    size_t next;        /* next chunk to take, guarded by 'lock' */
+    size_t level;
+    Json_Value *value;
+    pthread_mutex_t lock;
+} Json__Dump_Job;
+
+static void json__dump_chunk_write(const void *data, size_t size, void *user)
+{
+    Json__Dump_Chunk *chunk = (Json__Dump_Chunk*)user;
+    size_t needed = aris_vec__size(chunk->output) + size;
+
+    if (needed > aris_vec__capacity(chunk->output)) {
+        size_t capacity = aris_vec__capacity(chunk->output) ? aris_vec__capacity(chunk->output) : 4096;
+        while (capacity < needed) capacity *= 2;
+        aris_vec__reserve(&chunk->ctx, chunk->output, capacity);
+    }
+    memcpy(chunk->output + aris_vec__size(chunk->output), data, size);
+    aris_vec__header(chunk->output)->size = needed;
+}
+
+/* a worker cannot jump back to the dumping thread, it recovers here */
+static void json__dump_chunk(Json__Dump_Job *job, Json__Dump_Chunk *chunk)
+{
+    JSON__RECOVER(&chunk->ctx,
+                  json__dump_members(&chunk->ctx, job->level, job->value, chunk->begin, chunk->end),
+                  chunk->failed = true);
+}
+
+static void *json__dump_worker(void *arg)
+{
+    Json__Dump_Job *job = (Json__Dump_Job*)arg;
+
+    while (true) {
+        Json__Dump_Chunk *chunk;
+
+        pthread_mutex_lock(&job->lock);
+        chunk = job->next < job->count ? &job->chunks[job->next++] : NULL;
+        pthread_mutex_unlock(&job->lock);
+        if (!chunk) break;
+
+        json__dump_chunk(job, chunk);
+    }
+
+    return NULL;
+}
+
+/* Split the members into more chunks than threads so that uneven members
+   still balance, dump every chunk into its own buffer, then write the
+   buffers out in order. */
+static void json__dump_members_parallel(Json_Context *ctx, size_t level, Json_Value *value, size_t size)
+{
+    size_t threads = ctx->opt.threads;
+    size_t count = threads * 4 < size ? threads * 4 : size;
+    pthread_t *workers;
+    Json__Dump_Job job = {
+        .count = count,
+        .level = level,
+        .value = value,
+    };
+
+    job.chunks = (Json__Dump_Chunk*)json__hold_block(ctx, count*sizeof(*job.chunks));
+    workers = (pthread_t*)json__hold_block(ctx, threads*sizeof(*workers));
+    pthread_mutex_init(&job.lock, NULL);
+
+    for (size_t i = 0; i < count; i++) {
+        Json__Dump_Chunk *chunk = &job.chunks[i];
+        chunk->ctx = *ctx;
+        chunk->ctx.opt.mode = JSON_CALLBACK_OUTPUT;
+        chunk->ctx.opt.write_bytes = json__dump_chunk_write;
+        chunk->ctx.opt.write_user = chunk;
+        chunk->ctx.opt.threads = 1;
+        chunk->ctx.recovery = NULL;
+        chunk->ctx.held = NULL;
+#ifdef JSON_ENABLE_STATS
+        json_stats_reset(&chunk->ctx);
+#endif /* JSON_ENABLE_STATS */
+        chunk->output = NULL;
+        chunk->begin = size * i / count;
+        chunk->end = size * (i + 1) / count;
+        chunk->failed = false;
+    }
+
+    /* the calling thread is one of the workers */
+    size_t started = 0;
+    for (; started < threads - 1; started++) {
+        if (pthread_create(&workers[started], NULL, json__dump_worker, &job) != 0) break;
+    }
+    json__dump_worker(&job);
+    for (size_t i = 0; i < started; i++) pthread_join(workers[i], NULL);
+
+    /* the output stops where the first chunk ran out of memory */
+    bool failed = false;
+    for (size_t i = 0; i < count; i++) {
+        Json__Dump_Chunk *chunk = &job.chunks[i];
+        failed = failed || chunk->failed;
+        if (chunk->output && !failed) json__write_n(ctx, chunk->output, aris_vec__size(chunk->output));
+#ifdef JSON_ENABLE_STATS
+        JSON__STAT_ADD(ctx, allocations, chunk->ctx.stats.allocations);
+        JSON__STAT_ADD(ctx, bytes_allocated, chunk->ctx.stats.bytes_allocated);
+        JSON__STAT_ADD(ctx, vec_reallocs, chunk->ctx.stats.vec_reallocs);
+#endif /* JSON_ENABLE_STATS */
+        aris_vec__free(ctx, chunk->output);
+    }
+
+    pthread_mutex_destroy(&job.lock);
+    json__release_block(ctx, workers, threads*sizeof(*workers));
+    json__release_block(ctx, job.chunks, count*sizeof(*job.chunks));
+    if (failed) json__out_of_memory(ctx);
+}
+#endif /* JSON_ENABLE_THREADS */
+
+#ifdef JSON_ENABLE_WRITEV
+static void json__writev_begin(Json_Context *ctx, Json__Writev *w)
+{
+    w->count = 0;
+    w->staged = 0;
+    w->covered = 0;
+    w->failed = false;
+    ctx->writev = ctx->opt.mode == JSON_WRITEV_OUTPUT ? w : NULL;
+}
+
+static void json__writev_end(Json_Context *ctx)
+{
+    if (ctx->writev) json__writev_flush(ctx, ctx->writev);
+    ctx->writev = NULL;
+}
+
+static void json__writev_copy(Json_Context *ctx, Json__Writev *w, const char *s, size_t n)
+{
+    /* longer than the staging buffer: written out before 's' goes away */
+    if (n > sizeof(w->staging)) {
+        json__writev_ref(ctx, w, s, n);
+        json__writev_flush(ctx, w);
+        return;
+    }
+    if (n > sizeof(w->staging) - w->staged) json__writev_flush(ctx, w);
+    memcpy(w->staging + w->staged, s, n);
+    w->staged += n;
+}
+
+static void json__writev_ref(Json_Context *ctx, Json__Writev *w, const char *s, size_t n)
+{
+    json__writev_cover(w);
+    w->iov[w->count].iov_base = (void*)s;
+    w->iov[w->count].iov_len = n;
+    w->count++;
+    /* the next one may need two entries, the staged bytes and its own */
+    if (w->count + 2 > JSON__WRITEV_IOVECS) json__writev_flush(ctx, w);
+}
+
+/* the staged bytes after the last entry get one, to keep the order */
+static void json__writev_cover(Json__Writev *w)
+{
+    if (w->staged > w->covered) {
+        w->iov[w->count].iov_base = w->staging + w->covered;
+        w->iov[w->count].iov_len = w->staged - w->covered;
+        w->count++;
+        w->covered = w->staged;
+    }
+}
+
+static void json__writev_flush(Json_Context *ctx, Json__Writev *w)
+{
+    struct iovec *iov = w->iov;
+    size_t count;
+
+    json__writev_cover(w);
+    count = w->count;
+    while (count > 0 && !w->failed) {
+        ssize_t n = writev(ctx->opt.output_fd, iov, (int)count);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            w->failed = true;
+            break;
+        }
+        /* a pipe or a socket may take part of it: skip what went out */
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+
+    w->count = 0;
+    w->staged = 0;
+    w->covered = 0;
+}
+#endif /* JSON_ENABLE_WRITEV */
+
+static void json__dump_indent(Json_Context *ctx, size_t level)
+{
+    for (size_t i = 0; i < level; i++) {
+        json__write(ctx, ctx->opt.indent);
+    }
+}
+
+static bool json_scope_begin(Json_Context *ctx, Json_Value scope)
+{
+    /* the member key must be taken now, nested scopes overwrite it; room
+       comes first so that running out of memory leaves no key without
+       its scope */
+    aris_vec__room(ctx, ctx->scopes);
+    if (ctx->root) {
+        ctx->root = &ctx->scopes[0];
+        aris_vec__room(ctx, ctx->scope_keys);
+        Json_Value key = json__member_key(ctx);
+        aris_vec__push(ctx, ctx->scope_keys, key);
+    }
+
+    json__push_scope(ctx, scope);
+    if (!ctx->root) {
+        ctx->code = JSON_OK;
+        ctx->root = &ctx->scopes[0];
+        JSON__STAT_ADD(ctx, values[scope.type], 1);
+    }
+
+    return true;
+}
+
+static bool json_scope_end(Json_Context *ctx)
+{
+    if (ctx->opt.shrink_to_fit) {
+        Json_Value *scope = json__get_current_scope(ctx);
+        if (scope->type == JSON_VALUE_OBJECT) {
+            aris_vec__shrink(ctx, scope->as.object);
+        } else if (scope->packed) {
+            aris_vec__shrink(ctx, scope->as.numbers);
+        } else {
+            aris_vec__shrink(ctx, scope->as.array);
+        }
+    }
+
+    /* ctx->root has the reference of ctx->scopes[0] */
+    if (aris_vec__size(ctx->scopes) == 1) return true;
+
+    json__element_room(ctx, &ctx->scopes[aris_vec__size(ctx->scopes) - 2]);
+    Json_Value pair_value = json__pop_scope(ctx);
+    json__append_element(ctx, aris_vec__pop(ctx->scope_keys), pair_value);
+
+    return true;
+}
+
+void json_cbor_dump(Json_Context *ctx)
+{
+    if (!JSON__READABLE(ctx)) return;
+    JSON__TIMER_BEGIN(ctx);
+    JSON__OUTPUT_BEGIN(ctx);
+    json__cbor_dump_value(ctx, ctx->root);
+    JSON__OUTPUT_END(ctx);
+    JSON__TIMER_END(ctx, dump_ns);
+}
+
+bool json_cbor_parse(Json_Context *ctx, const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char*)data;
+    size_t depth = aris_vec__size(ctx->scopes);
+    bool ok;
+
+    ctx->parse_error = (Json_Parse_Error){JSON_PARSE_OK};
+    if (ctx->code == JSON_FROZEN) return false;
+    if (ctx->code == JSON_OUT_OF_MEMORY) {
+        ctx->parse_error.code = JSON_PARSE_OUT_OF_MEMORY;
+        return false;
+    }
+    JSON__TIMER_BEGIN(ctx);
+    JSON__STAT_ADD(ctx, bytes_parsed, size);
+
+    /* like json_parse, the top level has to be an object or an array */
+    if (size == 0) {
+        ok = json__cbor_fail(ctx, &p, p, JSON_PARSE_UNEXPECTED_END, "an array or a map", "end of input");
+    } else if ((p[0] >> 5) != 4 && (p[0] >> 5) != 5) {
+        ok = json__cbor_fail(ctx, &p, p, JSON_PARSE_UNEXPECTED_TOKEN, "an array or a map", "another item");
+    } else {
+        ok = json__cbor_parse(ctx, &p, p + size);
+    }
+    if (!ok) {
+        /* a builder call that refused the item has no parse error of its own */
+        if (ctx->parse_error.code == JSON_PARSE_OK) {
+            json__cbor_fail(ctx, &p, p, JSON_PARSE_UNEXPECTED_TOKEN, "an item the tree can hold", "another item");
+        }
+        /* the input is binary, so it counts as a single line */
+        ctx->parse_error.offset = (size_t)(p - (const unsigned char*)data);
+        ctx->parse_error.line = 1;
+        ctx->parse_error.column = ctx->parse_error.offset + 1;
+        JSON__STAT_ADD(ctx, parse_errors, 1);
+        json__parse_unwind(ctx, depth);
+    }
+    JSON__TIMER_END(ctx, parse_ns);
+
+    return ok;
+}
+
+/* the position reached, which the error reports, stays in the frame of
+   json_cbor_parse, where a longjmp to this one leaves it intact */
+static bool json__cbor_parse(Json_Context *ctx, const unsigned char **data, const unsigned char *end)
+{
+    bool ok;
+
+    JSON__RECOVER(ctx, ok = json__cbor_parse_value(ctx, data, end, 0),
+                  ok = json__cbor_fail(ctx, data, *data, JSON_PARSE_OUT_OF_MEMORY,
+                                       "a document that fits in memory", "the end of memory");
+                  json__set_error(ctx, NULL, JSON_OUT_OF_MEMORY));
+
+    return ok;
+}
+
+static void json__cbor_head(Json_Context *ctx, unsigned char major, unsigned long long arg)
+{
+    unsigned char head[9];
+    size_t len;
+
+    major <<= 5;
+    if (arg < 24) {
+        head[0] = major | (unsigned char)arg;
+        len = 1;
+    } else if (arg <= 0xff) {
+        head[0] = major | 24;
+        len = 2;
+    } else if (arg <= 0xffff) {
+        head[0] = major | 25;
+        len = 3;
+    } else if (arg <= 0xffffffffull) {
+        head[0] = major | 26;
+        len = 5;
+    } else {
+        head[0] = major | 27;
+        len = 9;
+    }
+    for (size_t i = len - 1; i >= 1; i--) {
+        head[i] = (unsigned char)arg;
+        arg >>= 8;
+    }
+    json__write_n(ctx, (const char*)head, len);
+}
+
+static void json__cbor_dump_value(Json_Context *ctx, const Json_Value *value)
+{
+    switch (value->type) {
+    case JSON_VALUE_OBJECT:
+        json__cbor_head(ctx, 5, aris_vec__size(value->as.object));
+        for (size_t i = 0; i < aris_vec__size(value->as.object); i++) {
+            Json_Pair *pair = &value->as.object[i];
+            json__cbor_head(ctx, 3, json_string_length(&pair->key));
+            json__write_ref(ctx, json_to_string(&pair->key), json_string_length(&pair->key));
+            json__cbor_dump_value(ctx, &pair->value);
+        }
+        break;
+
+    case JSON_VALUE_ARRAY:
+        json__cbor_head(ctx, 4, aris_vec__size(value->as.array));
+        for (size_t i = 0; i < aris_vec__size(value->as.array); i++) {
+            Json_Value tmp;
+            json__cbor_dump_value(ctx, json__element(value, i, &tmp));
+        }
+        break;
+
+    case JSON_VALUE_STRING: {
+        const char *s = json__string_or_empty(value);
+        size_t len = json_string_length(value);
+        json__cbor_head(ctx, 3, len);
+        json__write_ref(ctx, s, len);
+    } break;
+
+    case JSON_VALUE_NUMBER: {
+        double d = value->as.number;
+        unsigned char bytes[9];
+        unsigned long long bits;
+
+        /* integers take the shortest head, other values float32 if exact */
+        if (d >= -9223372036854775808.0 && d < 9223372036854775808.0 &&
+            d == (double)(long long)d && !(d == 0 && signbit(d))) {
+            long long i = (long long)d;
+            if (i >= 0) {
+                json__cbor_head(ctx, 0, (unsigned long long)i);
+            } else {
+                json__cbor_head(ctx, 1, (unsigned long long)(-1 - i));
+            }
+        } else if ((double)(float)d == d) {
+            float f = (float)d;
+            unsigned int fbits;
+            memcpy(&fbits, &f, sizeof(fbits));
+            bytes[0] = 0xfa;
+            for (size_t i = 4; i >= 1; i--) {
+                bytes[i] = (unsigned char)fbits;
+                fbits >>= 8;
+            }
+            json__write_n(ctx, (const char*)bytes, 5);
+        } else {
+            memcpy(&bits, &d, sizeof(bits));
+            bytes[0] = 0xfb;
+            for (size_t i = 8; i >= 1; i--) {
+                bytes[i] = (unsigned char)bits;
+                bits >>= 8;
+            }
+            json__write_n(ctx, (const char*)bytes, 9);
+        }
+    } break;
+
+    case JSON_VALUE_BOOLEAN:
+        json__write_n(ctx, value->as.boolean ? "\xf5" : "\xf4", 1);
+        break;
+
+    case JSON_VALUE_NULL:
+        json__write_n(ctx, "\xf6", 1);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/* read the argument of the head at '*data', 'info' is its low 5 bits */
+static bool json__cbor_arg(const unsigned char **data, const unsigned char *end,
+                           unsigned char info, unsigned long long *arg)
+{
+    size_t len;
+
+    if (info < 24) {
+        *arg = info;
+        return true;
+    }
+    switch (info) {
+    case 24: len = 1; break;
+    case 25: len = 2; break;
+    case 26: len = 4; break;
+    case 27: len = 8; break;
+    default: return false;
+    }
+    if ((size_t)(end - *data) < len) return false;
+
+    *arg = 0;
+    for (size_t i = 0; i < len; i++) *arg = (*arg << 8) | (*data)[i];
+    *data += len;
+    return true;
+}
+
+static double json__cbor_half(unsigned int half)
+{
+    int exponent = (half >> 10) & 0x1f;
+    double mantissa = half & 0x3ff;
+    double value;
+
+    if (exponent == 0) {
+        value = mantissa / 16777216.0;                 /* 2^-24 */
+    } else if (exponent != 31) {
+        value = (mantissa + 1024) / 33554432.0;        /* 2^-25 */
+        for (; exponent > 0; exponent--) value *= 2;
+    } else {
+        value = mantissa == 0 ? HUGE_VAL : NAN;
+    }
+    return half & 0x8000 ? -value : value;
+}
+
+/* the first reason the input was rejected, with '*data' put back on
+   the offending byte 'at' */
+static bool json__cbor_fail(Json_Context *ctx, const unsigned char **data, const unsigned char *at,
+                            Json_Parse_Error_Code code, const char *expected, const char *found)
+{
+    if (ctx->parse_error.code != JSON_PARSE_OK) return false;
+    ctx->parse_error.code = code;
+    ctx->parse_error.expected = expected;
+    ctx->parse_error.found = found;
+    *data = at;
+    return false;
+}
+
+/* the head at 'item' has a reserved argument size, or its argument is cut short */
+static bool json__cbor_bad_arg(Json_Context *ctx, const unsigned char **data,
+                               const unsigned char *item, unsigned char info)
+{
+    if (info >= 28) {
+        return json__cbor_fail(ctx, data, item, JSON_PARSE_UNEXPECTED_TOKEN,
+                               "a well-formed item", "a reserved argument size");
+    }
+    return json__cbor_fail(ctx, data, *data, JSON_PARSE_UNEXPECTED_END, "the rest of the item", "end of input");
+}
+
+static bool json__cbor_parse_value(Json_Context *ctx, const unsigned char **data,
+                                   const unsigned char *end, size_t depth)
+{
+    const unsigned char *item = *data;
+    unsigned char major, info;
+    unsigned long long arg = 0;
+    bool indefinite;
+
+    if (*data >= end) return json__cbor_fail(ctx, data, end, JSON_PARSE_UNEXPECTED_END, "an item", "end of input");
+    if (depth > JSON__CBOR_MAX_DEPTH) {
+        return json__cbor_fail(ctx, data, item, JSON_PARSE_TOO_DEEP, "fewer nested items", "another nested item");
+    }
+    major = **data >> 5;
+    info = **data & 0x1f;
+    (*data)++;
+    JSON__STAT_ADD(ctx, tokens, 1);
+
+    indefinite = info == 31 && (major == 4 || major == 5);
+    if (!indefinite && major != 7 && !json__cbor_arg(data, end, info, &arg)) {
+        return json__cbor_bad_arg(ctx, data, item, info);
+    }
+
+    switch (major) {
+    case 0:
+        return json_number(ctx, (double)arg);
+
+    case 1:
+        return json_number(ctx, -1.0 - (double)arg);
+
+    case 3:
+        if (arg > (unsigned long long)(end - *data)) {
+            return json__cbor_fail(ctx, data, end, JSON_PARSE_UNEXPECTED_END, "the rest of the string", "end of input");
+        }
+        json_string_n(ctx, (const char*)*data, (size_t)arg);
+        *data += arg;
+        return ctx->code == JSON_OK;
+
+    case 4:
+        /* every element takes at least one byte, so the hint is bounded */
+        if (!indefinite && arg > (unsigned long long)(end - *data)) {
+            return json__cbor_fail(ctx, data, end, JSON_PARSE_UNEXPECTED_END, "the rest of the array", "end of input");
+        }
+        json_array_begin_n(ctx, indefinite ? 0 : (size_t)arg);
+        for (unsigned long long i = 0; indefinite || i < arg; i++) {
+            if (indefinite && *data < end && **data == 0xff) {
+                (*data)++;
+                break;
+            }
+            if (!json__cbor_parse_value(ctx, data, end, depth + 1)) return false;
+        }
+        return json_array_end(ctx);
+
+    case 5:
+        if (!indefinite && arg > (unsigned long long)(end - *data)/2) {
+            return json__cbor_fail(ctx, data, end, JSON_PARSE_UNEXPECTED_END, "the rest of the map", "end of input");
+        }
+        json_object_begin_n(ctx, indefinite ? 0 : (size_t)arg);
+        for (unsigned long long i = 0; indefinite || i < arg; i++) {
+            const unsigned char *key = *data;
+            unsigned long long len;
+            if (*data >= end) return json__cbor_fail(ctx, data, end, JSON_PARSE_UNEXPECTED_END, "a key", "end of input");
+            if (indefinite && **data == 0xff) {
+                (*data)++;
+                break;
+            }
+            /* JSON only has text keys */
+            if ((**data >> 5) != 3) {
+                return json__cbor_fail(ctx, data, key, JSON_PARSE_UNEXPECTED_TOKEN, "a text key", "another item");
+            }
+            info = **data & 0x1f;
+            (*data)++;
+            if (!json__cbor_arg(data, end, info, &len)) return json__cbor_bad_arg(ctx, data, key, info);
+            if (len > (unsigned long long)(end - *data)) {
+                return json__cbor_fail(ctx, data, end, JSON_PARSE_UNEXPECTED_END, "the rest of the key", "end of input");
+            }
+            if (!json_key_n(ctx, (const char*)*data, (size_t)len)) {
+                if (ctx->code == JSON_DOUBLE_KEY) {
+                    return json__cbor_fail(ctx, data, key, JSON_PARSE_DUPLICATE_KEY, "a key not used before", "a repeated key");
+                }
+                return json__cbor_fail(ctx, data, key, JSON_PARSE_KEY_TOO_LONG, "a key of at most 256 bytes", "a longer key");
+            }
+            *data += len;
+            if (!json__cbor_parse_value(ctx, data, end, depth + 1)) return false;
+        }
+        return json_object_end(ctx);
+
+    case 6:
+        /* tags carry no meaning in JSON, keep the tagged value */
+        return json__cbor_parse_value(ctx, data, end, depth + 1);
+
+    case 7:
+        switch (info) {
+        case 20: return json_boolean(ctx, false);
+        case 21: return json_boolean(ctx, true);
+        case 22: /* null */
+        case 23: /* undefined */
+            return json_null(ctx);
+        case 25: case 26: case 27: {
+            double d;
+            if (!json__cbor_arg(data, end, info, &arg)) return json__cbor_bad_arg(ctx, data, item, info);
+            if (info == 25) {
+                d = json__cbor_half((unsigned int)arg);
+            } else if (info == 26) {
+                unsigned int fbits = (unsigned int)arg;
+                float f;
+                memcpy(&f, &fbits, sizeof(f));
+                d = f;
+            } else {
+                memcpy(&d, &arg, sizeof(d));
+            }
+            return json_number(ctx, d);
+        }
+        default:
+            return json__cbor_fail(ctx, data, item, JSON_PARSE_UNEXPECTED_TOKEN, "a value JSON has", "another simple value");
+        }
+
+    default:
+        /* byte strings have no JSON counterpart */
+        return json__cbor_fail(ctx, data, item, JSON_PARSE_UNEXPECTED_TOKEN, "a value JSON has", "a byte string");
+    }
+}
+
+void json_image_dump(Json_Context *ctx)
+{
+    Json_Image__Builder b = {0};
+
+    if (!JSON__READABLE(ctx)) return;
+    JSON__TIMER_BEGIN(ctx);
+
+    JSON__OUTPUT_BEGIN(ctx);
+    json__image_dump(ctx, &b);
+    JSON__OUTPUT_END(ctx);
+    aris_vec__free(ctx, b.data);
+    aris_vec__free(ctx, b.tmp);
+
+    JSON__TIMER_END(ctx, dump_ns);
+}
+
+/* the builder and the writev state stay in json_image_dump's frame,
+   which a longjmp to this one leaves intact */
+static void json__image_dump(Json_Context *ctx, Json_Image__Builder *b)
+{
+    JSON__RECOVER(ctx, json__image_write(ctx, b), json__memory_error(ctx));
+}
+
+bool json_image_open(Json_Image *image, const void *data, size_t size)
+{
+    const Json_Image__Header *header = (const Json_Image__Header*)data;
+
+    if (!data || size < sizeof(*header) || (uintptr_t)data % 8 != 0) return false;
+    if (header->magic != JSON__IMAGE_MAGIC ||
+        header->version != JSON__IMAGE_VERSION ||
+        header->endian != JSON__IMAGE_ENDIAN ||
+        header->size > size) {
+        return false;
+    }
+
+    image->data = (const unsigned char*)data;
+    image->size = (size_t)header->size;
+    return true;
+}
+
+const Json_Image_Node *json_image_get_root(const Json_Image *image)
+{
+    return &((const Json_Image__Header*)image->data)->root;
+}
+
+const Json_Image_Node *json_image_object_get_value(const Json_Image *image, const Json_Image_Node *node, const char *key)
+{
+    const Json_Image__Member *members;
+    const uint32_t *sorted;
+    size_t key_size, lo = 0, hi;
+
+    if (!key || !node || node->type != JSON_VALUE_OBJECT) return NULL;
+    members = (const Json_Image__Member*)json__image_at(image, node->payload,
+        (uint64_t)node->count*(sizeof(*members) + sizeof(*sorted)));
+    if (!members) return NULL;
+    sorted = (const uint32_t*)(members + node->count);
+    key_size = strlen(key);
+
+    /* the index keeps the member positions ordered by key */
+    hi = node->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+        const Json_Image__Member *member;
+        const char *member_key;
+        int cmp;
+
+        if (sorted[mid] >= node->count) return NULL;
+        member = &members[sorted[mid]];
+        member_key = (const char*)json__image_at(image, member->key, member->key_size + 1);
+        if (!member_key) return NULL;
+        cmp = json__image_key_compare(member_key, (size_t)member->key_size, key, key_size);
+        if (cmp == 0) return &member->value;
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return NULL;
+}
+
+const char *json_image_object_get_key(const Json_Image *image, const Json_Image_Node *node, size_t idx)
+{
+    const Json_Image__Member *member;
+
+    if (!node || node->type != JSON_VALUE_OBJECT || idx >= node->count) return NULL;
+    member = (const Json_Image__Member*)json__image_at(image, node->payload + idx*sizeof(*member), sizeof(*member));
+    if (!member) return NULL;
+    return (const char*)json__image_at(image, member->key, member->key_size + 1);
+}
+
+const Json_Image_Node *json_image_object_get_member(const Json_Image *image, const Json_Image_Node *node, size_t idx)
+{
+    const Json_Image__Member *member;
+
+    if (!node || node->type != JSON_VALUE_OBJECT || idx >= node->count) return NULL;
+    member = (const Json_Image__Member*)json__image_at(image, node->payload + idx*sizeof(*member), sizeof(*member));
+    return member ? &member->value : NULL;
+}
+
+const Json_Image_Node *json_image_array_get_value(const Json_Image *image, const Json_Image_Node *node, size_t idx)
+{
+    if (!node || node->type != JSON_VALUE_ARRAY || idx >= node->count) return NULL;
+    return (const Json_Image_Node*)json__image_at(image, node->payload + idx*sizeof(*node), sizeof(*node));
+}
+
+const char *json_image_to_string(const Json_Image *image, const Json_Image_Node *node)
+{
+    if (!node || node->type != JSON_VALUE_STRING) return NULL;
+    return (const char*)json__image_at(image, node->payload, (uint64_t)node->count + 1);
+}
+
+double json_image_to_number(const Json_Image_Node *node)
+{
+    double number;
+    memcpy(&number, &node->payload, sizeof(number));
+    return number;
+}
+
+/* append 'size' zeroed bytes at the next multiple of 'align', return their offset */
+/* the header and the tree below it, laid out in 'b->data' and written
+   once they are complete, so running out of memory writes nothing */
+static void json__image_write(Json_Context *ctx, Json_Image__Builder *b)
+{
+    Json_Image__Header header = {
+        .magic = JSON__IMAGE_MAGIC,
+        .version = JSON__IMAGE_VERSION,
+        .endian = JSON__IMAGE_ENDIAN,
+    };
+
+    json__image_reserve(ctx, b, sizeof(header), 8);
+    header.root = json__image_build(ctx, b, ctx->root);
+    header.size = aris_vec__size(b->data);
+    memcpy(b->data, &header, sizeof(header));
+    json__write_n(ctx, (const char*)b->data, aris_vec__size(b->data));
+}
+
+static size_t json__image_reserve(Json_Context *ctx, Json_Image__Builder *b, size_t size, size_t align)
+{
+    size_t offset = (aris_vec__size(b->data) + align - 1) & ~(align - 1);
+    size_t needed = offset + size;
+
+    if (needed > aris_vec__capacity(b->data)) {
+        size_t capacity = aris_vec__capacity(b->data) ? aris_vec__capacity(b->data) : 4096;
+        while (capacity < needed) capacity *= 2;
+        aris_vec__reserve(ctx, b->data, capacity);
+    }
+    memset(b->data + aris_vec__size(b->data), 0, needed - aris_vec__size(b->data));
+    aris_vec__header(b->data)->size = needed;
+
+    return offset;
+}
+
+static Json_Image_Node json__image_build(Json_Context *ctx, Json_Image__Builder *b, const Json_Value *value)
+{
+    Json_Image_Node node = {.type = value->type};
+
+    switch (value->type) {
+    case JSON_VALUE_OBJECT: {
+        size_t count = aris_vec__size(value->as.object);
+        if (count > UINT32_MAX) json__out_of_memory(ctx);
+        size_t members = json__image_reserve(ctx, b, count*sizeof(Json_Image__Member), 8);
+        size_t sorted = json__image_reserve(ctx, b, count*sizeof(uint32_t), 4);
+
+        for (size_t i = 0; i < count; i++) ((uint32_t*)(b->data + sorted))[i] = (uint32_t)i;
+        aris_vec__reserve(ctx, b->tmp, count);
+        json__sort_keys((uint32_t*)(b->data + sorted), b->tmp, count, value->as.object,
+                        json__image_key_compare);
+
+        /* 'b->data' moves while the members are built, copy through offsets */
+        for (size_t i = 0; i < count; i++) {
+            Json_Pair *pair = &value->as.object[i];
+            Json_Image__Member member = {.key_size = (uint32_t)json_string_length(&pair->key)};
+            member.key = json__image_reserve(ctx, b, member.key_size + 1, 1);
+            memcpy(b->data + member.key, json_to_string(&pair->key), member.key_size);
+            member.value = json__image_build(ctx, b, &pair->value);
+            memcpy(b->data + members + i*sizeof(member), &member, sizeof(member));
+        }
+        node.count = (uint32_t)count;
+        node.payload = members;
+    } break;
+
+    case JSON_VALUE_ARRAY: {
+        size_t count = aris_vec__size(value->as.array);
+        if (count > UINT32_MAX) json__out_of_memory(ctx);
+        size_t nodes = json__image_reserve(ctx, b, count*sizeof(Json_Image_Node), 8);
+
+        for (size_t i = 0; i < count; i++) {
+            Json_Value tmp;
+            Json_Image_Node child = json__image_build(ctx, b, json__element(value, i, &tmp));
+            memcpy(b->data + nodes + i*sizeof(child), &child, sizeof(child));
+        }
+        node.count = (uint32_t)count;
+        node.payload = nodes;
+    } break;
+
+    case JSON_VALUE_STRING: {
+        const char *s = json__string_or_empty(value);
+        size_t len = json_string_length(value);
+        node.count = (uint32_t)len;
+        node.payload = json__image_reserve(ctx, b, len + 1, 1);
+        memcpy(b->data + node.payload, s, len);
+    } break;
+
+    case JSON_VALUE_NUMBER:
+        memcpy(&node.payload, &value->as.number, sizeof(node.payload));
+        break;
+
+    case JSON_VALUE_BOOLEAN:
+        node.payload = value->as.boolean;
+        break;
+
+    default:
+        break;
+    }
+
+    return node;
+}
+
+void json_canonical_dump(Json_Context *ctx)
+{
+    Json__Canonical c;
+
+    if (!JSON__READABLE(ctx)) return;
+    JSON__TIMER_BEGIN(ctx);
+
+    JSON__OUTPUT_BEGIN(ctx);
+    c.order = NULL;
+    c.tmp = NULL;
+    c.used = 0;
+    json__canonical_dump(ctx, &c);
+    JSON__OUTPUT_END(ctx);
+    aris_vec__free(ctx, c.order);
+    aris_vec__free(ctx, c.tmp);
+
+    JSON__TIMER_END(ctx, dump_ns);
+}
+
+/* as json__image_dump, for the sort vectors of json_canonical_dump */
+static void json__canonical_dump(Json_Context *ctx, Json__Canonical *c)
+{
+    JSON__RECOVER(ctx, json__canonical_value(ctx, c, ctx->root); json__write_n(ctx, c->buffer, c->used),
+                  json__memory_error(ctx));
+}
+
+Json_Hash json_hash(const Json_Value *value)
+{
+    return json__hash_value(value);
+}
+
+static void json__canonical_write(Json_Context *ctx, Json__Canonical *c, const char *s, size_t n)
+{
+    if (c->used + n > sizeof(c->buffer)) {
+        json__write_n(ctx, c->buffer, c->used);
+        c->used = 0;
+        /* only the runs of a string in the tree are this long, they go
+           to the sink as they are */
+        if (n > sizeof(c->buffer)) {
+            json__write_ref(ctx, s, n);
+            return;
+        }
+    }
+    memcpy(c->buffer + c->used, s, n);
+    c->used += n;
+}
+
+static void json__canonical_value(Json_Context *ctx, Json__Canonical *c, const Json_Value *value)
+{
+    char number[32];
+
+    switch (value->type) {
+    case JSON_VALUE_OBJECT: {
+        size_t size = aris_vec__size(value->as.object);
+        size_t base = aris_vec__size(c->order);
+
+        if (size > UINT32_MAX) json__out_of_memory(ctx);
+        /* the order of this object stays below those of its children,
+           which may move the vector: it is read through 'base' */
+        if (base + size > aris_vec__capacity(c->order)) {
+            size_t capacity = 2*aris_vec__capacity(c->order);
+            aris_vec__reserve(ctx, c->order, capacity > base + size ? capacity : base + size);
+        }
+        aris_vec__reserve(ctx, c->tmp, size);
+        for (size_t i = 0; i < size; i++) c->order[base + i] = (uint32_t)i;
+        if (c->order) aris_vec__header(c->order)->size = base + size;
+        json__sort_keys(c->order + base, c->tmp, size, value->as.object, json__canonical_key_compare);
+
+        json__canonical_write(ctx, c, "{", 1);
+        for (size_t i = 0; i < size; i++) {
+            const Json_Pair *pair = &value->as.object[c->order[base + i]];
+            if (i > 0) json__canonical_write(ctx, c, ",", 1);
+            json__canonical_string(ctx, c, json_to_string(&pair->key), json_string_length(&pair->key));
+            json__canonical_write(ctx, c, ":", 1);
+            json__canonical_value(ctx, c, &pair->value);
+        }
+        json__canonical_write(ctx, c, "}", 1);
+        if (c->order) aris_vec__header(c->order)->size = base;
+        break;
+    }
+
+    case JSON_VALUE_ARRAY:
+        json__canonical_write(ctx, c, "[", 1);
+        for (size_t i = 0; i < aris_vec__size(value->as.array); i++) {
+            Json_Value tmp;
+            if (i > 0) json__canonical_write(ctx, c, ",", 1);
+            json__canonical_value(ctx, c, json__element(value, i, &tmp));
+        }
+        json__canonical_write(ctx, c, "]", 1);
+        break;
+
+    case JSON_VALUE_STRING:
+        json__canonical_string(ctx, c, json__string_or_empty(value), json_string_length(value));
+        break;
+
+    case JSON_VALUE_NUMBER:
+        json__canonical_write(ctx, c, number, json__canonical_number(value->as.number, number));
+        break;
+
+    case JSON_VALUE_BOOLEAN:
+        if (value->as.boolean) {
+            json__canonical_write(ctx, c, "true", 4);
+        } else {
+            json__canonical_write(ctx, c, "false", 5);
+        }
+        break;
+
+    default:
+        json__canonical_write(ctx, c, "null", 4);
+        break;
+    }
+}
+
+static void json__canonical_string(Json_Context *ctx, Json__Canonical *c, const char *s, size_t n)
+{
+    size_t plain = 0;   /* first byte not written yet */
+    char escape[6];
+
+    json__canonical_write(ctx, c, "\"", 1);
+    for (size_t i = json__plain_size(s, n); i < n; i = plain + json__plain_size(s + plain, n - plain)) {
+        size_t size = json__escape((unsigned char)s[i], escape);
+        json__canonical_write(ctx, c, s + plain, i - plain);
+        json__canonical_write(ctx, c, escape, size);
+        plain = i + 1;
+    }
+    json__canonical_write(ctx, c, s + plain, n - plain);
+    json__canonical_write(ctx, c, "\"", 1);
+}
+
+/* ECMAScript's Number.prototype.toString, which RFC 8785 follows: the
+   fewest digits that read back the same number, and an exponent only
+   below 1e-6 or from 1e21 on. NaN and the infinities are not JSON, they
+   become null as in JSON.stringify. 'out' has room for 32 bytes. */
+static size_t json__canonical_number(double number, char *out)
+{
+    char buffer[40], digits[20];
+    const char *c = buffer;
+    int k = 0, n;
+    size_t len = 0;
+
+    if (isnan(number) || isinf(number)) {
+        memcpy(out, "null", 5);
+        return 4;
+    }
+    if (number == 0) {
+        memcpy(out, "0", 2);
+        return 1;
+    }
+    if (number > -1e15 && number < 1e15 && number == (double)(long long)number) {
+        return json__format_number(number, out);
+    }
+
+    /* 15 significant digits name one double at most, so if they read
+       back the same, dropping their trailing zeros gives the shortest
+       form; subnormals have fewer digits of their own and search from 1 */
+    for (int precision = fabs(number) < DBL_MIN ? 1 : 15;; precision++) {
+        snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, number);
+        if (precision == 17 || strtod(buffer, NULL) == number) break;
+    }
+    if (*c == '-') out[len++] = *c++;
+    for (; *c != 'e'; c++) {
+        if (*c != '.') digits[k++] = *c;
+    }
+    while (k > 1 && digits[k - 1] == '0') k--;
+    n = atoi(c + 1) + 1;    /* the number is 0.digits times 10^n */
+
+    if (k <= n && n <= 21) {
+        memcpy(out + len, digits, (size_t)k);
+        len += (size_t)k;
+        for (int i = k; i < n; i++) out[len++] = '0';
+    } else if (0 < n && n <= 21) {
+        memcpy(out + len, digits, (size_t)n);
+        len += (size_t)n;
+        out[len++] = '.';
+        memcpy(out + len, digits + n, (size_t)(k - n));
+        len += (size_t)(k - n);
+    } else if (-6 < n && n <= 0) {
+        out[len++] = '0';
+        out[len++] = '.';
+        for (int i = n; i < 0; i++) out[len++] = '0';
+        memcpy(out + len, digits, (size_t)k);
+        len += (size_t)k;
+    } else {
+        out[len++] = digits[0];
+        if (k > 1) {
+            out[len++] = '.';
+            memcpy(out + len, digits + 1, (size_t)(k - 1));
+            len += (size_t)(k - 1);
+        }
+        len += (size_t)snprintf(out + len, 32 - len, "e%c%d", n > 0 ? '+' : '-', n > 0 ? n - 1 : 1 - n);
+    }
+    out[len] = '\0';
+
+    return len;
+}
+
+/* RFC 8785 orders keys by their UTF-16 code units. That is the order of
+   the UTF-8 bytes, except that characters above U+FFFF (surrogate pairs
+   in UTF-16) come before those from U+E000 to U+FFFF. */
+static int json__canonical_key_compare(const char *a, size_t a_size, const char *b, size_t b_size)
+{
+    size_t n = a_size < b_size ? a_size : b_size;
+    size_t i = 0;
+    unsigned char x, y;
+
+    while (i < n && a[i] == b[i]) i++;
+    if (i == n) return (a_size > b_size) - (a_size < b_size);
+
+    /* the first difference is in the lead byte of a character, or both
+       characters have the same lead byte and size */
+    x = (unsigned char)a[i];
+    y = (unsigned char)b[i];
+    if (x >= 0xF0 && y >= 0xEE && y < 0xF0) return -1;
+    if (y >= 0xF0 && x >= 0xEE && x < 0xF0) return 1;
+    return x < y ? -1 : 1;
+}
+
+/* Every value starts from its type. Arrays hash their elements in order;
+   objects add up the hashes of their members so that the order does not
+   matter. Numbers hash their bits, with -0 taken as 0. */
+static Json_Hash json__hash_value(const Json_Value *value)
+{
+    Json_Hash h = {0, 0};
+
+    json__hash_word(&h, value->type);
+    switch (value->type) {
+    case JSON_VALUE_OBJECT: {
+        Json_Hash sum = {0, 0};
+        for (size_t i = 0; i < aris_vec__size(value->as.object); i++) {
+            const Json_Pair *pair = &value->as.object[i];
+            Json_Hash member = {0, 0};
+            Json_Hash v = json__hash_value(&pair->value);
+
+            json__hash_string(&member, json_to_string(&pair->key), json_string_length(&pair->key));
+            json__hash_word(&member, v.lo);
+            json__hash_word(&member, v.hi);
+            sum.lo += member.lo;
+            sum.hi += member.hi;
+        }
+        json__hash_word(&h, aris_vec__size(value->as.object));
+        json__hash_word(&h, sum.lo);
+        json__hash_word(&h, sum.hi);
+        break;
+    }
+
+    case JSON_VALUE_ARRAY:
+        json__hash_word(&h, aris_vec__size(value->as.array));
+        for (size_t i = 0; i < aris_vec__size(value->as.array); i++) {
+            Json_Value tmp;
+            Json_Hash element = json__hash_value(json__element(value, i, &tmp));
+            json__hash_word(&h, element.lo);
+            json__hash_word(&h, element.hi);
+        }
+        break;
+
+    case JSON_VALUE_STRING:
+        json__hash_string(&h, json__string_or_empty(value), json_string_length(value));
+        break;
+
+    case JSON_VALUE_NUMBER: {
+        double number = value->as.number == 0 ? 0.0 : value->as.number;
+        uint64_t bits;
+        memcpy(&bits, &number, sizeof(bits));
+        json__hash_word(&h, bits);
+        break;
+    }
+
+    case JSON_VALUE_BOOLEAN:
+        json__hash_word(&h, value->as.boolean);
+        break;
+
+    default:
+        break;
+    }
+
+    return h;
+}
+
+/* eight bytes at a time, read as little-endian so that the hash does not
+   depend on the platform */
+static void json__hash_string(Json_Hash *h, const char *s, size_t n)
+{
+    const unsigned char *p = (const unsigned char*)s;
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint64_t word = 0;
+        for (int b = 7; b >= 0; b--) word = word << 8 | p[i + b];
+        json__hash_word(h, word);
+    }
+    if (i < n) {
+        uint64_t word = 0;
+        for (size_t b = n; b > i; b--) word = word << 8 | p[b - 1];
+        json__hash_word(h, word);
+    }
+    json__hash_word(h, n);
+}
+
+static void json__hash_word(Json_Hash *h, uint64_t word)
+{
+    h->lo = json__hash_mix(h->lo ^ word);
+    h->hi = json__hash_mix(h->hi + word*0x9E3779B97F4A7C15ull);
+}
+
+/* the finalizer of MurmurHash3 */
+static uint64_t json__hash_mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+/* stable merge sort of member indices by key */
+static void json__sort_keys(uint32_t *idx, uint32_t *tmp, size_t n, const Json_Pair *pairs,
+                            Json__Key_Compare compare)
+{
+    size_t mid = n/2, i = 0, j = mid, k = 0;
+
+    if (n < 2) return;
+    json__sort_keys(idx, tmp, mid, pairs, compare);
+    json__sort_keys(idx + mid, tmp, n - mid, pairs, compare);
+
+    while (i < mid && j < n) {
+        const Json_Value *a = &pairs[idx[i]].key, *b = &pairs[idx[j]].key;
+        if (compare(json_to_string(a), json_string_length(a),
+                    json_to_string(b), json_string_length(b)) <= 0) {
+            tmp[k++] = idx[i++];
+        } else {
+            tmp[k++] = idx[j++];
+        }
+    }
+    while (i < mid) tmp[k++] = idx[i++];
+    while (j < n) tmp[k++] = idx[j++];
+    memcpy(idx, tmp, n*sizeof(*idx));
+}
+
+static int json__image_key_compare(const char *a, size_t a_size, const char *b, size_t b_size)
+{
+    int cmp = memcmp(a, b, a_size < b_size ? a_size : b_size);
+    if (cmp != 0) return cmp;
+    return (a_size > b_size) - (a_size < b_size);
+}
+
+/* images may come from disk, so every offset is checked before use */
+static const void *json__image_at(const Json_Image *image, uint64_t offset, uint64_t size)
+{
+    if (offset > image->size || size > image->size - offset) return NULL;
+    return image->data + offset;
+}
+
+static const char *json__string_or_empty(const Json_Value *value)
+{
+    const char *s = json_to_string(value);
+    return s ? s : "";
+}
+
+static size_t json__hash_key(const char *key, size_t n)
+{
+    /* FNV-1a */
+    size_t hash = (size_t)14695981039346656037ull;
+    for (size_t i = 0; i < n; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= (size_t)1099511628211ull;
+    }
+    return hash;
+}
+
+/* Open addressing table over the first 'size' pairs, with room for
+   'extra' more to be added. Small objects are scanned instead. The table
+   is held until json__key_index_fini. */
+static void json__key_index_init(Json_Context *ctx, Json__Key_Index *index,
+                                 const Json_Pair *pairs, size_t size, size_t extra)
+{
+    index->slots = NULL;
+    index->mask = 0;
+    index->size = size;
+    if (size + extra <= JSON__KEY_INDEX_MIN) return;
+
+    size_t capacity = 16;
+    while (capacity < 2*(size + extra)) capacity *= 2;
+    index->slots = (size_t*)json__hold_block(ctx, capacity*sizeof(*index->slots));
+    memset(index->slots, 0, capacity*sizeof(*index->slots));
+    index->mask = capacity - 1;
+
+    for (size_t i = 0; i < size; i++) json__key_index_add(index, pairs, i);
+    index->size = size;
+}
+
+static void json__key_index_fini(Json_Context *ctx, Json__Key_Index *index)
+{
+    if (index->slots) json__release_block(ctx, index->slots, (index->mask + 1)*sizeof(*index->slots));
+    index->slots = NULL;
+}
+
+static void json__key_index_add(Json__Key_Index *index, const Json_Pair *pairs, size_t idx)
+{
+    index->size = idx + 1;
+    if (!index->slots) return;
+
+    const Json_Value *key = &pairs[idx].key;
+    size_t slot = json__hash_key(json_to_string(key), json_string_length(key)) & index->mask;
+    while (index->slots[slot]) slot = (slot + 1) & index->mask;
+    index->slots[slot] = idx + 1;
+}
+
+static size_t json__key_index_find(const Json__Key_Index *index, const Json_Pair *pairs, const Json_Value *key)
+{
+    const char *s = json_to_string(key);
+    size_t n = json_string_length(key);
+
+    if (!index->slots) {
+        for (size_t i = 0; i < index->size; i++) {
+            if (json__key_equal(&pairs[i].key, s, n, key->hash)) return i;
+        }
+        return JSON__NOT_FOUND;
+    }
+
+    size_t slot = json__hash_key(s, n) & index->mask;
+    while (index->slots[slot]) {
+        size_t i = index->slots[slot] - 1;
+        if (json__key_equal(&pairs[i].key, s, n, key->hash)) return i;
+        slot = (slot + 1) & index->mask;
+    }
+    return JSON__NOT_FOUND;
+}
+
+static Json_Value json__clone_value(Json_Context *ctx, const Json_Value *value)
+{
+    Json_Value copy = *value;
+
+    copy.indexed = false;
+    copy.shared = false;
+    /* a container is held while it fills, its members go in as they are
+       copied and the vector does not move */
+    switch (value->type) {
+    case JSON_VALUE_OBJECT:
+        copy.as.object = NULL;
+        json__hold_room(ctx);
+        aris_vec__reserve(ctx, copy.as.object, aris_vec__size(value->as.object));
+        json__hold(ctx, &copy);
+        for (size_t i = 0; i < aris_vec__size(value->as.object); i++) {
+            Json_Pair pair = {json__clone_value(ctx, &value->as.object[i].key), {.type = JSON_VALUE_NULL}};
+            aris_vec__push(ctx, copy.as.object, pair);
+            copy.as.object[i].value = json__clone_value(ctx, &value->as.object[i].value);
+        }
+        json__release(ctx);
+        break;
+
+    case JSON_VALUE_ARRAY:
+        if (value->packed) {
+            size_t size = aris_vec__size(value->as.numbers);
+            copy.as.numbers = NULL;
+            aris_vec__reserve(ctx, copy.as.numbers, size);
+            memcpy(copy.as.numbers, value->as.numbers, size*sizeof(*copy.as.numbers));
+            aris_vec__header(copy.as.numbers)->size = size;
+            break;
+        }
+        copy.as.array = NULL;
+        json__hold_room(ctx);
+        aris_vec__reserve(ctx, copy.as.array, aris_vec__size(value->as.array));
+        json__hold(ctx, &copy);
+        for (size_t i = 0; i < aris_vec__size(value->as.array); i++) {
+            Json_Value element = json__clone_value(ctx, &value->as.array[i]);
+            aris_vec__push(ctx, copy.as.array, element);
+        }
+        json__release(ctx);
+        break;
+
+    case JSON_VALUE_STRING:
+        if (!value->small && value->as.string) {
+            copy.as.string = (char*)json__malloc(ctx, value->length + 1);
+            memcpy(copy.as.string, value->as.string, value->length + 1);
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return copy;
+}
+
+/* json_freeze puts the index of an object right behind its members, in
+   the same block: the slot mask, then the slots (member index + 1, or 0
+   if empty). The capacity of the vector is cut to its size first. */
+static size_t *json__frozen_index(const Json_Value *object)
+{
+    return (size_t*)(object->as.object + aris_vec__capacity(object->as.object));
+}
+
+static size_t json__frozen_bytes(const Json_Value *object)
+{
+    return json__items_bytes(object) + (json__frozen_index(object)[0] + 2)*sizeof(size_t);
+}
+
+static void json__freeze_value(Json_Context *ctx, Json_Value *value)
+{
+    /* other versions may hold a shared container, it is left as it is */
+    if (value->shared || value->packed) return;
+    if (value->type == JSON_VALUE_ARRAY) {
+        for (size_t i = 0; i < aris_vec__size(value->as.array); i++) {
+            json__freeze_value(ctx, &value->as.array[i]);
+        }
+        return;
+    }
+    if (value->type != JSON_VALUE_OBJECT) return;
+
+    size_t size = aris_vec__size(value->as.object);
+    for (size_t i = 0; i < size; i++) json__freeze_value(ctx, &value->as.object[i].value);
+    if (size <= JSON__KEY_INDEX_MIN || value->indexed) return;
+
+    size_t slots = 16;
+    while (slots < 2*size) slots *= 2;
+    aris_vec_tor_header *header = (aris_vec_tor_header*)json__realloc(
+        ctx, aris_vec__header(value->as.object),
+        sizeof(*header) + aris_vec__capacity(value->as.object)*sizeof(Json_Pair),
+        sizeof(*header) + size*sizeof(Json_Pair) + (slots + 1)*sizeof(size_t));
+    header->capacity = size;
+    value->as.object = (Json_Pair*)((char*)header + sizeof(*header));
+    value->indexed = true;
+
+    size_t *index = json__frozen_index(value);
+    index[0] = slots - 1;
+    memset(index + 1, 0, slots*sizeof(*index));
+    for (size_t i = 0; i < size; i++) {
+        const Json_Value *key = &value->as.object[i].key;
+        size_t slot = json__hash_key(json_to_string(key), json_string_length(key)) & index[0];
+        while (index[1 + slot]) slot = (slot + 1) & index[0];
+        index[1 + slot] = i + 1;
+    }
+}
+
+static void json__thaw_value(Json_Context *ctx, Json_Value *value)
+{
+    if (value->shared || value->packed) return;
+    if (value->type == JSON_VALUE_ARRAY) {
+        for (size_t i = 0; i < aris_vec__size(value->as.array); i++) {
+            json__thaw_value(ctx, &value->as.array[i]);
+        }
+        return;
+    }
+    if (value->type != JSON_VALUE_OBJECT) return;
+
+    size_t size = aris_vec__size(value->as.object);
+    for (size_t i = 0; i < size; i++) json__thaw_value(ctx, &value->as.object[i].value);
+    if (!value->indexed) return;
+
+    aris_vec_tor_header *header = (aris_vec_tor_header*)json__realloc(
+        ctx, aris_vec__header(value->as.object), json__frozen_bytes(value),
+        sizeof(*header) + size*sizeof(Json_Pair));
+    value->as.object = (Json_Pair*)((char*)header + sizeof(*header));
+    value->indexed = false;
+}
+
+/* the vector of a container, as.object and as.array alike */
+static void *json__items(const Json_Value *value)
+{
+    return value->type == JSON_VALUE_OBJECT ? (void*)value->as.object : (void*)value->as.array;
+}
+
+static void json__set_items(Json_Value *value, void *items)
+{
+    if (value->type == JSON_VALUE_OBJECT) {
+        value->as.object = (Json_Pair*)items;
+    } else {
+        value->as.array = (Json_Value*)items;
+    }
+}
+
+/* header and capacity of the vector, without what json_freeze or
+   json_share put around it */
+static size_t json__items_bytes(const Json_Value *value)
+{
+    size_t item = value->type == JSON_VALUE_OBJECT ? sizeof(Json_Pair)
+                  : value->packed ? sizeof(double) : sizeof(Json_Value);
+    return sizeof(aris_vec_tor_header) + aris_vec__capacity(json__items(value))*item;
+}
+
+static void json__free_items(Json_Context *ctx, Json_Value *value)
+{
+    void *items = json__items(value);
+
+    if (!items) return;
+    if (value->indexed) {
+        json__free(ctx, aris_vec__header(items), json__frozen_bytes(value));
+    } else if (value->shared) {
+        json__free(ctx, &JSON__REFS(items), sizeof(size_t) + json__items_bytes(value));
+    } else {
+        json__free(ctx, aris_vec__header(items), json__items_bytes(value));
+    }
+    json__set_items(value, NULL);
+    value->indexed = false;
+    value->shared = false;
+    value->packed = false;
+}
+
+/* Give 'value' a vector of its own before it is changed. The last owner
+   takes the block over; the others copy it one level deep and share the
+   children, which is what keeps a version at the cost of its path. The
+   copy is held while it fills and the count only drops once it is there,
+   so running out of memory leaves 'value' shared as it was. */
+static void json__unshare(Json_Context *ctx, Json_Value *value)
+{
+    if (!value->shared) return;
+
+    void *items = json__items(value);
+    size_t *refs = &JSON__REFS(items);
+    size_t size = aris_vec__size(items);
+    aris_vec_tor_header *header;
+    Json_Value held = {.type = value->type};
+
+    if (*refs == 1) {
+        header = (aris_vec_tor_header*)json__malloc(ctx, json__items_bytes(value));
+        memcpy(header, aris_vec__header(items), json__items_bytes(value));
+        json__free(ctx, refs, sizeof(*refs) + json__items_bytes(value));
+    } else if (value->type == JSON_VALUE_OBJECT) {
+        const Json_Pair *pairs = (const Json_Pair*)items;
+        Json_Pair *copy;
+
+        json__hold_room(ctx);
+        header = (aris_vec_tor_header*)json__malloc(ctx, sizeof(*header) + size*sizeof(*copy));
+        header->size = 0;
+        header->capacity = size;
+        copy = (Json_Pair*)((char*)header + sizeof(*header));
+        json__set_items(&held, copy);
+        json__hold(ctx, &held);
+        for (size_t i = 0; i < size; i++) {
+            copy[i].key = json__clone_value(ctx, &pairs[i].key);
+            copy[i].value = json_new_null();
+            header->size++;
+            copy[i].value = json__share(ctx, (Json_Value*)&pairs[i].value);
+        }
+        json__release(ctx);
+        (*refs)--;
+    } else if (value->packed) {
+        header = (aris_vec_tor_header*)json__malloc(ctx, sizeof(*header) + size*sizeof(double));
+        header->size = header->capacity = size;
+        memcpy((char*)header + sizeof(*header), items, size*sizeof(double));
+        (*refs)--;
+    } else {
+        const Json_Value *values = (const Json_Value*)items;
+        Json_Value *copy;
+
+        json__hold_room(ctx);
+        header = (aris_vec_tor_header*)json__malloc(ctx, sizeof(*header) + size*sizeof(*copy));
+        header->size = 0;
+        header->capacity = size;
+        copy = (Json_Value*)((char*)header + sizeof(*header));
+        json__set_items(&held, copy);
+        json__hold(ctx, &held);
+        for (size_t i = 0; i < size; i++) {
+            Json_Value element = json__share(ctx, (Json_Value*)&values[i]);
+            copy[i] = element;
+            header->size++;
+        }
+        json__release(ctx);
+        (*refs)--;
+    }
+    json__set_items(value, (char*)header + sizeof(*header));
+    value->shared = false;
+}
+
+/* turn a packed array back into an array of values, before it is changed */
+static void json__unpack(Json_Context *ctx, Json_Value *array)
+{
+    if (array->type != JSON_VALUE_ARRAY || !array->packed) return;
+
+    double *numbers = array->as.numbers;
+    size_t size = aris_vec__size(numbers);
+    Json_Value *values = NULL;
+
+    aris_vec__reserve(ctx, values, size);
+    for (size_t i = 0; i < size; i++) aris_vec__push(ctx, values, json_new_number(numbers[i]));
+    aris_vec__free(ctx, numbers);
+    array->as.array = values;
+    array->packed = false;
+}
+
+/* element 'idx' of an array or NULL, the number of a packed one is
+   copied into 'tmp' */
+static const Json_Value *json__element(const Json_Value *array, size_t idx, Json_Value *tmp)
+{
+    if (idx >= aris_vec__size(array->as.array)) return NULL;
+    if (!array->packed) return &array->as.array[idx];
+    *tmp = json_new_number(array->as.numbers[idx]);
+    return tmp;
+}
+
+/* add a copy of 'value' to the current scope, without the duplicate key
+   check of the builder since it comes from a valid tree */
+static void json__append_value(Json_Context *ctx, const Json_Value *value)
+{
+    Json_Value key, copy;
+
+    json__element_room(ctx, json__get_current_scope(ctx));
+    key = json__held_key(ctx);
+    copy = json__clone_value(ctx, value);
+    json__release(ctx);
+    json__append_element(ctx, key, copy);
+}
+
+/* append "/token" to the NUL-terminated pointer in 'path', escaped as
+   RFC 6901 requires, and return the previous length to restore it */
+static size_t json__path_push(Json_Context *ctx, char **path, const char *token, size_t n)
+{
+    size_t len = aris_vec__size(*path) - 1;
+
+    (void)aris_vec__pop(*path);
+    aris_vec__push(ctx, *path, '/');
+    for (const char *c = token; c < token + n; c++) {
+        if (*c == '~') {
+            aris_vec__push(ctx, *path, '~');
+            aris_vec__push(ctx, *path, '0');
+        } else if (*c == '/') {
+            aris_vec__push(ctx, *path, '~');
+            aris_vec__push(ctx, *path, '1');
+        } else {
+            aris_vec__push(ctx, *path, *c);
+        }
+    }
+    aris_vec__push(ctx, *path, '\0');
+
+    return len;
+}
+
+static void json__path_pop(char **path, size_t len)
+{
+    aris_vec__header(*path)->size = len + 1;
+    (*path)[len] = '\0';
+}
+
+static void json__diff_root(Json_Context *ctx, char **path, const Json_Value *from, const Json_Value *to)
+{
+    aris_vec__push(ctx, *path, '\0');
+    json__diff_value(ctx, path, from, to);
+}
+
+static void json__diff_op(Json_Context *ctx, const char *op, const char *path, const Json_Value *value)
+{
+    json_object_begin_n(ctx, value ? 3 : 2);
+        json_key(ctx, "op");
+        json_string(ctx, op);
+        json_key(ctx, "path");
+        json_string(ctx, path);
+        if (value) {
+            json_key(ctx, "value");
+            json__append_value(ctx, value);
+        }
+    json_object_end(ctx);
+}
+
+static void json__diff_value(Json_Context *ctx, char **path, const Json_Value *from, const Json_Value *to)
+{
+    char index[32];
+    size_t len;
+
+    if (from->type != to->type) {
+        json__diff_op(ctx, "replace", *path, to);
+        return;
+    }
+    if ((json_is_object(from) || json_is_array(from)) && json__items(from) == json__items(to)) return;
+
+    switch (from->type) {
+    case JSON_VALUE_OBJECT: {
+        size_t from_size = aris_vec__size(from->as.object);
+        Json__Key_Index keys;
+        bool *matched = (bool*)json__hold_block(ctx, from_size + 1);
+
+        memset(matched, 0, from_size + 1);
+        json__key_index_init(ctx, &keys, from->as.object, from_size, 0);
+        for (size_t i = 0; i < aris_vec__size(to->as.object); i++) {
+            Json_Pair *pair = &to->as.object[i];
+            size_t j = json__key_index_find(&keys, from->as.object, &pair->key);
+            len = json__path_push(ctx, path, json_to_string(&pair->key), json_string_length(&pair->key));
+            if (j == JSON__NOT_FOUND) {
+                json__diff_op(ctx, "add", *path, &pair->value);
+            } else {
+                matched[j] = true;
+                json__diff_value(ctx, path, &from->as.object[j].value, &pair->value);
+            }
+            json__path_pop(path, len);
+        }
+        for (size_t i = 0; i < from_size; i++) {
+            if (matched[i]) continue;
+            len = json__path_push(ctx, path, json_to_string(&from->as.object[i].key),
+                                  json_string_length(&from->as.object[i].key));
+            json__diff_op(ctx, "remove", *path, NULL);
+            json__path_pop(path, len);
+        }
+        json__key_index_fini(ctx, &keys);
+        json__release_block(ctx, matched, from_size + 1);
+    } break;
+
+    case JSON_VALUE_ARRAY: {
+        size_t from_size = aris_vec__size(from->as.array);
+        size_t to_size = aris_vec__size(to->as.array);
+        size_t common = from_size < to_size ? from_size : to_size;
+
+        for (size_t i = 0; i < common; i++) {
+            snprintf(index, sizeof(index), "%zu", i);
+            len = json__path_push(ctx, path, index, strlen(index));
+            Json_Value tmp_from, tmp_to;
+            json__diff_value(ctx, path, json__element(from, i, &tmp_from), json__element(to, i, &tmp_to));
+            json__path_pop(path, len);
+        }
+        for (size_t i = common; i < to_size; i++) {
+            snprintf(index, sizeof(index), "%zu", i);
+            len = json__path_push(ctx, path, index, strlen(index));
+            Json_Value tmp;
+            json__diff_op(ctx, "add", *path, json__element(to, i, &tmp));
+            json__path_pop(path, len);
+        }
+        /* remove from the end so the earlier indices stay valid */
+        for (size_t i = from_size; i-- > common;) {
+            snprintf(index, sizeof(index), "%zu", i);
+            len = json__path_push(ctx, path, index, strlen(index));
+            json__diff_op(ctx, "remove", *path, NULL);
+            json__path_pop(path, len);
+        }
+    } break;
+
+    default:
+        if (!json__equal(ctx, from, to)) json__diff_op(ctx, "replace", *path, to);
+        break;
+    }
+}
+
+/* Read the next reference token of '*pointer' into 'token' (unescaped),
+   return false if the pointer is malformed or the token too long. */
+static bool json__pointer_token(const char **pointer, char *token, size_t size)
+{
+    const char *c = *pointer;
+    size_t len = 0;
+
+    if (*c != '/') return false;
+    for (c++; *c && *c != '/'; c++) {
+        char ch = *c;
+        if (ch == '~') {
+            if (c[1] == '0') {
+                ch = '~';
+            } else if (c[1] == '1') {
+                ch = '/';
+            } else {
+                return false;
+            }
+            c++;
+        }
+        if (len + 1 >= size) return false;
+        token[len++] = ch;
+    }
+    token[len] = '\0';
+    *pointer = c;
+
+    return true;
+}
+
+/* array index as RFC 6901 spells it: no sign and no leading zero */
+static bool json__pointer_index(const char *token, size_t *index)
+{
+    if (!*token || (token[0] == '0' && token[1])) return false;
+
+    *index = 0;
+    for (const char *c = token; *c; c++) {
+        if (*c < '0' || *c > '9') return false;
+        *index = *index*10 + (size_t)(*c - '0');
+    }
+
+    return true;
+}
+
+/* find the container that holds the target of 'pointer' and its last token */
+/* with a context, every container on the way is unshared to be changed
+   and the last one unpacked */
+static Json_Value *json__pointer_parent(Json_Context *ctx, Json_Value *doc, const char *pointer,
+                                       char *token, size_t size)
+{
+    Json_Value *parent = NULL, *current = doc;
+
+    while (*pointer) {
+        if (!current || !json__pointer_token(&pointer, token, size)) return NULL;
+        if (ctx && (json_is_object(current) || json_is_array(current))) json__unshare(ctx, current);
+        parent = current;
+        if (!*pointer) {
+            /* only the container that is changed needs its values */
+            if (ctx) json__unpack(ctx, current);
+            break;
+        }
+
+        if (json_is_object(current)) {
+            current = (Json_Value*)json__object_find(NULL, current, token, strlen(token));
+        } else if (json_is_array(current)) {
+            size_t i;
+            /* the elements of a packed array have nothing below them */
+            if (!json__pointer_index(token, &i) || i >= aris_vec__size(current->as.array) ||
+                current->packed) {
+                return NULL;
+            }
+            current = &current->as.array[i];
+        } else {
+            return NULL;
+        }
+    }
+
+    return parent;
+}
+
+/* a number of a packed array is copied into 'tmp' */
+static const Json_Value *json__pointer_get(const Json_Value *doc, const char *pointer, Json_Value *tmp)
+{
+    char token[JSON__KEY_MAX_SIZE + 1];
+    const Json_Value *parent;
+    size_t i;
+
+    if (!*pointer) return doc;
+    parent = json__pointer_parent(NULL, (Json_Value*)doc, pointer, token, sizeof(token));
+    if (!parent) return NULL;
+
+    if (json_is_object(parent)) return json__object_find(NULL, parent, token, strlen(token));
+    if (json_is_array(parent) && json__pointer_index(token, &i)) {
+        return json__element(parent, i, tmp);
+    }
+    return NULL;
+}
+
+/* Store 'value' (owned) at 'pointer'. With 'replace' the target has to
+   exist, otherwise objects get a new member and arrays an insertion. */
+static bool json__pointer_put(Json_Context *ctx, Json_Value *doc, const char *pointer,
+                              Json_Value value, bool replace)
+{
+    char token[JSON__KEY_MAX_SIZE + 1];
+    Json_Value *parent;
+    size_t i;
+
+    if (!*pointer) {
+        json__free_value(ctx, doc);
+        *doc = value;
+        return true;
+    }
+    parent = json__pointer_parent(ctx, doc, pointer, token, sizeof(token));
+    if (!parent) return false;
+
+    if (json_is_object(parent)) {
+        if (replace && !json__object_find(NULL, parent, token, strlen(token))) return false;
+        return json_object_set(ctx, parent, token, value) != NULL;
+    }
+
+    if (json_is_array(parent)) {
+        if (!replace && strcmp(token, "-") == 0) {
+            i = aris_vec__size(parent->as.array);
+        } else if (!json__pointer_index(token, &i)) {
+            return false;
+        }
+        if (replace) return json_array_set(ctx, parent, i, value) != NULL;
+        return json_array_insert(ctx, parent, i, value) != NULL;
+    }
+
+    return false;
+}
+
+/* detach the value at 'pointer' into 'out' without copying it */
+static bool json__pointer_take(Json_Context *ctx, Json_Value *doc, const char *pointer, Json_Value *out)
+{
+    char token[JSON__KEY_MAX_SIZE + 1];
+    Json_Value *parent;
+    size_t i;
+
+    if (!*pointer) return false; /* the document itself cannot be removed */
+    parent = json__pointer_parent(ctx, doc, pointer, token, sizeof(token));
+    if (!parent) return false;
+
+    if (json_is_object(parent)) return json_object_take(ctx, parent, token, out);
+    if (json_is_array(parent) && json__pointer_index(token, &i)) {
+        return json_array_take(ctx, parent, i, out);
+    }
+
+    return false;
+}
+
+static bool json__same_allocator(const Json_Allocator *a, const Json_Allocator *b)
+{
+    return a->alloc == b->alloc && a->realloc == b->realloc &&
+           a->free == b->free && a->user == b->user;
+}
+
+static int json__lex(Json__Lexer *lx)
+{
+    const char *c = lx->cur;
+
+    while (c < lx->end && (*c == ' ' || *c == '\n' || *c == '\r' || *c == '\t')) c++;
+    if (lx->lenient && c + 1 < lx->end && *c == '/') {
+        c = json__lex_comments(lx, c);
+        if (!c) return JSON__TOKEN_ERROR;
+    }
+    lx->start = c;
+    if (c == lx->end) {
+        lx->cur = c;
+        return lx->token = JSON__TOKEN_END;
+    }
+
+    switch (*c) {
+    case '{': case '}': case '[': case ']': case ':': case ',':
+        lx->cur = c + 1;
+        return lx->token = *c;
+
+    case '\'':
+        if (!lx->lenient) break;
+        /* fallthrough */
+    case '"':
+        c = json__lex_string(lx, c);
+        if (!c) return JSON__TOKEN_ERROR;
+        lx->cur = c;
+        return lx->token = JSON__TOKEN_STRING;
+
+    case 't':
+        if (lx->end - c >= 4 && memcmp(c, "true", 4) == 0 &&
+            (lx->end - c == 4 || !JSON__IS_IDENT(c[4]))) {
+            lx->cur = c + 4;
+            return lx->token = JSON__TOKEN_TRUE;
+        }
+        return json__lex_ident(lx, c);
+
+    case 'f':
+        if (lx->end - c >= 5 && memcmp(c, "false", 5) == 0 &&
+            (lx->end - c == 5 || !JSON__IS_IDENT(c[5]))) {
+            lx->cur = c + 5;
+            return lx->token = JSON__TOKEN_FALSE;
+        }
+        return json__lex_ident(lx, c);
+
+    case 'n':
+        if (lx->end - c >= 4 && memcmp(c, "null", 4) == 0 &&
+            (lx->end - c == 4 || !JSON__IS_IDENT(c[4]))) {
+            lx->cur = c + 4;
+            return lx->token = JSON__TOKEN_NULL;
+        }
+        return json__lex_ident(lx, c);
+
+    case '+': case '.':
+        if (!lx->lenient) break;
+        /* fallthrough */
+    case '-': case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        c = json__lex_number(lx, c);
+        if (!c) return JSON__TOKEN_ERROR;
+        lx->cur = c;
+        return lx->token = JSON__TOKEN_NUMBER;
+
+    default:
+        if (JSON__IS_IDENT(*c) && !JSON__IS_DIGIT(*c)) return json__lex_ident(lx, c);
+        break;
+    }
+
+    return json__lex_fail(lx, JSON_PARSE_INVALID_CHARACTER, c);
+}
+
+/* lenient only: skip comments and the whitespace after them */
+static const char *json__lex_comments(Json__Lexer *lx, const char *c)
+{
+    while (c + 1 < lx->end && *c == '/') {
+        if (c[1] == '/') {
+            c = (const char*)memchr(c, '\n', lx->end - c);
+            if (!c) return lx->end;
+        } else if (c[1] == '*') {
+            const char *start = c;
+            for (c += 2; c + 1 < lx->end && !(c[0] == '*' && c[1] == '/'); c++) {}
+            if (c + 1 >= lx->end) {
+                json__lex_fail(lx, JSON_PARSE_UNTERMINATED_COMMENT, start);
+                return NULL;
+            }
+            c += 2;
+        } else {
+            break;
+        }
+        while (c < lx->end && (*c == ' ' || *c == '\n' || *c == '\r' || *c == '\t')) c++;
+    }
+
+    return c;
+}
+
+/* A bare word that is not a literal. Only the lenient mode accepts them,
+   as member names or as Infinity and NaN. */
+static int json__lex_ident(Json__Lexer *lx, const char *c)
+{
+    const char *start = c;
+
+    if (!lx->lenient) {
+        return json__lex_fail(lx, *c == 't' || *c == 'f' || *c == 'n'
+                                  ? JSON_PARSE_INVALID_LITERAL : JSON_PARSE_INVALID_CHARACTER, c);
+    }
+
+    while (c < lx->end && JSON__IS_IDENT(*c)) c++;
+    lx->cur = c;
+    if ((c - start == 8 && memcmp(start, "Infinity", 8) == 0) ||
+        (c - start == 3 && memcmp(start, "NaN", 3) == 0)) {
+        return lx->token = JSON__TOKEN_NUMBER;
+    }
+    return lx->token = JSON__TOKEN_IDENT;
+}
+
+/* 'c' is at the opening quote, return the position after the closing one */
+static const char *json__lex_string(Json__Lexer *lx, const char *c)
+{
+    const char *end = lx->end;
+    const char delimiter = *c;
+
+    lx->escaped = false;
+    for (c++;;) {
+        /* eight plain ASCII bytes at a time */
+        while (end - c >= 8) {
+            uint64_t v, quote, slash;
+            memcpy(&v, c, 8);
+            quote = v ^ JSON__ONES*(unsigned char)delimiter;
+            slash = v ^ JSON__ONES*'\\';
+            /* any control byte, quote, backslash or non-ASCII byte */
+            if ((((v - JSON__ONES*0x20) & ~v) | ((quote - JSON__ONES) & ~quote) |
+                 ((slash - JSON__ONES) & ~slash) | v) & JSON__HIGHS) break;
+            c += 8;
+        }
+        if (c == end) return json__lex_error(lx, JSON_PARSE_UNTERMINATED_STRING, lx->start);
+
+        unsigned char ch = (unsigned char)*c;
+        if (ch == (unsigned char)delimiter) return c + 1;
+        if (ch < 0x20) return json__lex_error(lx, JSON_PARSE_CONTROL_CHARACTER, c);
+
+        if (ch == '\\') {
+            lx->escaped = true;
+            if (end - c < 2) return json__lex_error(lx, JSON_PARSE_UNTERMINATED_STRING, lx->start);
+            switch (c[1]) {
+            case '\'':
+                if (!lx->lenient) return json__lex_error(lx, JSON_PARSE_INVALID_ESCAPE, c);
+                /* fallthrough */
+            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                c += 2;
+                break;
+            case 'u': {
+                long cp = json__hex4(c + 2, end);
+                if (cp < 0) return json__lex_error(lx, JSON_PARSE_INVALID_ESCAPE, c);
+                c += 6;
+                /* strict: a surrogate only as the first half of a pair */
+                if (!lx->lenient && cp >= 0xD800 && cp <= 0xDFFF) {
+                    long low = end - c >= 6 && c[0] == '\\' && c[1] == 'u' ? json__hex4(c + 2, end) : -1;
+                    if (cp > 0xDBFF || low < 0xDC00 || low > 0xDFFF) {
+                        return json__lex_error(lx, JSON_PARSE_INVALID_ESCAPE, c - 6);
+                    }
+                    c += 6;
+                }
+            } break;
+            default:
+                return json__lex_error(lx, JSON_PARSE_INVALID_ESCAPE, c);
+            }
+        } else if (ch < 0x80) {
+            c++;
+        } else {
+            /* one UTF-8 sequence, without overlongs and surrogates */
+            size_t n;
+            unsigned char lo = 0x80, hi = 0xBF;
+            if (ch >= 0xC2 && ch <= 0xDF) {
+                n = 1;
+            } else if (ch >= 0xE0 && ch <= 0xEF) {
+                n = 2;
+                if (ch == 0xE0) lo = 0xA0;
+                if (ch == 0xED) hi = 0x9F;
+            } else if (ch >= 0xF0 && ch <= 0xF4) {
+                n = 3;
+                if (ch == 0xF0) lo = 0x90;
+                if (ch == 0xF4) hi = 0x8F;
+            } else {
+                return json__lex_error(lx, JSON_PARSE_INVALID_UTF8, c);
+            }
+            if ((size_t)(end - c) <= n) return json__lex_error(lx, JSON_PARSE_INVALID_UTF8, c);
+            if ((unsigned char)c[1] < lo || (unsigned char)c[1] > hi) {
+                return json__lex_error(lx, JSON_PARSE_INVALID_UTF8, c);
+            }
+            for (size_t k = 2; k <= n; k++) {
+                if (((unsigned char)c[k] & 0xC0) != 0x80) {
+                    return json__lex_error(lx, JSON_PARSE_INVALID_UTF8, c);
+                }
+            }
+            c += n + 1;
+        }
+    }
+}
+
+/* the value of the four hex digits at 'c', or -1 */
+static long json__hex4(const char *c, const char *end)
+{
+    long value = 0;
+
+    if (end - c < 4) return -1;
+    for (int k = 0; k < 4; k++) {
+        unsigned char ch = (unsigned char)c[k];
+        if (!isxdigit(ch)) return -1;
+        value = value*16 + (isdigit(ch) ? ch - '0' : tolower(ch) - 'a' + 10);
+    }
+    return value;
+}
+
+/* the unescaped size of the current string token, as json__unescape
+   gives it, without writing it out */
+static size_t json__string_size(const Json__Lexer *lx)
+{
+    const char *c = lx->start + 1, *end = lx->cur - 1;
+    size_t n = (size_t)(end - c);
+
+    if (!lx->escaped) return n;
+    for (; c < end; c++) {
+        if (*c != '\\') continue;
+        if (c[1] != 'u') {
+            n -= 1;
+            c++;
+            continue;
+        }
+        long cp = json__hex4(c + 2, end), low = -1;
+        if (cp >= 0xD800 && cp <= 0xDBFF && end - c >= 12 && c[6] == '\\' && c[7] == 'u') {
+            low = json__hex4(c + 8, end);
+        }
+        if (low >= 0xDC00 && low <= 0xDFFF) {
+            n -= 12 - 4;
+            c += 11;
+        } else {
+            n -= 6 - (cp < 0x80 ? 1 : cp < 0x800 ? 2 : 3);
+            c += 5;
+        }
+    }
+    return n;
+}
+
+/* -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?, the lenient mode also
+   takes a '+' sign, hexadecimal integers, Infinity, NaN, and a decimal
+   point without digits on one side */
+static const char *json__lex_number(Json__Lexer *lx, const char *c)
+{
+    const char *end = lx->end;
+    bool digits = false;
+
+    if (*c == '-' || *c == '+') c++;
+    if (lx->lenient && c < end && !JSON__IS_DIGIT(*c) && *c != '.') {
+        if (end - c >= 8 && memcmp(c, "Infinity", 8) == 0) return c + 8;
+        if (end - c >= 3 && memcmp(c, "NaN", 3) == 0) return c + 3;
+    }
+    if (lx->lenient && end - c > 2 && c[0] == '0' && (c[1] == 'x' || c[1] == 'X')) {
+        const char *hex = c + 2;
+        for (c = hex; c < end && isxdigit((unsigned char)*c); c++) {}
+        if (c == hex) return json__lex_error(lx, JSON_PARSE_INVALID_NUMBER, c);
+        return c;
+    }
+
+    if (c < end && *c == '0') {
+        c++;
+        digits = true;
+    } else if (c < end && JSON__IS_DIGIT(*c)) {
+        while (c < end && JSON__IS_DIGIT(*c)) c++;
+        digits = true;
+    } else if (!lx->lenient || c == end || *c != '.') {
+        return json__lex_error(lx, JSON_PARSE_INVALID_NUMBER, c);
+    }
+
+    if (c < end && *c == '.') {
+        c++;
+        if ((c == end || !JSON__IS_DIGIT(*c)) && (!lx->lenient || !digits)) {
+            return json__lex_error(lx, JSON_PARSE_INVALID_NUMBER, c);
+        }
+        while (c < end && JSON__IS_DIGIT(*c)) c++;
+    }
+
+    if (c < end && (*c == 'e' || *c == 'E')) {
+        c++;
+        if (c < end && (*c == '+' || *c == '-')) c++;
+        if (c == end || !JSON__IS_DIGIT(*c)) return json__lex_error(lx, JSON_PARSE_INVALID_NUMBER, c);
+        while (c < end && JSON__IS_DIGIT(*c)) c++;
+    }
+
+    return c;
+}
+
+static int json__lex_fail(Json__Lexer *lx, Json_Parse_Error_Code code, const char *at)
+{
+    lx->code = code;
+    lx->error_at = at;
+    return lx->token = JSON__TOKEN_ERROR;
+}
+
+/* json__lex_fail for the scanners, which return the end of the token */
+static const char *json__lex_error(Json__Lexer *lx, Json_Parse_Error_Code code, const char *at)
+{
+    json__lex_fail(lx, code, at);
+    return NULL;
+}
+
+static const char *json__token_name(int token)
+{
+    switch (token) {
+    case '{':                return "'{'";
+    case '}':                return "'}'";
+    case '[':                return "'['";
+    case ']':                return "']'";
+    case ':':                return "':'";
+    case ',':                return "','";
+    case JSON__TOKEN_END:    return "end of input";
+    case JSON__TOKEN_STRING: return "a string";
+    case JSON__TOKEN_NUMBER: return "a number";
+    case JSON__TOKEN_TRUE:   return "'true'";
+    case JSON__TOKEN_FALSE:  return "'false'";
+    case JSON__TOKEN_NULL:   return "'null'";
+    case JSON__TOKEN_IDENT:  return "an identifier";
+    case '.':                return "'.'";
+    case '|':                return "'|'";
+    case '(':                return "'('";
+    case ')':                return "')'";
+    case JSON__TOKEN_COMPARE: return "a comparison";
+    default:                 return "an invalid token";
+    }
+}
+
+/* fill 'err' from the state of the lexer */
+static void json__parse_error(Json_Parse_Error *err, const Json__Lexer *lx,
+                              const char *expected)
+{
+    const char *at = lx->start;
+
+    err->code = lx->code;
+    if (lx->token == JSON__TOKEN_ERROR) {
+        at = lx->error_at;
+    } else if (err->code == JSON_PARSE_OK) {
+        err->code = lx->token == JSON__TOKEN_END
+                    ? JSON_PARSE_UNEXPECTED_END : JSON_PARSE_UNEXPECTED_TOKEN;
+    }
+    err->expected = expected;
+    switch (lx->token == JSON__TOKEN_ERROR ? err->code : JSON_PARSE_OK) {
+    case JSON_PARSE_INVALID_CHARACTER:    err->found = "an invalid character"; break;
+    case JSON_PARSE_INVALID_LITERAL:      err->found = "an invalid literal"; break;
+    case JSON_PARSE_INVALID_NUMBER:       err->found = "a malformed number"; break;
+    case JSON_PARSE_UNTERMINATED_STRING:  err->found = "an unterminated string"; break;
+    case JSON_PARSE_CONTROL_CHARACTER:    err->found = "a control character"; break;
+    case JSON_PARSE_INVALID_ESCAPE:       err->found = "an invalid escape"; break;
+    case JSON_PARSE_INVALID_UTF8:         err->found = "invalid UTF-8"; break;
+    case JSON_PARSE_UNTERMINATED_COMMENT: err->found = "an unterminated comment"; break;
+    default:                              err->found = json__token_name(lx->token); break;
+    }
+
+    json__error_position(err, lx->begin, at);
+}
+
+static void json__error_position(Json_Parse_Error *err, const char *begin, const char *at)
+{
+    err->offset = (size_t)(at - begin);
+    err->line = 1;
+    err->column = 1;
+    for (const char *c = begin; c < at; c++) {
+        if (*c == '\n') {
+            err->line++;
+            err->column = 1;
+        } else {
+            err->column++;
+        }
+    }
+}
+
+/* drop the scopes a failed parse or diff left open, back to 'depth' */
+static void json__parse_unwind(Json_Context *ctx, size_t depth)
+{
+    /* a scope that ran out of memory may have pushed its key but not itself */
+    if (aris_vec__size(ctx->scope_keys) > 0 && aris_vec__size(ctx->scope_keys) >= aris_vec__size(ctx->scopes)) {
+        json__free_string(ctx, &ctx->scope_keys[--aris_vec__header(ctx->scope_keys)->size]);
+    }
+    while (aris_vec__size(ctx->scopes) > depth && aris_vec__size(ctx->scopes) > 1) {
+        json__free_value(ctx, &ctx->scopes[--aris_vec__header(ctx->scopes)->size]);
+        json__free_string(ctx, &ctx->scope_keys[--aris_vec__header(ctx->scope_keys)->size]);
+    }
+
+    if (depth == 0 && ctx->root) {
+        json__free_value(ctx, ctx->root);
+        aris_vec__header(ctx->scopes)->size = 0;
+        ctx->root = NULL;
+        ctx->scope_type = JSON_SCOPE_NULL;
+    } else if (aris_vec__size(ctx->scopes) > 0) {
+        ctx->scope_type = ctx->scopes[aris_vec__size(ctx->scopes) - 1].type == JSON_VALUE_ARRAY
+                          ? JSON_SCOPE_ARRAY : JSON_SCOPE_OBJECT;
+    }
+}
+
+#ifdef JSON_ENABLE_DESERIALIZATION
+static int json__advance(Json_Context *ctx, Json__Parser *p)
+{
+    JSON__STAT_ADD(ctx, tokens, 1);
+    (void)ctx;
+    return json__lex(&p->lex);
+}
+
+/* Record why the input was rejected (the innermost failure wins) and
+   return false. JSON_PARSE_OK, or a token the lexer rejected, picks the
+   code from the current token. */
+static bool json__parse_fail(Json_Context *ctx, Json__Parser *p, Json_Parse_Error_Code code,
+                             const char *expected)
+{
+    if (ctx->parse_error.code != JSON_PARSE_OK) return false;
+    if (code != JSON_PARSE_OK && p->lex.token != JSON__TOKEN_ERROR) p->lex.code = code;
+    json__parse_error(&ctx->parse_error, &p->lex, expected);
+    JSON__STAT_ADD(ctx, parse_errors, 1);
+
+    return false;
+}
+
+/* the current token starts the document */
+static bool json__parse_document(Json_Context *ctx, Json__Parser *p, const char *input, size_t size)
+{
+    json__scan_sizes(ctx, p, input, size);
+    return json__parse_value(ctx, p) &&
+           (p->lex.token == JSON__TOKEN_END ||
+            json__parse_fail(ctx, p, JSON_PARSE_TRAILING_DATA, "end of input"));
+}
+
+/* the parser of a stream sits on the first element of the array, which
+   is the root scope of the context */
+static bool json__stream_open(Json_Context *ctx, Json_Stream *stream, const char *input, size_t size,
+                              const char *pointer)
+{
+    Json__Parser *p = (Json__Parser*)json__malloc(ctx, sizeof(*p));
+
+    memset(p, 0, sizeof(*p));
+    stream->parser = p;
+    p->lex = (Json__Lexer){
+        .begin = input, .cur = input, .end = input + size,
+        .lenient = ctx->opt.lenient,
+    };
+
+    json__advance(ctx, p);
+    if (!json__stream_seek(ctx, p, pointer)) return false;
+    if (p->lex.token != '[') return json__parse_fail(ctx, p, JSON_PARSE_OK, "an array");
+    json__advance(ctx, p);
+
+    json_array_begin(ctx);
+    p->depth = 1;
+    return true;
+}
+
+/* Move onto the value 'pointer' names, skipping the members and elements
+   before it without validating them. */
+static bool json__stream_seek(Json_Context *ctx, Json__Parser *p, const char *pointer)
+{
+    Json__Lexer *lex = &p->lex;
+    char token[JSON__KEY_MAX_SIZE + 1];
+    size_t idx;
+
+    while (*pointer) {
+        if (!json__pointer_token(&pointer, token, sizeof(token))) return false;
+
+        if (lex->token == '{') {
+            size_t len = strlen(token);
+            bool found = false;
+
+            json__advance(ctx, p);
+            while (!found && lex->token != '}') {
+                const char *key;
+                size_t n;
+
+                if (lex->token != JSON__TOKEN_STRING && !(lex->lenient && json__token_is_word(lex->token))) {
+                    return json__parse_fail(ctx, p, JSON_PARSE_OK, "a string key");
+                }
+                key = json__token_string(ctx, p, &n);
+                found = n == len && memcmp(key, token, n) == 0;
+                if (json__advance(ctx, p) != ':') return json__parse_fail(ctx, p, JSON_PARSE_OK, "':'");
+                json__advance(ctx, p);
+                if (!found && !json__stream_skip(ctx, p, '}')) return false;
+            }
+            if (!found) return json__parse_fail(ctx, p, JSON_PARSE_OK, "the member the pointer names");
+        } else if (lex->token == '[' && json__pointer_index(token, &idx)) {
+            json__advance(ctx, p);
+            for (; idx > 0 && lex->token != ']'; idx--) {
+                if (!json__stream_skip(ctx, p, ']')) return false;
+            }
+            if (lex->token == ']') return json__parse_fail(ctx, p, JSON_PARSE_OK, "the element the pointer names");
+        } else {
+            return json__parse_fail(ctx, p, JSON_PARSE_OK, "the container the pointer names");
+        }
+    }
+
+    return true;
+}
+
+/* skip the value at the current token, and the ',' after it */
+static bool json__stream_skip(Json_Context *ctx, Json__Parser *p, int close)
+{
+    Json__Lexer *lex = &p->lex;
+    const char *after;
+
+    if (lex->token == JSON__TOKEN_ERROR) return json__parse_fail(ctx, p, JSON_PARSE_OK, "a value");
+    after = json__skip_value(lex->start, lex->end);
+    if (!after || after == lex->start) return json__parse_fail(ctx, p, JSON_PARSE_OK, "a value");
+    lex->cur = after;
+
+    if (json__advance(ctx, p) == ',') {
+        json__advance(ctx, p);
+        return true;
+    }
+    if (lex->token == close) return true;
+    return json__parse_fail(ctx, p, JSON_PARSE_OK, close == '}' ? "',' or '}'" : "',' or ']'");
+}
+
+/* the next element into the root scope, and the ',' after it */
+static bool json__stream_element(Json_Context *ctx, Json__Parser *p)
+{
+    Json__Lexer *lex = &p->lex;
+
+    if (!json__parse_value(ctx, p)) return false;
+    if (lex->token == ',') {
+        json__advance(ctx, p);
+        if (lex->token == ']' && !lex->lenient) return json__parse_fail(ctx, p, JSON_PARSE_OK, "a value");
+    } else if (lex->token != ']') {
+        return json__parse_fail(ctx, p, JSON_PARSE_OK, "',' or ']'");
+    }
+
+    return true;
+}
+
+/* free the elements the root scope of a stream still holds */
+static void json__stream_drop(Json_Context *ctx)
+{
+    Json_Value *elements = ctx->root ? ctx->root->as.array : NULL;
+
+    while (aris_vec__size(elements) > 0) {
+        json__free_value(ctx, &elements[--aris_vec__header(elements)->size]);
+    }
+}
+
+/* Count the elements of every container in one pass over the input, so
+   the parser can size each vector exactly. It only has to be right for
+   valid input; anything else just makes a hint too large or too small.
+   The lenient single-quoted strings and comments are skipped too, or
+   their brackets would make containers the parser never sees and shift
+   every hint after them; strict JSON has neither outside a string.
+   Both vectors live in the parser, which frees them if memory runs out. */
+static void json__scan_sizes(Json_Context *ctx, Json__Parser *p, const char *input, size_t size)
+{
+    const char *end = input + size;
+
+    for (const char *c = input; c < end; c++) {
+        switch (*c) {
+        case ' ': case '\t': case '\n': case '\r':
+            continue;
+
+        case '{': case '[':
+            if (aris_vec__size(p->open) > 0 && p->sizes[p->open[aris_vec__size(p->open) - 1]] == 0) {
+                p->sizes[p->open[aris_vec__size(p->open) - 1]] = 1;
+            }
+            aris_vec__push(ctx, p->open, aris_vec__size(p->sizes));
+            aris_vec__push(ctx, p->sizes, 0);
+            continue;
+
+        case '}': case ']':
+            if (aris_vec__size(p->open) > 0) (void)aris_vec__pop(p->open);
+            continue;
+
+        case ',':
+            if (aris_vec__size(p->open) > 0) p->sizes[p->open[aris_vec__size(p->open) - 1]]++;
+            continue;
+
+        case '"': case '\'': {
+            const char quote = *c;
+            for (c++; c < end && *c != quote; c++) {
+                if (*c == '\\') c++;
+            }
+        } break;
+
+        case '/':
+            /* up to the last byte of the comment, which is no value */
+            if (c + 1 < end && c[1] == '/') {
+                while (c + 1 < end && c[1] != '\n') c++;
+            } else if (c + 1 < end && c[1] == '*') {
+                const char *close = c + 2;
+                while (close + 1 < end && !(close[0] == '*' && close[1] == '/')) close++;
+                c = close + 1 < end ? close + 1 : end - 1;
+            }
+            continue;
+
+        default:
+            break;
+        }
+
+        if (aris_vec__size(p->open) > 0 && p->sizes[p->open[aris_vec__size(p->open) - 1]] == 0) {
+            p->sizes[p->open[aris_vec__size(p->open) - 1]] = 1;
+        }
+    }
+
+    aris_vec__free(ctx, p->open);
+    p->open = NULL;
+}
+
+static bool json__token_is_word(int token)
+{
+    return token == JSON__TOKEN_IDENT || token == JSON__TOKEN_TRUE ||
+           token == JSON__TOKEN_FALSE || token == JSON__TOKEN_NULL;
+}
+
+static size_t json__next_size(Json__Parser *p)
+{
+    return p->next < aris_vec__size(p->sizes) ? p->sizes[p->next++] : 0;
+}
+
+/* the text of the current string or identifier token, unescaped if needed */
+static const char *json__token_string(Json_Context *ctx, Json__Parser *p, size_t *n)
+{
+    Json__Lexer *lex = &p->lex;
+    const char *raw = lex->start;
+    size_t size = (size_t)(lex->cur - lex->start);
+
+    if (lex->token == JSON__TOKEN_STRING) {
+        raw++;
+        size -= 2;
+    }
+    if (!(lex->token == JSON__TOKEN_STRING && lex->escaped)) {
+        *n = size;
+        return raw;
+    }
+
+    /* most escaped strings are short keys, they fit in the key buffer */
+    char *out = p->key;
+    if (size >= sizeof(p->key)) {
+        aris_vec__reserve(ctx, p->scratch, size + 1);
+        out = p->scratch;
+    }
+    *n = json__unescape(out, raw, size);
+
+    return out;
+}
+
+static double json__token_number(Json_Context *ctx, Json__Parser *p)
+{
+    const char *c = p->lex.start;
+    size_t size = (size_t)(p->lex.cur - c);
+    char buffer[64];
+    bool negative = *c == '-';
+
+    /* short integers are exact in a double */
+    if (size - negative <= 15) {
+        double value = 0;
+        size_t i;
+        for (i = negative; i < size && JSON__IS_DIGIT(c[i]); i++) value = value*10 + (c[i] - '0');
+        if (i == size && size > (size_t)negative) return negative ? -value : value;
+    }
+
+    if (size < sizeof(buffer)) {
+        memcpy(buffer, c, size);
+        buffer[size] = '\0';
+        return strtod(buffer, NULL);
+    }
+
+    char *copy = (char*)json__malloc(ctx, size + 1);
+    memcpy(copy, c, size);
+    copy[size] = '\0';
+    double value = strtod(copy, NULL);
+    json__free(ctx, copy, size + 1);
+
+    return value;
+}
+
+/* the current token starts the value, the one after it is current when done */
+static bool json__parse_value(Json_Context *ctx, Json__Parser *p)
+{
+    Json__Lexer *lex = &p->lex;
+    const char *s;
+    size_t n;
+
+    switch (lex->token) {
+    case '{':
+        return json__parse_object(ctx, p);
+
+    case '[':
+        return json__parse_array(ctx, p);
+
+    case JSON__TOKEN_STRING:
+        s = json__token_string(ctx, p, &n);
+        json_string_n(ctx, s, n);
+        break;
+
+    case JSON__TOKEN_NUMBER:
+        json_number(ctx, json__token_number(ctx, p));
+        break;
+
+    case JSON__TOKEN_TRUE:
+        json_boolean(ctx, true);
+        break;
+
+    case JSON__TOKEN_FALSE:
+        json_boolean(ctx, false);
+        break;
+
+    case JSON__TOKEN_NULL:
+        json_null(ctx);
+        break;
+
+    default:
+        return json__parse_fail(ctx, p, JSON_PARSE_OK, "a value");
+    }
+
+    json__advance(ctx, p);
+    return true;
+}
+
+static bool json__parse_array(Json_Context *ctx, Json__Parser *p)
+{
+    Json__Lexer *lex = &p->lex;
+
+    size_t size;
+
+    if (p->depth == JSON__MAX_DEPTH) {
+        return json__parse_fail(ctx, p, JSON_PARSE_TOO_DEEP, "fewer nested scopes");
+    }
+    size = json__next_size(p);
+    p->depth++;
+
+    json__advance(ctx, p);
+    if (ctx->opt.pack_numbers && lex->token == JSON__TOKEN_NUMBER) {
+        json_array_begin(ctx);
+        if (!json__parse_numbers(ctx, p, size)) return false;
+    } else {
+        json_array_begin_n(ctx, size);
+    }
+    while (lex->token != ']') {
+        if (!json__parse_value(ctx, p)) return false;
+
+        if (lex->token == ',') {
+            json__advance(ctx, p);
+            /* only the lenient mode allows a trailing comma */
+            if (lex->token == ']' && !lex->lenient) {
+                return json__parse_fail(ctx, p, JSON_PARSE_OK, "a value");
+            }
+        } else if (lex->token != ']') {
+            return json__parse_fail(ctx, p, JSON_PARSE_OK, "',' or ']'");
+        }
+    }
+    json__advance(ctx, p);
+
+    p->depth--;
+    json_array_end(ctx);
+
+    return true;
+}
+
+/* Read the numbers an array starts with into the parser's buffer. If
+   the array ends there it becomes packed, with a vector of exactly that
+   many doubles; otherwise they are appended as values and
+   json__parse_array goes on from the first other element. */
+static bool json__parse_numbers(Json_Context *ctx, Json__Parser *p, size_t size)
+{
+    Json__Lexer *lex = &p->lex;
+    Json_Value *scope;
+    size_t count;
+
+    aris_vec__reset(p->numbers);
+    aris_vec__reserve(ctx, p->numbers, size);
+    while (lex->token == JSON__TOKEN_NUMBER) {
+        double number = json__token_number(ctx, p);
+        aris_vec__push(ctx, p->numbers, number);
+        json__advance(ctx, p);
+        if (lex->token == ',') {
+            json__advance(ctx, p);
+            if (lex->token == ']' && !lex->lenient) {
+                return json__parse_fail(ctx, p, JSON_PARSE_OK, "a value");
+            }
+        } else if (lex->token != ']') {
+            return json__parse_fail(ctx, p, JSON_PARSE_OK, "',' or ']'");
+        }
+    }
+
+    scope = json__get_current_scope(ctx);
+    count = aris_vec__size(p->numbers);
+    if (lex->token == ']') {
+        JSON__STAT_ADD(ctx, values[JSON_VALUE_NUMBER], count);
+        aris_vec__reserve(ctx, scope->as.numbers, count);
+        memcpy(scope->as.numbers, p->numbers, count*sizeof(*p->numbers));
+        aris_vec__header(scope->as.numbers)->size = count;
+        scope->packed = true;
+        return true;
+    }
+
+    aris_vec__reserve(ctx, scope->as.array, size);
+    for (size_t i = 0; i < count; i++) json_number(ctx, p->numbers[i]);
+    return true;
+}
+
+static bool json__parse_object(Json_Context *ctx, Json__Parser *p)
+{
+    Json__Lexer *lex = &p->lex;
+    const char *key;
+    size_t n;
+    Json__Shape *shape = NULL;  /* of the last object at this depth */
+    size_t matched = 0;         /* keys so far, if they all followed 'shape' */
+    bool follows = true;
+
+    if (p->depth == JSON__MAX_DEPTH) {
+        return json__parse_fail(ctx, p, JSON_PARSE_TOO_DEEP, "fewer nested scopes");
+    }
+    json_object_begin_n(ctx, json__next_size(p));
+    /* the document itself has no siblings to compare */
+    if (p->depth > 0 && p->depth < JSON__SHAPE_DEPTH) shape = &p->shapes[p->depth];
+    p->depth++;
+
+    json__advance(ctx, p);
+    while (lex->token != '}') {
+        /* parse key, the lenient mode also takes a bare identifier */
+        if (lex->token != JSON__TOKEN_STRING && !(lex->lenient && json__token_is_word(lex->token))) {
+            return json__parse_fail(ctx, p, JSON_PARSE_OK, "a string key");
+        }
+        key = json__token_string(ctx, p, &n);
+        /* the keys of that object are distinct, so neither is one that
+           takes the place it had there */
+        follows = follows && shape && matched < shape->size &&
+                  json__key_equal(&shape->pairs[matched].key, key, n, shape->pairs[matched].key.hash);
+        if (follows) matched++;
+        if (!json__key(ctx, key, n, !follows)) {
+            if (ctx->code == JSON_DOUBLE_KEY) {
+                return json__parse_fail(ctx, p, JSON_PARSE_DUPLICATE_KEY, "a key not used before");
+            }
+            return json__parse_fail(ctx, p, JSON_PARSE_KEY_TOO_LONG, "a key of at most 256 bytes");
+        }
 
-    return res;
+        /* parse colon separator */
+        if (json__advance(ctx, p) != ':') return json__parse_fail(ctx, p, JSON_PARSE_OK, "':'");
+        json__advance(ctx, p);
+
+        /* parse value */
+        if (!json__parse_value(ctx, p)) return false;
+
+        if (lex->token == ',') {
+            json__advance(ctx, p);
+            if (lex->token == '}' && !lex->lenient) {
+                return json__parse_fail(ctx, p, JSON_PARSE_OK, "a string key");
+            }
+        } else if (lex->token != '}') {
+            return json__parse_fail(ctx, p, JSON_PARSE_OK, "',' or '}'");
+        }
+    }
+    json__advance(ctx, p);
+
+    p->depth--;
+    json_object_end(ctx);
+
+    /* the objects that follow at this depth are compared to this one, a
+       stream (json_stream_next) needs it to be the latest */
+    if (shape) {
+        const Json_Value *object = json__last_value(ctx);
+        shape->pairs = object->as.object;
+        shape->size = aris_vec__size(object->as.object);
+    }
+
+    return true;
 }
 
-static void json__dump_pair(Json_Context *ctx, size_t level, Json_Pair *pair, bool comma)
+/* the value that the end of a nested scope added to the current one; its
+   members stay where they are for the rest of the parse */
+static const Json_Value *json__last_value(Json_Context *ctx)
 {
-    json__dump_indent(ctx, level);
+    Json_Value *scope = json__get_current_scope(ctx);
+    size_t size = aris_vec__size(json__items(scope));
 
-    static char key[JSON__KEY_MAX_SIZE + 4] = {0};
-    snprintf(key, sizeof(key), "\"%s\": ", pair->key);
-    json__write(ctx, key);
-    json__dump_value(ctx, level, &pair->value, false);
+    return scope->type == JSON_VALUE_OBJECT ? &scope->as.object[size - 1].value : &scope->as.array[size - 1];
+}
 
-    if (comma) {
-        json__write(ctx, ",\n");
-    } else {
-        json__write(ctx, "\n");
-    }
+static const char *json__skip_ws(const char *c, const char *end)
+{
+    while (c < end && (*c == ' ' || *c == '\n' || *c == '\r' || *c == '\t')) c++;
+    return c;
 }
 
-static void json__dump_value(Json_Context *ctx, size_t level, Json_Value *value, bool indent)
+/* 'c' is at the opening quote, return the position after the closing one */
+static const char *json__skip_string(const char *c, const char *end)
 {
-    static char buffer[50];
+    for (c++; c < end;) {
+        const char *quote = (const char*)memchr(c, '"', end - c);
+        size_t slashes = 0;
+
+        if (!quote) return NULL;
+        while (quote - slashes > c && quote[-1 - (ptrdiff_t)slashes] == '\\') slashes++;
+        if (slashes % 2 == 0) return quote + 1;
+        c = quote + 1;
+    }
 
-    if (indent) json__dump_indent(ctx, level);
+    return NULL;
+}
 
-    switch (value->type) {
-    case JSON_VALUE_OBJECT:
-        json__write(ctx, "{\n");
-        for (size_t i = 0; i < aris_vec__size(value->as.object); i++) {
-            Json_Pair *pair = &value->as.object[i];
-            bool comma = true;
-            if (i == aris_vec__size(value->as.object) - 1) comma = false;
-            json__dump_pair(ctx, level+1, pair, comma);
+/* Skip one value by matching brackets and quotes only, the skipped bytes
+   are not validated. Return NULL if the input ends first. */
+static const char *json__skip_value(const char *c, const char *end)
+{
+    size_t depth = 0;
+
+    if (c >= end) return NULL;
+    if (*c != '{' && *c != '[') {
+        if (*c == '"') return json__skip_string(c, end);
+        while (c < end && *c != ',' && *c != ']' && *c != '}' &&
+               *c != ' ' && *c != '\n' && *c != '\r' && *c != '\t') c++;
+        return c;
+    }
+
+    while (c < end) {
+        switch (*c) {
+        case '"':
+            c = json__skip_string(c, end);
+            if (!c) return NULL;
+            continue;
+
+        case '{':
+        case '[':
+            depth++;
+            break;
+
+        case '}':
+        case ']':
+            if (--depth == 0) return c + 1;
+            break;
+
+        default:
+            break;
         }
-        json__dump_indent(ctx, level);
-        json__write(ctx, "}");
-        break;
+        c++;
+    }
 
-    case JSON_VALUE_ARRAY:
-        json__write(ctx, "[\n");
-        for (size_t i = 0; i < aris_vec__size(value->as.array); i++) {
-            json__dump_value(ctx, level+1, &value->as.array[i], true);
-            if (i == aris_vec__size(value->as.array) - 1) {
-                json__write(ctx, "\n");
+    return NULL;
+}
+
+/* Decode the escapes of a string body into 'dst' (at least 'n' bytes),
+   return the decoded size or JSON__NOT_FOUND for an invalid escape. */
+static size_t json__unescape(char *dst, const char *src, size_t n)
+{
+    const char *end = src + n;
+    char *out = dst;
+
+    while (src < end) {
+        if (*src != '\\') {
+            *out++ = *src++;
+            continue;
+        }
+        if (++src == end) return JSON__NOT_FOUND;
+
+        switch (*src++) {
+        case '"':  *out++ = '"';  break;
+        case '\'': *out++ = '\''; break;  /* lenient strings only */
+        case '\\': *out++ = '\\'; break;
+        case '/':  *out++ = '/';  break;
+        case 'b':  *out++ = '\b'; break;
+        case 'f':  *out++ = '\f'; break;
+        case 'n':  *out++ = '\n'; break;
+        case 'r':  *out++ = '\r'; break;
+        case 't':  *out++ = '\t'; break;
+        case 'u': {
+            long cp = json__hex4(src, end);
+            if (cp < 0) return JSON__NOT_FOUND;
+            src += 4;
+            /* a surrogate pair makes one code point, a lone surrogate has
+               no UTF-8 form and becomes U+FFFD */
+            if (cp >= 0xD800 && cp <= 0xDBFF && end - src >= 6 && src[0] == '\\' && src[1] == 'u') {
+                long low = json__hex4(src + 2, end);
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    src += 6;
+                }
+            }
+            if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;
+            if (cp < 0x80) {
+                *out++ = (char)cp;
+            } else if (cp < 0x800) {
+                *out++ = (char)(0xC0 | (cp >> 6));
+                *out++ = (char)(0x80 | (cp & 0x3F));
+            } else if (cp < 0x10000) {
+                *out++ = (char)(0xE0 | (cp >> 12));
+                *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+                *out++ = (char)(0x80 | (cp & 0x3F));
             } else {
-                json__write(ctx, ",\n");
+                *out++ = (char)(0xF0 | (cp >> 18));
+                *out++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+                *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+                *out++ = (char)(0x80 | (cp & 0x3F));
             }
+        } break;
+
+        default:
+            return JSON__NOT_FOUND;
         }
-        json__dump_indent(ctx, level);
-        json__write(ctx, "]");
-        break;
+    }
 
-    case JSON_VALUE_STRING:
-        json__write(ctx, "\"");
-        json__write(ctx, value->as.string);
-        json__write(ctx, "\"");
-        break;
+    return (size_t)(out - dst);
+}
 
-    case JSON_VALUE_NUMBER:
-        snprintf(buffer, sizeof(buffer), "%.15g", value->as.number);
-        json__write(ctx, buffer);
-        break;
+/* split an RFC 6901 pointer into unescaped tokens */
+static bool json__extract_compile(Json_Context *ctx, Json__Extractor *e, size_t i, const char *pointer)
+{
+    char token[JSON__KEY_MAX_SIZE + 1];
+    Json__Extract_Path *path = &e->paths[i];
+
+    path->token = aris_vec__size(e->tokens);
+    path->count = 0;
+    path->found = false;
+    if (!pointer) return false;
+
+    while (*pointer) {
+        Json__Extract_Token t = {.offset = aris_vec__size(e->names)};
+
+        if (!json__pointer_token(&pointer, token, sizeof(token))) return false;
+        t.size = strlen(token);
+        if (!json__pointer_index(token, &t.index)) t.index = JSON__NOT_FOUND;
+        for (size_t k = 0; k <= t.size; k++) aris_vec__push(ctx, e->names, token[k]);
+        aris_vec__push(ctx, e->tokens, t);
+        path->count++;
+    }
 
-    case JSON_VALUE_BOOLEAN:
-        if (value->as.boolean) {
-            json__write(ctx, "true");
-        } else {
-            json__write(ctx, "false");
-        }
-        break;
+    return true;
+}
 
-    case JSON_VALUE_NULL:
-        json__write(ctx, "null");
-        break;
+static bool json__extract_key_match(Json_Context *ctx, Json__Extractor *e, const Json__Extract_Token *token,
+                                    const char *key, size_t size)
+{
+    const char *name = e->names + token->offset;
 
-    default:
-        break;
+    if (!memchr(key, '\\', size)) {
+        return size == token->size && memcmp(key, name, size) == 0;
     }
+
+    aris_vec__reserve(ctx, e->scratch, size + 1);
+    size = json__unescape(e->scratch, key, size);
+    return size == token->size && memcmp(e->scratch, name, size) == 0;
 }
 
-static void json__dump_indent(Json_Context *ctx, size_t level)
+/* Walk the value at 'c' for the paths active[first..last), which all
+   match up to 'depth' tokens. Values off every path are skipped. */
+static const char *json__extract_value(Json_Context *ctx, Json__Extractor *e, const char *c,
+                                       size_t first, size_t last, size_t depth)
 {
-    for (size_t i = 0; i < level; i++) {
-        json__write(ctx, ctx->opt.indent);
+    if (first == last) return json__skip_value(c, e->end);
+
+    for (size_t a = first; a < last; a++) {
+        size_t i = e->active[a];
+        if (e->paths[i].count != depth || e->paths[i].found) continue;
+
+        const char *end = json__skip_value(c, e->end);
+        if (!end || !json__extract_store(ctx, e, i, c, end)) return NULL;
+
+        /* the other paths that end in this value are resolved in the tree */
+        const Json_Value *stored = &json__get_current_scope(ctx)->as.array[i];
+        for (size_t b = first; b < last; b++) {
+            size_t j = e->active[b];
+            const Json_Value *value;
+            if (e->paths[j].found) continue;
+            Json_Value tmp;
+            value = json__extract_resolve(e, stored, &e->paths[j], depth, &tmp);
+            if (!value) continue;
+            json__get_current_scope(ctx)->as.array[j] = json__clone_value(ctx, value);
+            e->paths[j].found = true;
+            e->remaining--;
+        }
+        return end;
+    }
+
+    if (c >= e->end) return NULL;
+
+    if (*c == '{') {
+        c = json__skip_ws(c + 1, e->end);
+        if (c < e->end && *c == '}') return c + 1;
+
+        for (;;) {
+            const char *key, *key_end;
+            size_t sub = aris_vec__size(e->active);
+
+            if (c >= e->end || *c != '"') return NULL;
+            key = c + 1;
+            key_end = json__skip_string(c, e->end);
+            if (!key_end) return NULL;
+            c = json__skip_ws(key_end, e->end);
+            if (c >= e->end || *c != ':') return NULL;
+            c = json__skip_ws(c + 1, e->end);
+
+            for (size_t a = first; a < last; a++) {
+                size_t i = e->active[a];
+                Json__Extract_Path *path = &e->paths[i];
+                if (path->found || path->count <= depth) continue;
+                if (json__extract_key_match(ctx, e, &e->tokens[path->token + depth],
+                                            key, (size_t)(key_end - 1 - key))) {
+                    aris_vec__push(ctx, e->active, i);
+                }
+            }
+            c = json__extract_value(ctx, e, c, sub, aris_vec__size(e->active), depth + 1);
+            aris_vec__header(e->active)->size = sub;
+            if (!c || e->remaining == 0) return c;
+
+            c = json__skip_ws(c, e->end);
+            if (c >= e->end) return NULL;
+            if (*c == '}') return c + 1;
+            if (*c != ',') return NULL;
+            c = json__skip_ws(c + 1, e->end);
+        }
+    }
+
+    if (*c == '[') {
+        c = json__skip_ws(c + 1, e->end);
+        if (c < e->end && *c == ']') return c + 1;
+
+        for (size_t idx = 0;; idx++) {
+            size_t sub = aris_vec__size(e->active);
+
+            for (size_t a = first; a < last; a++) {
+                size_t i = e->active[a];
+                Json__Extract_Path *path = &e->paths[i];
+                if (path->found || path->count <= depth) continue;
+                if (e->tokens[path->token + depth].index == idx) aris_vec__push(ctx, e->active, i);
+            }
+            c = json__extract_value(ctx, e, c, sub, aris_vec__size(e->active), depth + 1);
+            aris_vec__header(e->active)->size = sub;
+            if (!c || e->remaining == 0) return c;
+
+            c = json__skip_ws(c, e->end);
+            if (c >= e->end) return NULL;
+            if (*c == ']') return c + 1;
+            if (*c != ',') return NULL;
+            c = json__skip_ws(c + 1, e->end);
+        }
     }
+
+    /* a scalar cannot hold the remaining tokens */
+    return json__skip_value(c, e->end);
 }
 
-static bool json_scope_begin(Json_Context *ctx, Json_Value scope)
+/* materialize the value in [c, end) into the result slot of path 'i' */
+static bool json__extract_store(Json_Context *ctx, Json__Extractor *e, size_t i, const char *c, const char *end)
 {
-    json__push_scope(ctx, scope);
-    if (!ctx->root) {
-        ctx->code = JSON_OK;
-        ctx->root = &ctx->scopes[0];
+    size_t size = (size_t)(end - c);
+    Json_Value *results;
+
+    if (*c == '{' || *c == '[') {
+        bool ok;
+
+        memset(&e->parser, 0, sizeof(e->parser));
+        ok = json__parse(ctx, &e->parser, c, size);
+        json__parser_free(ctx, &e->parser);
+        if (!ok) {
+            /* make the position relative to the whole input */
+            json__error_position(&ctx->parse_error, e->begin, c + ctx->parse_error.offset);
+            return false;
+        }
+    } else if (*c == '"') {
+        size_t n;
+        aris_vec__reserve(ctx, e->scratch, size);
+        n = json__unescape(e->scratch, c + 1, size - 2);
+        if (n == JSON__NOT_FOUND) return false;
+        json_string_n(ctx, e->scratch, n);
+    } else if (size == 4 && memcmp(c, "true", 4) == 0) {
+        json_boolean(ctx, true);
+    } else if (size == 5 && memcmp(c, "false", 5) == 0) {
+        json_boolean(ctx, false);
+    } else if (size == 4 && memcmp(c, "null", 4) == 0) {
+        json_null(ctx);
+    } else {
+        char number[64];
+        char *number_end;
+        if (size == 0 || size >= sizeof(number)) return false;
+        memcpy(number, c, size);
+        number[size] = '\0';
+        double value = strtod(number, &number_end);
+        if (number_end != number + size) return false;
+        json_number(ctx, value);
     }
 
+    /* move the appended value into its slot */
+    results = json__get_current_scope(ctx);
+    if (!results) return false;
+    results->as.array[i] = aris_vec__pop(results->as.array);
+    e->paths[i].found = true;
+    e->remaining--;
+
     return true;
 }
 
-static bool json_scope_end(Json_Context *ctx)
+static const Json_Value *json__extract_resolve(const Json__Extractor *e, const Json_Value *value,
+                                               const Json__Extract_Path *path, size_t depth,
+                                               Json_Value *tmp)
 {
-    /* ctx->root has the reference of ctx->scopes[0] */
-    if (aris_vec__size(ctx->scopes) == 1) return true;
+    for (size_t t = depth; t < path->count && value; t++) {
+        const Json__Extract_Token *token = &e->tokens[path->token + t];
+        if (json_is_object(value)) {
+            value = json__object_find(NULL, value, e->names + token->offset, token->size);
+        } else if (json_is_array(value)) {
+            value = json__element(value, token->index, tmp);
+        } else {
+            value = NULL;
+        }
+    }
 
-    Json_Value pair_value = json__pop_scope(ctx);
-    json__append_element(ctx, ctx->scope_type == JSON_SCOPE_OBJECT
-                              ? strdup(ctx->current_key) : NULL, pair_value);
+    return value;
+}
 
-    return true;
+static const char *const json__query_operators[] = {"==", "!=", "<", "<=", ">", ">="};
+static const Json_Value json__query_null = {.type = JSON_VALUE_NULL};
+
+/* The tokens of a query are those of JSON and the few below; the lexer
+   is lenient so that names and keywords come out as identifiers. */
+static int json__query_lex(Json__Query_Compiler *qc)
+{
+    Json__Lexer *lx = &qc->lex;
+    const char *c = lx->cur;
+
+    while (c < lx->end && (*c == ' ' || *c == '\n' || *c == '\r' || *c == '\t')) c++;
+    lx->start = lx->cur = c;
+    if (c == lx->end) return json__lex(lx);
+
+    switch (*c) {
+    case '.': case '|': case '(': case ')':
+        lx->cur = c + 1;
+        return lx->token = *c;
+
+    case '=': case '!': case '<': case '>':
+        if (c + 1 < lx->end && c[1] == '=') {
+            lx->cur = c + 2;
+        } else if (*c == '<' || *c == '>') {
+            lx->cur = c + 1;
+        } else {
+            return json__lex_fail(lx, JSON_PARSE_INVALID_CHARACTER, c);
+        }
+        return lx->token = JSON__TOKEN_COMPARE;
+
+    default:
+        return json__lex(lx);
+    }
 }
 
-#ifdef JSON_ENABLE_DESERIALIZATION
-static long json__peek(stb_lexer *lex)
+static bool json__query_word(const Json__Query_Compiler *qc, const char *word)
+{
+    size_t n = strlen(word);
+    return qc->lex.token == JSON__TOKEN_IDENT && (size_t)(qc->lex.cur - qc->lex.start) == n &&
+           memcmp(qc->lex.start, word, n) == 0;
+}
+
+/* json_query_compile with a compiler whose memory the caller frees, also
+   when the query does not fit: the compiler lives outside the frame of
+   the setjmp, where a longjmp leaves it intact */
+static bool json__query_compile(Json_Context *ctx, Json__Query_Compiler *qc)
 {
-    char *saved_point;
-    long token;
+    bool ok;
 
-    saved_point = lex->parse_point;
-    stb_c_lexer_get_token(lex);
-    token = lex->token;
-    lex->parse_point = saved_point;
+    JSON__RECOVER(ctx, ok = json__query_parse(ctx, qc),
+                  ok = false; qc->lex.code = JSON_PARSE_OUT_OF_MEMORY;
+                  json__query_fail(ctx, qc, "a query that fits in memory"); json__memory_error(ctx));
 
-    return token;
+    return ok;
 }
 
-static long json__advance(stb_lexer *lex)
+/* 'qc->lex' into a new 'qc->query', which is left for the caller to free */
+static bool json__query_parse(Json_Context *ctx, Json__Query_Compiler *qc)
 {
-    stb_c_lexer_get_token(lex);
-    return lex->token;
+    bool ok;
+
+    qc->query = (Json_Query*)json__malloc(ctx, sizeof(*qc->query));
+    *qc->query = (Json_Query){0};
+    json__query_lex(qc);
+    ok = json__query_pipe(ctx, qc) &&
+         (qc->lex.token == JSON__TOKEN_END || json__query_fail(ctx, qc, "'|' or end of query"));
+    json__query_emit(ctx, qc, JSON__QUERY_END, 0);
+
+    return ok;
 }
 
-static const char *token_kind(long token)
+static bool json__query_fail(Json_Context *ctx, Json__Query_Compiler *qc, const char *expected)
 {
-    switch (token) {
-    case CLEX_id:       return "identifier";
-    case CLEX_dqstring: return "double quote string";
-    case CLEX_sqstring: return "single quote string";
-    case CLEX_charlit:  return "character";
-    case CLEX_intlit:   return "integer";
-    case CLEX_floatlit: return "float";
-    default:
-        if (token >= 0 && token < 256) {
-            static char tmp_buf[16];
-            snprintf(tmp_buf, sizeof(tmp_buf), "%c", (char)token);
-            return tmp_buf;
-        } else {
-            return "unknown token";
-        }
+    if (ctx->parse_error.code == JSON_PARSE_OK) json__parse_error(&ctx->parse_error, &qc->lex, expected);
+    return false;
+}
+
+static size_t json__query_emit(Json_Context *ctx, Json__Query_Compiler *qc, int code, size_t arg)
+{
+    Json__Query_Op op = {.code = code, .arg = arg};
+    aris_vec__push(ctx, qc->query->ops, op);
+    return aris_vec__size(qc->query->ops) - 1;
+}
+
+/* add the current string, name or literal token to the literals of the
+   query; 'key' for a member name, which gets the hash of a key */
+static bool json__query_literal(Json_Context *ctx, Json__Query_Compiler *qc, bool key, size_t *idx)
+{
+    Json__Lexer *lx = &qc->lex;
+    const char *raw = lx->start;
+    size_t n = (size_t)(lx->cur - lx->start);
+    Json_Value value;
+
+    if (lx->token == JSON__TOKEN_STRING) {
+        aris_vec__reserve(ctx, qc->scratch, n);
+        n = json__unescape(qc->scratch, raw + 1, n - 2);
+        if (n == JSON__NOT_FOUND) return json__query_fail(ctx, qc, "a valid string");
+        raw = qc->scratch;
+    } else if (!key && lx->token == JSON__TOKEN_NUMBER) {
+        char number[64];
+        if (n >= sizeof(number)) return json__query_fail(ctx, qc, "a shorter number");
+        memcpy(number, raw, n);
+        number[n] = '\0';
+        value = json_new_number(strtod(number, NULL));
+    } else if (!key && (lx->token == JSON__TOKEN_TRUE || lx->token == JSON__TOKEN_FALSE)) {
+        value = json_new_boolean(lx->token == JSON__TOKEN_TRUE);
+    } else if (!key && lx->token == JSON__TOKEN_NULL) {
+        value = json_new_null();
+    } else if (!(key && (lx->token == JSON__TOKEN_IDENT || lx->token == JSON__TOKEN_TRUE ||
+                         lx->token == JSON__TOKEN_FALSE || lx->token == JSON__TOKEN_NULL))) {
+        return json__query_fail(ctx, qc, key ? "a name or a string" : "a path or a literal");
     }
+    /* room first, so that a string is never allocated and then dropped */
+    aris_vec__room(ctx, qc->query->literals);
+    if (lx->token == JSON__TOKEN_STRING || key) {
+        value = key ? json__new_key(ctx, raw, n) : json__new_string(ctx, raw, n);
+    }
+
+    aris_vec__push(ctx, qc->query->literals, value);
+    *idx = aris_vec__size(qc->query->literals) - 1;
+    return true;
 }
 
-static bool json__consume(stb_lexer *lex, long expected, const char *msg)
+static bool json__query_integer(Json_Context *ctx, Json__Query_Compiler *qc, int64_t *out)
 {
-    long token = json__advance(lex);
-    if (token != expected) {
-        stb_lex_location loc = {0};
-        stb_c_lexer_get_location(lex, lex->where_firstchar, &loc);
-        fprintf(stderr, "ERROR: %s (expected '%s' but found '%s') at %d:%d\n",
-                msg, token_kind(expected), token_kind(token),
-                loc.line_number, loc.line_offset);
-        return false;
+    Json__Lexer *lx = &qc->lex;
+    const char *c = lx->start;
+    bool negative = *c == '-';
+    int64_t value = 0;
+
+    if (lx->token != JSON__TOKEN_NUMBER) return json__query_fail(ctx, qc, "an index");
+    for (c += negative; c < lx->cur; c++) {
+        if (!JSON__IS_DIGIT(*c) || value > 100000000000000000) return json__query_fail(ctx, qc, "an integer");
+        value = value*10 + (*c - '0');
     }
+    *out = negative ? -value : value;
     return true;
 }
 
-static bool json__parse_value(Json_Context *ctx, stb_lexer *lex)
+/* pipe := stage ('|' stage)* */
+static bool json__query_pipe(Json_Context *ctx, Json__Query_Compiler *qc)
 {
-    long token = json__advance(lex);
-    switch (token) {
-    case CLEX_dqstring:
-        json_string(ctx, lex->string);
-        return true;
+    if (!json__query_stage(ctx, qc)) return false;
+    while (qc->lex.token == '|') {
+        json__query_lex(qc);
+        if (!json__query_stage(ctx, qc)) return false;
+    }
+    return true;
+}
 
-    case CLEX_intlit:
-        json_number(ctx, (float)lex->int_number);
-        return true;
+/* stage := path | 'select' '(' condition ')' | '{' fields '}' | 'length' */
+static bool json__query_stage(Json_Context *ctx, Json__Query_Compiler *qc)
+{
+    if (qc->lex.token == '.') return json__query_path(ctx, qc, false);
+    if (qc->lex.token == '{') return json__query_object(ctx, qc);
 
-    case CLEX_floatlit:
-        json_number(ctx, (float)lex->real_number);
+    if (json__query_word(qc, "length")) {
+        json__query_emit(ctx, qc, JSON__QUERY_LENGTH, 0);
+        json__query_lex(qc);
+        return true;
+    }
+    if (json__query_word(qc, "select")) {
+        size_t select = json__query_emit(ctx, qc, JSON__QUERY_SELECT, 0);
+        if (json__query_lex(qc) != '(') return json__query_fail(ctx, qc, "'('");
+        json__query_lex(qc);
+        qc->depth = 0;
+        if (!json__query_or(ctx, qc)) return false;
+        if (qc->lex.token != ')') return json__query_fail(ctx, qc, "')'");
+        qc->query->ops[select].next = aris_vec__size(qc->query->ops);
+        json__query_lex(qc);
         return true;
+    }
+
+    return json__query_fail(ctx, qc, "a path, 'select', 'length' or '{'");
+}
 
-    case CLEX_id:
-        if (strcmp(lex->string, "null") == 0) {
-            json_null(ctx);
+/* Steps from the current '.': names, strings and brackets. A path that
+   is 'single' leads to one value, it has no [] or slices. */
+static bool json__query_path(Json_Context *ctx, Json__Query_Compiler *qc, bool single)
+{
+    bool first = true;
+
+    for (;;) {
+        if (qc->lex.token == '[') {
+            if (!json__query_brackets(ctx, qc, single)) return false;
+        } else if (qc->lex.token == '.') {
+            const char *dot = qc->lex.cur;
+            size_t key;
+
+            json__query_lex(qc);
+            if (qc->lex.token == '[') continue;
+            /* '.' alone is the value itself, and '. and' is not a member */
+            if (qc->lex.start != dot || qc->lex.token == JSON__TOKEN_END ||
+                qc->lex.token < JSON__TOKEN_END || qc->lex.token == JSON__TOKEN_COMPARE) {
+                if (first) return true;
+                return json__query_fail(ctx, qc, "a name or '['");
+            }
+            if (!json__query_literal(ctx, qc, true, &key)) return false;
+            json__query_emit(ctx, qc, JSON__QUERY_KEY, key);
+            json__query_lex(qc);
+        } else {
             return true;
         }
-        if (strcmp(lex->string, "true") == 0) {
-            json_boolean(ctx, true);
-            return true;
+        first = false;
+    }
+}
+
+/* '[' ']' | '[' index ']' | '[' index? ':' index? ']' | '[' string ']' */
+static bool json__query_brackets(Json_Context *ctx, Json__Query_Compiler *qc, bool single)
+{
+    Json__Query_Op op = {.code = JSON__QUERY_INDEX};
+
+    json__query_lex(qc);
+    if (qc->lex.token == ']' && !single) {
+        op.code = JSON__QUERY_EACH;
+    } else if (qc->lex.token == JSON__TOKEN_STRING) {
+        op.code = JSON__QUERY_KEY;
+        if (!json__query_literal(ctx, qc, true, &op.arg)) return false;
+        json__query_lex(qc);
+    } else {
+        if (qc->lex.token != ':' || single) {
+            if (!json__query_integer(ctx, qc, &op.from)) return false;
+            json__query_lex(qc);
         }
-        if (strcmp(lex->string, "false") == 0) {
-            json_boolean(ctx, false);
-            return true;
+        if (qc->lex.token == ':' && !single) {
+            op.code = JSON__QUERY_SLICE;
+            op.to = INT64_MAX;
+            if (json__query_lex(qc) != ']') {
+                if (!json__query_integer(ctx, qc, &op.to)) return false;
+                json__query_lex(qc);
+            }
         }
-        return false;
+    }
+    if (qc->lex.token != ']') return json__query_fail(ctx, qc, "']'");
 
-    case '{':
-        lex->parse_point--; /* put back the token for parse_object to consume */
-        return json__parse_object(ctx, lex);
+    aris_vec__push(ctx, qc->query->ops, op);
+    json__query_lex(qc);
+    return true;
+}
 
-    case '[':
-        lex->parse_point--; /* put back the token for parse_array to consume */
-        return json__parse_array(ctx, lex);
+/* '{' field (',' field)* '}', field := name (':' path)? */
+static bool json__query_object(Json_Context *ctx, Json__Query_Compiler *qc)
+{
+    size_t object = json__query_emit(ctx, qc, JSON__QUERY_OBJECT, 0);
+    size_t count = 0;
+
+    do {
+        size_t key, field;
+
+        json__query_lex(qc);
+        if (!json__query_literal(ctx, qc, true, &key)) return false;
+        field = json__query_emit(ctx, qc, JSON__QUERY_FIELD, key);
+        /* {name} is {name: .name} */
+        if (json__query_lex(qc) == ':') {
+            if (json__query_lex(qc) != '.') return json__query_fail(ctx, qc, "a path");
+            if (!json__query_path(ctx, qc, true)) return false;
+        } else {
+            json__query_emit(ctx, qc, JSON__QUERY_KEY, key);
+        }
+        qc->query->ops[field].next = aris_vec__size(qc->query->ops);
+        count++;
+    } while (qc->lex.token == ',');
+    if (qc->lex.token != '}') return json__query_fail(ctx, qc, "',' or '}'");
+
+    qc->query->ops[object].arg = count;
+    qc->query->ops[object].next = aris_vec__size(qc->query->ops);
+    aris_vec__reserve(ctx, qc->query->ops[object].pairs, count);
+    json__query_lex(qc);
+    return true;
+}
 
-    default:
-        return false;
+/* or := and ('or' and)* */
+static bool json__query_or(Json_Context *ctx, Json__Query_Compiler *qc)
+{
+    if (!json__query_and(ctx, qc)) return false;
+    while (json__query_word(qc, "or")) {
+        size_t jump = json__query_emit(ctx, qc, JSON__QUERY_OR, 0);
+        json__query_lex(qc);
+        qc->depth--;
+        if (!json__query_and(ctx, qc)) return false;
+        if (!qc->boolean) json__query_emit(ctx, qc, JSON__QUERY_TRUTH, 0);
+        qc->query->ops[jump].next = aris_vec__size(qc->query->ops);
+        qc->boolean = true;
     }
+    return true;
 }
 
-static bool json__parse_array(Json_Context *ctx, stb_lexer *lex)
+/* and := comparison ('and' comparison)* */
+static bool json__query_and(Json_Context *ctx, Json__Query_Compiler *qc)
 {
-    if (!json__consume(lex, '[', "array should start with '['")) {
-        return false;
+    if (!json__query_comparison(ctx, qc)) return false;
+    while (json__query_word(qc, "and")) {
+        size_t jump = json__query_emit(ctx, qc, JSON__QUERY_AND, 0);
+        json__query_lex(qc);
+        qc->depth--;
+        if (!json__query_comparison(ctx, qc)) return false;
+        if (!qc->boolean) json__query_emit(ctx, qc, JSON__QUERY_TRUTH, 0);
+        qc->query->ops[jump].next = aris_vec__size(qc->query->ops);
+        qc->boolean = true;
     }
+    return true;
+}
 
-    json_array_begin(ctx);
+/* comparison := operand (operator operand)? */
+static bool json__query_comparison(Json_Context *ctx, Json__Query_Compiler *qc)
+{
+    size_t op = 0;
+
+    if (!json__query_operand(ctx, qc)) return false;
+    if (qc->lex.token != JSON__TOKEN_COMPARE) return true;
+
+    while (strlen(json__query_operators[op]) != (size_t)(qc->lex.cur - qc->lex.start) ||
+           memcmp(json__query_operators[op], qc->lex.start, (size_t)(qc->lex.cur - qc->lex.start)) != 0) op++;
+    json__query_lex(qc);
+    if (!json__query_operand(ctx, qc)) return false;
+    json__query_emit(ctx, qc, JSON__QUERY_COMPARE, op);
+    qc->depth--;
+    qc->boolean = true;
+    return true;
+}
 
-    /* handle empty array */
-    if (json__peek(lex) == ']') {
-        json__advance(lex);
-        json_array_end(ctx);
+/* operand := '(' or ')' | path ('|' 'length')? | 'length' | literal */
+static bool json__query_operand(Json_Context *ctx, Json__Query_Compiler *qc)
+{
+    if (qc->lex.token == '(') {
+        if (++qc->nesting > JSON__QUERY_STACK) {
+            json__query_fail(ctx, qc, "a simpler condition");
+            ctx->parse_error.code = JSON_PARSE_TOO_DEEP;
+            return false;
+        }
+        json__query_lex(qc);
+        if (!json__query_or(ctx, qc)) return false;
+        if (qc->lex.token != ')') return json__query_fail(ctx, qc, "')'");
+        qc->nesting--;
+        json__query_lex(qc);
         return true;
     }
 
-    while (true) {
-        if (!json__parse_value(ctx, lex)) return false;
-
-        if (json__peek(lex) != ',') break;
+    if (qc->lex.token == '.' || json__query_word(qc, "length")) {
+        size_t path = json__query_emit(ctx, qc, JSON__QUERY_PATH, 0);
 
-        /* allow trailing comma at the end of array */
-        json__advance(lex);
-        if (json__peek(lex) == ']') break;
+        if (qc->lex.token == '.') {
+            if (!json__query_path(ctx, qc, true)) return false;
+            if (qc->lex.token == '|') {
+                json__query_lex(qc);
+                if (!json__query_word(qc, "length")) return json__query_fail(ctx, qc, "'length'");
+            }
+        }
+        if (json__query_word(qc, "length")) {
+            json__query_emit(ctx, qc, JSON__QUERY_LENGTH, 0);
+            json__query_lex(qc);
+        }
+        qc->query->ops[path].next = aris_vec__size(qc->query->ops);
+        qc->boolean = false;
+        return json__query_push(ctx, qc, 1);
     }
-    if (!json__consume(lex, ']', "array should end with ']'")) return false;
 
-    json_array_end(ctx);
+    size_t literal;
+    if (!json__query_literal(ctx, qc, false, &literal)) return false;
+    json__query_emit(ctx, qc, JSON__QUERY_LITERAL, literal);
+    json__query_lex(qc);
+    qc->boolean = false;
+    return json__query_push(ctx, qc, 1);
+}
 
-    return true;
+/* account for 'n' more values on the stack of the condition */
+static bool json__query_push(Json_Context *ctx, Json__Query_Compiler *qc, size_t n)
+{
+    qc->depth += n;
+    if (qc->depth <= JSON__QUERY_STACK) return true;
+
+    json__query_fail(ctx, qc, "a simpler condition");
+    ctx->parse_error.code = JSON_PARSE_TOO_DEEP;
+    return false;
 }
 
-static bool json__parse_object(Json_Context *ctx, stb_lexer *lex)
+/* Run the instructions from 'pc' on 'value'. Single values are followed
+   in place, [] and the like recurse for each of theirs; false once the
+   callback asked to stop. */
+static bool json__query_eval(Json__Query_Run *run, size_t pc, const Json_Value *value)
 {
-    if (!json__consume(lex, '{', "object should start with '{'")) {
-        return false;
+    Json__Query_Op *ops = run->query->ops;
+    Json_Value tmp, view;
+
+    for (;;) {
+        Json__Query_Op *op = &ops[pc];
+
+        switch (op->code) {
+        case JSON__QUERY_END:
+            run->count++;
+            return !run->fn || run->fn(value, run->user);
+
+        case JSON__QUERY_EACH:
+            if (json_is_object(value)) {
+                for (size_t i = 0; i < aris_vec__size(value->as.object); i++) {
+                    if (!json__query_eval(run, pc + 1, &value->as.object[i].value)) return false;
+                }
+            } else if (json_is_array(value)) {
+                for (size_t i = 0; i < aris_vec__size(value->as.array); i++) {
+                    Json_Value element;
+                    if (!json__query_eval(run, pc + 1, json__element(value, i, &element))) return false;
+                }
+            }
+            return true;
+
+        case JSON__QUERY_SLICE:
+            view = json__query_slice(run->ctx, op, value);
+            value = &view;
+            pc++;
+            break;
+
+        case JSON__QUERY_SELECT:
+            if (!json__query_test(run, pc + 1, op->next, value)) return true;
+            pc = op->next;
+            break;
+
+        case JSON__QUERY_OBJECT:
+            view = json__query_project(run, pc, value);
+            value = &view;
+            pc = op->next;
+            break;
+
+        default:
+            value = json__query_step(run->query, op, value, &tmp);
+            pc++;
+            break;
+        }
     }
+}
 
-    json_object_begin(ctx);
+/* a step of a path to one value: a member, an element or a length */
+static const Json_Value *json__query_step(const Json_Query *q, const Json__Query_Op *op,
+                                          const Json_Value *value, Json_Value *tmp)
+{
+    switch (op->code) {
+    case JSON__QUERY_KEY: {
+        const Json_Value *key = &q->literals[op->arg];
+        value = json_object_get_value_n(value, json_to_string(key), json_string_length(key));
+        break;
+    }
 
-    /* handle empty object */
-    if (json__peek(lex) == '}') {
-        json__advance(lex);
-        json_object_end(ctx);
-        return true;
+    case JSON__QUERY_INDEX: {
+        int64_t size = (int64_t)json_array_get_size(value);
+        int64_t idx = op->from < 0 ? size + op->from : op->from;
+        value = json_is_array(value) && idx >= 0 ? json__element(value, (size_t)idx, tmp) : NULL;
+        break;
     }
 
-    while (true) {
-        /* parse key */
-        if (!json__consume(lex, CLEX_dqstring, "key should be a string")) {
-            return false;
+    case JSON__QUERY_LENGTH: {
+        double length = 0;
+        if (json_is_object(value) || json_is_array(value)) {
+            length = (double)aris_vec__size(json__items(value));
+        } else if (json_is_string(value)) {
+            /* in code points, like jq */
+            const char *s = json_to_string(value);
+            for (size_t i = 0; i < json_string_length(value); i++) length += ((unsigned char)s[i] & 0xC0) != 0x80;
+        } else if (json_is_number(value)) {
+            length = fabs(json_to_number(value));
+        } else if (json_is_boolean(value)) {
+            return &json__query_null;
         }
-        json_key(ctx, lex->string);
+        *tmp = json_new_number(length);
+        return tmp;
+    }
 
-        /* parse colon separator */
-        if (!json__consume(lex, ':', "lack of ':' in a pair")) {
-            return false;
+    default:
+        break;
+    }
+
+    return value ? value : &json__query_null;
+}
+
+/* the elements [from, to) of an array, copied by value into the scratch
+   array of the slice */
+static Json_Value json__query_slice(Json_Context *ctx, Json__Query_Op *op, const Json_Value *value)
+{
+    Json_Value array = json_new_array();
+    int64_t size = (int64_t)json_array_get_size(value);
+    int64_t from = op->from < 0 ? size + op->from : op->from;
+    int64_t to = op->to < 0 ? size + op->to : op->to;
+
+    if (!json_is_array(value)) return json__query_null;
+    if (from < 0) from = 0;
+    if (to > size) to = size;
+
+    aris_vec__reset(op->items);
+    for (int64_t i = from; i < to; i++) {
+        Json_Value element;
+        aris_vec__push(ctx, op->items, *json__element(value, (size_t)i, &element));
+    }
+    array.as.array = op->items;
+    return array;
+}
+
+/* the object of the projection at 'pc', its values copied by value into
+   the scratch object of the projection */
+static Json_Value json__query_project(Json__Query_Run *run, size_t pc, const Json_Value *value)
+{
+    Json__Query_Op *ops = run->query->ops;
+    Json__Query_Op *object = &ops[pc];
+    Json_Value result = json_new_object();
+
+    aris_vec__reset(object->pairs);
+    for (size_t f = pc + 1; f < object->next; f = ops[f].next) {
+        Json_Pair pair = {.key = run->query->literals[ops[f].arg]};
+        Json_Value tmp;
+        const Json_Value *v = value;
+
+        for (size_t i = f + 1; i < ops[f].next; i++) v = json__query_step(run->query, &ops[i], v, &tmp);
+        pair.value = *v;
+        aris_vec__push(run->ctx, object->pairs, pair);
+    }
+    result.as.object = object->pairs;
+    return result;
+}
+
+/* Evaluate the condition in [pc, end) on 'value'. The stack holds
+   pointers, to the tree, the literals, or 'tmp' for what a path works
+   out (a length, an element of a packed array). */
+static bool json__query_test(Json__Query_Run *run, size_t pc, size_t end, const Json_Value *value)
+{
+    static const Json_Value booleans[2] = {
+        {.type = JSON_VALUE_BOOLEAN},
+        {.type = JSON_VALUE_BOOLEAN, .as = {.boolean = true}},
+    };
+    const Json_Query *q = run->query;
+    const Json_Value *stack[JSON__QUERY_STACK];
+    Json_Value tmp[JSON__QUERY_STACK];
+    size_t top = 0;
+
+    while (pc < end) {
+        const Json__Query_Op *op = &q->ops[pc];
+
+        switch (op->code) {
+        case JSON__QUERY_PATH: {
+            const Json_Value *v = value;
+            for (size_t i = pc + 1; i < op->next; i++) v = json__query_step(q, &q->ops[i], v, &tmp[top]);
+            stack[top++] = v;
+            pc = op->next;
+            continue;
         }
 
-        /* parse value */
-        if (!json__parse_value(ctx, lex)) return false;
+        case JSON__QUERY_LITERAL:
+            stack[top++] = &q->literals[op->arg];
+            break;
+
+        case JSON__QUERY_COMPARE:
+            top--;
+            stack[top - 1] = &booleans[json__query_compare(run->ctx, stack[top - 1], stack[top], op->arg)];
+            break;
+
+        case JSON__QUERY_AND:
+        case JSON__QUERY_OR:
+            if (json__query_truthy(stack[top - 1]) == (op->code == JSON__QUERY_OR)) {
+                stack[top - 1] = &booleans[op->code == JSON__QUERY_OR];
+                pc = op->next;
+                continue;
+            }
+            top--;
+            break;
 
-        if (json__peek(lex) != ',') break;
+        case JSON__QUERY_TRUTH:
+            stack[top - 1] = &booleans[json__query_truthy(stack[top - 1])];
+            break;
 
-        /* allow trailing comma at the end of object */
-        json__advance(lex);
-        if (json__peek(lex) == '}') break;
+        default:
+            break;
+        }
+        pc++;
     }
-    if (!json__consume(lex, '}', "object should end with '}'")) return false;
 
-    json_object_end(ctx);
+    return top > 0 && json__query_truthy(stack[0]);
+}
 
-    return true;
+/* Comparison 'op' (an index of json__query_operators) in jq's order:
+   null < false < true < numbers < strings < arrays < objects. Arrays and
+   objects are only told equal or not. */
+static bool json__query_compare(Json_Context *ctx, const Json_Value *a, const Json_Value *b, size_t op)
+{
+    int order = json__query_rank(a) - json__query_rank(b);
+
+    if (order == 0 && (json_is_object(a) || json_is_array(a))) {
+        bool equal = json__equal(ctx, a, b);
+        switch (op) {
+        case 0: case 3: case 5: return equal;
+        case 1:                 return !equal;
+        default:                return false;
+        }
+    }
+    if (order == 0 && json_is_number(a)) {
+        order = (json_to_number(a) > json_to_number(b)) - (json_to_number(a) < json_to_number(b));
+    } else if (order == 0 && json_is_string(a)) {
+        size_t n = json_string_length(a) < json_string_length(b) ? json_string_length(a) : json_string_length(b);
+        order = memcmp(json_to_string(a), json_to_string(b), n);
+        if (order == 0) order = (json_string_length(a) > n) - (json_string_length(b) > n);
+    }
+
+    switch (op) {
+    case 0:  return order == 0;
+    case 1:  return order != 0;
+    case 2:  return order < 0;
+    case 3:  return order <= 0;
+    case 4:  return order > 0;
+    default: return order >= 0;
+    }
+}
+
+static int json__query_rank(const Json_Value *value)
+{
+    switch (value->type) {
+    case JSON_VALUE_BOOLEAN: return json_to_boolean(value) ? 2 : 1;
+    case JSON_VALUE_NUMBER:  return 3;
+    case JSON_VALUE_STRING:  return 4;
+    case JSON_VALUE_ARRAY:   return 5;
+    case JSON_VALUE_OBJECT:  return 6;
+    default:                 return 0;
+    }
+}
+
+/* everything but null and false, as in jq */
+static bool json__query_truthy(const Json_Value *value)
+{
+    return !(value->type == JSON_VALUE_NULL ||
+             (json_is_boolean(value) && !json_to_boolean(value)));
 }
 #endif /* JSON_ENABLE_DESERIALIZATION */
 
+#ifdef JSON_ENABLE_STATS_TIMING
+#ifdef _WIN32
+#include <windows.h>
+static unsigned long long json__now_ns(void)
+{
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (unsigned long long)(now.QuadPart * (1000000000.0 / freq.QuadPart));
+}
+#else
+#include <time.h>
+static unsigned long long json__now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#endif /* _WIN32 */
+#endif /* JSON_ENABLE_STATS_TIMING */
+
+#undef JSON__STAT_ADD
+#undef JSON__STAT_MAX
+#undef JSON__TIMER_BEGIN
+#undef JSON__TIMER_END
 #undef aris_vec__header
 #undef aris_vec__size
 #undef aris_vec__capacity
+#undef aris_vec__grow
 #undef aris_vec__push
+#undef aris_vec__reserve
+#undef aris_vec__shrink
 #undef aris_vec__pop
 #undef aris_vec__free
 #undef aris_vec__reset
+#undef JSON__VOID_TO
+#undef JSON__THREAD_LOCAL
+
+#if defined(__cplusplus) && defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
 
 #endif /* JSON_IMPLEMENTATION */
 
@@ -0,0 +1,304 @@
+/*
+json.hpp - C++17 binding for json.h
+===================================================
+
+BRIEF:
+  A thin layer over the C API: a move-only document that owns a context,
+  and value views with std::string_view keys and strings, range-for over
+  objects and arrays, and get<T>(). Every call is inline and ends in the
+  same accessor the C code uses, so it costs nothing on top of it.
+
+USAGE:
+  Include it instead of json.h; the implementation is still compiled by
+  the one file that defines JSON_IMPLEMENTATION (and the feature macros)
+  before including either header.
+  ```
+    json::Document doc;
+    if (!doc.parse(text)) return 1;
+    for (json::Member m : doc.root().members()) {
+        std::cout << m.key() << ": " << m.value().get_or<double>(0) << "\n";
+    }
+  ```
+  Views borrow from the document and are invalidated like the pointers
+  of the C API. Errors are reported by return values, as in C.
+*/
+
+#ifndef JSON_HPP
+#define JSON_HPP
+
+#include "json.h"
+
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+
+namespace json {
+
+class Value;
+class Member;
+
+namespace detail {
+template <typename T> inline constexpr bool unsupported = false;
+
+/* a pointer that walks a C vector, turned into a view on dereference */
+template <typename Item, typename View>
+class Iterator {
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = View;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = View;
+
+    constexpr Iterator() noexcept = default;
+    constexpr explicit Iterator(const Item *item) noexcept : item_(item) {}
+
+    View operator*() const noexcept { return View(item_); }
+    View operator[](difference_type n) const noexcept { return View(item_ + n); }
+    Iterator &operator++() noexcept { ++item_; return *this; }
+    Iterator operator++(int) noexcept { Iterator it = *this; ++item_; return it; }
+    Iterator &operator--() noexcept { --item_; return *this; }
+    Iterator operator--(int) noexcept { Iterator it = *this; --item_; return it; }
+    Iterator &operator+=(difference_type n) noexcept { item_ += n; return *this; }
+    Iterator &operator-=(difference_type n) noexcept { item_ -= n; return *this; }
+    Iterator operator+(difference_type n) const noexcept { return Iterator(item_ + n); }
+    Iterator operator-(difference_type n) const noexcept { return Iterator(item_ - n); }
+    difference_type operator-(Iterator other) const noexcept { return item_ - other.item_; }
+    bool operator==(Iterator other) const noexcept { return item_ == other.item_; }
+    bool operator!=(Iterator other) const noexcept { return item_ != other.item_; }
+    bool operator<(Iterator other) const noexcept { return item_ < other.item_; }
+
+private:
+    const Item *item_ = nullptr;
+};
+
+template <typename Item, typename View>
+class Range {
+public:
+    using iterator = Iterator<Item, View>;
+
+    constexpr Range(const Item *items, std::size_t size) noexcept
+        : items_(items), size_(size) {}
+
+    iterator begin() const noexcept { return iterator(items_); }
+    iterator end() const noexcept { return iterator(items_ + size_); }
+    std::size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    View operator[](std::size_t idx) const noexcept { return View(items_ + idx); }
+
+private:
+    const Item *items_;
+    std::size_t size_;
+};
+} /* namespace detail */
+
+using Members = detail::Range<Json_Pair, Member>;
+using Elements = detail::Range<Json_Value, Value>;
+
+/* the doubles of a packed array (Json_Opt.pack_numbers), as a span */
+class Numbers {
+public:
+    constexpr Numbers(const double *data, std::size_t size) noexcept
+        : data_(data), size_(size) {}
+
+    const double *begin() const noexcept { return data_; }
+    const double *end() const noexcept { return data_ + size_; }
+    const double *data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    double operator[](std::size_t idx) const noexcept { return data_[idx]; }
+
+private:
+    const double *data_;
+    std::size_t size_;
+};
+
+/* A read-only view of a value, or of nothing when a lookup failed.
+   Looking something up in nothing gives nothing again, so paths can be
+   chained and checked once at the end. */
+class Value {
+public:
+    constexpr Value() noexcept = default;
+    constexpr explicit Value(const Json_Value *value) noexcept : value_(value) {}
+
+    explicit operator bool() const noexcept { return value_ != nullptr; }
+    const Json_Value *c_value() const noexcept { return value_; }
+
+    Json_Value_Type type() const noexcept
+    {
+        return value_ ? static_cast<Json_Value_Type>(value_->type) : JSON_VALUE_NULL;
+    }
+    bool is_null() const noexcept { return type() == JSON_VALUE_NULL; }
+    bool is_object() const noexcept { return type() == JSON_VALUE_OBJECT; }
+    bool is_array() const noexcept { return type() == JSON_VALUE_ARRAY; }
+    bool is_string() const noexcept { return type() == JSON_VALUE_STRING; }
+    bool is_number() const noexcept { return type() == JSON_VALUE_NUMBER; }
+    bool is_boolean() const noexcept { return type() == JSON_VALUE_BOOLEAN; }
+    bool is_packed() const noexcept { return value_ && json_array_is_packed(value_); }
+
+    /* whether get<T>() reads this value */
+    template <typename T>
+    bool is() const noexcept
+    {
+        if constexpr (std::is_same_v<T, bool>) {
+            return is_boolean();
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            return is_number();
+        } else if constexpr (std::is_same_v<T, std::string_view> ||
+                             std::is_same_v<T, const char*>) {
+            return is_string();
+        } else {
+            static_assert(detail::unsupported<T>, "get<T>: use bool, an arithmetic type, std::string_view or const char*");
+            return false;
+        }
+    }
+
+    /* unchecked, like json_to_*: the value has to be a T (see is<T>) */
+    template <typename T>
+    T get() const noexcept
+    {
+        if constexpr (std::is_same_v<T, bool>) {
+            return json_to_boolean(value_);
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            return static_cast<T>(json_to_number(value_));
+        } else if constexpr (std::is_same_v<T, std::string_view>) {
+            return std::string_view(json_to_string(value_), json_string_length(value_));
+        } else if constexpr (std::is_same_v<T, const char*>) {
+            return json_to_string(value_);
+        } else {
+            static_assert(detail::unsupported<T>, "get<T>: use bool, an arithmetic type, std::string_view or const char*");
+            return T();
+        }
+    }
+
+    /* checked: 'fallback' when the value is missing or not a T */
+    template <typename T>
+    T get_or(T fallback) const noexcept { return is<T>() ? get<T>() : fallback; }
+
+    Value operator[](const char *key) const noexcept
+    {
+        return Value(value_ ? json_object_get_value(value_, key) : nullptr);
+    }
+    Value operator[](std::string_view key) const noexcept
+    {
+        return Value(value_ ? json_object_get_value_n(value_, key.data(), key.size()) : nullptr);
+    }
+    /* any integer, so that a literal 0 is not taken for a null key */
+    template <typename I, std::enable_if_t<std::is_integral_v<I>, int> = 0>
+    Value operator[](I idx) const noexcept
+    {
+        return Value(value_ ? json_array_get_value(value_, static_cast<std::size_t>(idx)) : nullptr);
+    }
+
+    /* the size of an object or array, 0 for anything else */
+    std::size_t size() const noexcept
+    {
+        if (is_object()) return json_object_get_size(value_);
+        if (is_array()) return json_array_get_size(value_);
+        return 0;
+    }
+
+    /* empty ranges for anything but an object (an array that is not
+       packed, a packed array) */
+    Members members() const noexcept
+    {
+        return is_object() ? Members(value_->as.object, json_object_get_size(value_))
+                           : Members(nullptr, 0);
+    }
+    Elements elements() const noexcept
+    {
+        return is_array() && !is_packed() ? Elements(value_->as.array, json_array_get_size(value_))
+                                          : Elements(nullptr, 0);
+    }
+    Numbers numbers() const noexcept
+    {
+        return is_packed() ? Numbers(json_array_get_numbers(value_), json_array_get_size(value_))
+                           : Numbers(nullptr, 0);
+    }
+
+private:
+    const Json_Value *value_ = nullptr;
+};
+
+/* a member of an object, as seen while iterating over it */
+class Member {
+public:
+    constexpr explicit Member(const Json_Pair *pair) noexcept : pair_(pair) {}
+
+    std::string_view key() const noexcept
+    {
+        return std::string_view(json_to_string(&pair_->key), json_string_length(&pair_->key));
+    }
+    Value value() const noexcept { return Value(&pair_->value); }
+    const Json_Pair *c_pair() const noexcept { return pair_; }
+
+private:
+    const Json_Pair *pair_;
+};
+
+/* Owns a context: json_init_opt on construction, json_fini when it goes
+   out of scope. It can be moved but not copied; a moved-from document
+   may only be destroyed or assigned to. */
+class Document {
+public:
+    explicit Document(const Json_Opt &opt = Json_Opt{}) { json_init_opt(&ctx_, opt); }
+    ~Document() { json_fini(&ctx_); }
+
+    Document(const Document&) = delete;
+    Document &operator=(const Document&) = delete;
+
+    Document(Document &&other) noexcept : ctx_(other.ctx_) { other.release(); }
+    Document &operator=(Document &&other) noexcept
+    {
+        if (this != &other) {
+            json_fini(&ctx_);
+            ctx_ = other.ctx_;
+            other.release();
+        }
+        return *this;
+    }
+
+    /* for everything the binding does not wrap */
+    Json_Context *get() noexcept { return &ctx_; }
+    const Json_Context *get() const noexcept { return &ctx_; }
+
+    Value root() const noexcept { return Value(json_context_get_root(&ctx_)); }
+    Value operator[](const char *key) const noexcept { return root()[key]; }
+    Value operator[](std::string_view key) const noexcept { return root()[key]; }
+    template <typename I, std::enable_if_t<std::is_integral_v<I>, int> = 0>
+    Value operator[](I idx) const noexcept { return root()[idx]; }
+
+#ifdef JSON_ENABLE_DESERIALIZATION
+    bool parse(std::string_view input) noexcept
+    {
+        return json_parse(&ctx_, input.data(), input.size());
+    }
+#endif /* JSON_ENABLE_DESERIALIZATION */
+    const Json_Parse_Error &parse_error() const noexcept
+    {
+        return *json_context_get_parse_error(&ctx_);
+    }
+
+    void dump() noexcept { json_dump(&ctx_); }
+    bool freeze() noexcept { return json_freeze(&ctx_); }
+    void thaw() noexcept { json_thaw(&ctx_); }
+
+private:
+    /* leave 'ctx_' owning nothing, so json_fini has nothing to free */
+    void release() noexcept
+    {
+        ctx_.scopes = nullptr;
+        ctx_.scope_keys = nullptr;
+        ctx_.held = nullptr;
+        ctx_.error_buffer = nullptr;
+        ctx_.current_key = nullptr;
+        ctx_.root = nullptr;
+    }
+
+    Json_Context ctx_;
+};
+
+} /* namespace json */
+
+#endif /* JSON_HPP */
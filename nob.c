@@ -12,9 +12,30 @@ static const char *srcs[] = {
     SRC_FOLDER"serialization/object.c",
     SRC_FOLDER"serialization/nested_array.c",
     SRC_FOLDER"serialization/nested_object.c",
+    SRC_FOLDER"serialization/writev.c",
     SRC_FOLDER"deserialization/array.c",
     SRC_FOLDER"deserialization/object.c",
     SRC_FOLDER"deserialization/merge_json.c",
+    SRC_FOLDER"deserialization/nested_keys.c",
+    SRC_FOLDER"deserialization/deep.c",
+    SRC_FOLDER"deserialization/numbers.c",
+    SRC_FOLDER"deserialization/invalid.c",
+    SRC_FOLDER"deserialization/patch.c",
+    SRC_FOLDER"deserialization/edit.c",
+    SRC_FOLDER"deserialization/extract.c",
+    SRC_FOLDER"deserialization/validate.c",
+    SRC_FOLDER"deserialization/lenient.c",
+    SRC_FOLDER"deserialization/versions.c",
+    SRC_FOLDER"deserialization/packed.c",
+    SRC_FOLDER"deserialization/query.c",
+    SRC_FOLDER"deserialization/canonical.c",
+    SRC_FOLDER"deserialization/cursor.c",
+    SRC_FOLDER"deserialization/stream.c",
+    SRC_FOLDER"stats/stats.c",
+    SRC_FOLDER"allocator/tracking.c",
+    SRC_FOLDER"allocator/fixed.c",
+    SRC_FOLDER"binary/cbor.c",
+    SRC_FOLDER"binary/image.c",
 };
 
 static const char *exes[] = {
@@ -24,18 +45,93 @@ static const char *exes[] = {
     BUILD_FOLDER"serialization/object",
     BUILD_FOLDER"serialization/nested_array",
     BUILD_FOLDER"serialization/nested_object",
+    BUILD_FOLDER"serialization/writev",
     BUILD_FOLDER"deserialization/array",
     BUILD_FOLDER"deserialization/object",
     BUILD_FOLDER"deserialization/merge_json",
+    BUILD_FOLDER"deserialization/nested_keys",
+    BUILD_FOLDER"deserialization/deep",
+    BUILD_FOLDER"deserialization/numbers",
+    BUILD_FOLDER"deserialization/invalid",
+    BUILD_FOLDER"deserialization/patch",
+    BUILD_FOLDER"deserialization/edit",
+    BUILD_FOLDER"deserialization/extract",
+    BUILD_FOLDER"deserialization/validate",
+    BUILD_FOLDER"deserialization/lenient",
+    BUILD_FOLDER"deserialization/versions",
+    BUILD_FOLDER"deserialization/packed",
+    BUILD_FOLDER"deserialization/query",
+    BUILD_FOLDER"deserialization/canonical",
+    BUILD_FOLDER"deserialization/cursor",
+    BUILD_FOLDER"deserialization/stream",
+    BUILD_FOLDER"stats/stats",
+    BUILD_FOLDER"allocator/tracking",
+    BUILD_FOLDER"allocator/fixed",
+    BUILD_FOLDER"binary/cbor",
+    BUILD_FOLDER"binary/image",
 };
 
+/* built with the C++ compiler, against json.hpp */
+static const char *cpp_srcs[] = {
+    SRC_FOLDER"cpp/document.cpp",
+};
+
+static const char *cpp_exes[] = {
+    BUILD_FOLDER"cpp/document",
+};
+
+/* ./nob bench [args...]: build the benchmark with optimizations and run it */
+static bool bench(int argc, char **argv)
+{
+    Cmd cmd = {0};
+    cmd_append(&cmd, "cc",
+        "-Wall", "-Wextra",
+        "-Wno-unused-function",
+        "-O2", "-DNDEBUG", "-pthread",
+        "-I", "./", "-I", "./third_party",
+        "-o", BUILD_FOLDER"bench", "bench/bench.c");
+    if (!cmd_run(&cmd)) return false;
+
+    cmd_append(&cmd, BUILD_FOLDER"bench", "-o", BUILD_FOLDER"bench.json");
+    for (int i = 0; i < argc; i++) cmd_append(&cmd, argv[i]);
+    return cmd_run(&cmd);
+}
+
+/* ./nob bench-cpp [args...]: compare json.hpp with the C API it wraps */
+static bool bench_cpp(int argc, char **argv)
+{
+    Cmd cmd = {0};
+    cmd_append(&cmd, "c++", "-std=c++17",
+        "-Wall", "-Wextra",
+        "-Wno-unused-function",
+        "-O2", "-DNDEBUG",
+        "-I", "./", "-I", "./third_party",
+        "-o", BUILD_FOLDER"bench_cpp", "bench/bench_cpp.cpp");
+    if (!cmd_run(&cmd)) return false;
+
+    cmd_append(&cmd, BUILD_FOLDER"bench_cpp");
+    for (int i = 0; i < argc; i++) cmd_append(&cmd, argv[i]);
+    return cmd_run(&cmd);
+}
+
 int main(int argc, char **argv)
 {
     NOB_GO_REBUILD_URSELF(argc, argv);
 
     if (!mkdir_if_not_exists(BUILD_FOLDER)) return 1;
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return bench(argc - 2, argv + 2) ? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "bench-cpp") == 0) {
+        return bench_cpp(argc - 2, argv + 2) ? 0 : 1;
+    }
     if (!mkdir_if_not_exists(BUILD_FOLDER"serialization/")) return 1;
     if (!mkdir_if_not_exists(BUILD_FOLDER"deserialization/")) return 1;
+    if (!mkdir_if_not_exists(BUILD_FOLDER"stats/")) return 1;
+    if (!mkdir_if_not_exists(BUILD_FOLDER"allocator/")) return 1;
+    if (!mkdir_if_not_exists(BUILD_FOLDER"binary/")) return 1;
+    if (!mkdir_if_not_exists(BUILD_FOLDER"cpp/")) return 1;
 
     for (size_t i = 0; i < ARRAY_LEN(srcs); i++) {
         Cmd cmd = {0};
@@ -48,6 +144,17 @@ int main(int argc, char **argv)
         if (!cmd_run(&cmd)) return 1;
     }
 
+    for (size_t i = 0; i < ARRAY_LEN(cpp_srcs); i++) {
+        Cmd cmd = {0};
+        cmd_append(&cmd, "c++", "-std=c++17",
+            "-Wall", "-Wextra",
+            "-Wno-unused-function",
+            "-ggdb",
+            "-I", "./", "-I", "./third_party",
+            "-o", cpp_exes[i], cpp_srcs[i]);
+        if (!cmd_run(&cmd)) return 1;
+    }
+
     if (!nob_copy_file(SRC_FOLDER"deserialization/test1.json", BUILD_FOLDER"deserialization/test1.json")) return 1;
     if (!nob_copy_file(SRC_FOLDER"deserialization/test2.json", BUILD_FOLDER"deserialization/test2.json")) return 1;
 